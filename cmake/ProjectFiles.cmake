@@ -17,18 +17,50 @@ list(APPEND flexlib_SOURCES
   ${flexlib_include_DIR}/options/ctp/options.hpp
   ${flexlib_include_DIR}/clangUtils.hpp
   ${flexlib_src_DIR}/clangUtils.cpp
+  ${flexlib_include_DIR}/replacement_collector.hpp
+  ${flexlib_src_DIR}/replacement_collector.cc
+  ${flexlib_include_DIR}/replacements_export.hpp
+  ${flexlib_src_DIR}/replacements_export.cc
+  ${flexlib_include_DIR}/token_boundary_index.hpp
+  ${flexlib_src_DIR}/token_boundary_index.cc
+  ${flexlib_include_DIR}/output_sink.hpp
+  ${flexlib_src_DIR}/output_sink.cc
+  ${flexlib_include_DIR}/async_output_writer.hpp
+  ${flexlib_src_DIR}/async_output_writer.cc
+  ${flexlib_include_DIR}/generated_files_overlay.hpp
+  ${flexlib_src_DIR}/generated_files_overlay.cc
   ${flexlib_include_DIR}/funcParser.hpp
   ${flexlib_src_DIR}/funcParser.cpp
+  ${flexlib_include_DIR}/annotation_arg_schema.hpp
+  ${flexlib_src_DIR}/annotation_arg_schema.cc
   #${flexlib_src_DIR}/DispatchQueue.cpp
   ${flexlib_include_DIR}/DispatchQueue.hpp
   ${flexlib_include_DIR}/matchers/annotation_matcher.hpp
   ${flexlib_src_DIR}/matchers/annotation_matcher.cc
+  ${flexlib_include_DIR}/matchers/traversal_scope.hpp
+  ${flexlib_src_DIR}/matchers/traversal_scope.cc
+  ${flexlib_include_DIR}/matchers/annotation_visitor.hpp
+  ${flexlib_src_DIR}/matchers/annotation_visitor.cc
   ${flexlib_include_DIR}/annotation_match_handler.hpp
   ${flexlib_src_DIR}/annotation_match_handler.cc
   ${flexlib_include_DIR}/annotation_parser.hpp
   ${flexlib_src_DIR}/annotation_parser.cc
+  ${flexlib_include_DIR}/annotation_dispatch_table.hpp
+  ${flexlib_src_DIR}/annotation_dispatch_table.cc
+  ${flexlib_include_DIR}/annotation_parse_cache.hpp
+  ${flexlib_src_DIR}/annotation_parse_cache.cc
   ${flexlib_include_DIR}/parser_constants.hpp
   ${flexlib_src_DIR}/parser_constants.cc
+  ${flexlib_include_DIR}/parallel_annotation_driver.hpp
+  ${flexlib_src_DIR}/parallel_annotation_driver.cc
+  ${flexlib_include_DIR}/annotation_prescan.hpp
+  ${flexlib_src_DIR}/annotation_prescan.cc
+  ${flexlib_include_DIR}/annotation_result_cache.hpp
+  ${flexlib_src_DIR}/annotation_result_cache.cc
+  ${flexlib_include_DIR}/shared_precompiled_header.hpp
+  ${flexlib_src_DIR}/shared_precompiled_header.cc
+  ${flexlib_include_DIR}/trace_event_recorder.hpp
+  ${flexlib_src_DIR}/trace_event_recorder.cc
   #
   ${flexlib_include_DIR}/clangPipeline.hpp
   #
@@ -48,6 +80,12 @@ list(APPEND flexlib_SOURCES
   ${flexlib_include_DIR}/reflect/TypeInfo.hpp
   ${flexlib_src_DIR}/reflect/ReflectAST.cpp
   ${flexlib_include_DIR}/reflect/ReflectAST.hpp
+  ${flexlib_src_DIR}/reflect/LazyClassInfo.cpp
+  ${flexlib_include_DIR}/reflect/LazyClassInfo.hpp
+  ${flexlib_src_DIR}/reflect/ReflectionArena.cpp
+  ${flexlib_include_DIR}/reflect/ReflectionArena.hpp
+  ${flexlib_src_DIR}/reflect/StringInterner.cpp
+  ${flexlib_include_DIR}/reflect/StringInterner.hpp
   ${flexlib_include_DIR}/reflect/ast_utils.hpp
   ${flexlib_include_DIR}/template_engine/CXTPL_AnyDict.hpp
   ${flexlib_src_DIR}/template_engine/CXTPL_AnyDict.cpp
@@ -80,6 +118,12 @@ set_source_files_properties(
   COMPILE_FLAGS
   -fno-rtti)
 #
+set_source_files_properties(
+  ${flexlib_src_DIR}/matchers/annotation_visitor.cc
+  PROPERTIES
+  COMPILE_FLAGS
+  -fno-rtti)
+#
 set_source_files_properties(
   ${flexlib_src_DIR}/annotation_match_handler.cc
   PROPERTIES
@@ -91,3 +135,27 @@ set_source_files_properties(
   PROPERTIES
   COMPILE_FLAGS
   -fno-rtti)
+#
+set_source_files_properties(
+  ${flexlib_src_DIR}/parallel_annotation_driver.cc
+  PROPERTIES
+  COMPILE_FLAGS
+  -fno-rtti)
+#
+set_source_files_properties(
+  ${flexlib_src_DIR}/shared_precompiled_header.cc
+  PROPERTIES
+  COMPILE_FLAGS
+  -fno-rtti)
+#
+set_source_files_properties(
+  ${flexlib_src_DIR}/generated_files_overlay.cc
+  PROPERTIES
+  COMPILE_FLAGS
+  -fno-rtti)
+#
+set_source_files_properties(
+  ${flexlib_src_DIR}/replacements_export.cc
+  PROPERTIES
+  COMPILE_FLAGS
+  -fno-rtti)
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "flexlib/funcParser.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <basis/doctest_util.h>
+
+namespace flexlib {
+
+enum class AnnotationArgType {
+  // quoted string literal like "a b" or R"(a b)",
+  // decoded without quotes and with escape sequences processed
+  kString
+  // like 42, -1 or 0x10
+  , kInteger
+  // true, false, 1 or 0
+  , kBoolean
+  // argument value as written in annotation (whitespace removed),
+  // like type name or expression
+  , kRaw
+};
+
+// |std::monostate| if optional argument is missing and has no default
+using AnnotationArgValue
+  = std::variant<std::monostate, std::string, int64_t, bool>;
+
+struct AnnotationArgField {
+  std::string name;
+
+  AnnotationArgType type = AnnotationArgType::kRaw;
+
+  bool required = false;
+
+  // used if argument is missing and not |required|
+  AnnotationArgValue defaultValue;
+};
+
+class AnnotationArgSchema;
+
+// Arguments of one |parsed_func| decoded by |AnnotationArgSchema|.
+// Values are stored in order of schema fields.
+class DecodedAnnotationArgs {
+public:
+  DecodedAnnotationArgs();
+
+  ~DecodedAnnotationArgs();
+
+  DecodedAnnotationArgs(DecodedAnnotationArgs&& other);
+
+  DecodedAnnotationArgs& operator=(DecodedAnnotationArgs&& other);
+
+  // Returns |nullptr| if schema has no field named |name|.
+  const AnnotationArgValue* find(std::string_view name) const;
+
+  // |true| if argument was present or has default value
+  bool has(std::string_view name) const;
+
+  /// \note field must exist and have matching type
+  /// (required or with default value)
+  const std::string& getString(std::string_view name) const;
+
+  int64_t getInteger(std::string_view name) const;
+
+  bool getBoolean(std::string_view name) const;
+
+  const std::vector<AnnotationArgValue>& values() const { return values_; }
+
+private:
+  friend class AnnotationArgSchema;
+
+  // not owned, schema must outlive decoded arguments
+  const AnnotationArgSchema* schema_ = nullptr;
+
+  std::vector<AnnotationArgValue> values_;
+};
+
+// Declarative description of arguments of annotation function,
+// registered by plugin next to its |clang_utils::SourceTransformRules|
+// entry (see |clang_utils::SourceTransformArgSchemas|),
+// so arguments are validated and decoded once
+// before |clang_utils::SourceTransformCallback| runs.
+//
+// Named arguments (`name = value`) are matched by name,
+// unnamed arguments are matched to fields in order of declaration.
+//
+// EXAMPLE:
+// // annotation: `$apply(make_enum(name = "Color", size = 3))`
+// flexlib::AnnotationArgSchema schema;
+// schema
+//   .addField("name", flexlib::AnnotationArgType::kString
+//     , /* required */ true)
+//   .addField("size", flexlib::AnnotationArgType::kInteger
+//     , false, int64_t{0});
+// // decoded.getString("name") == "Color"
+// // decoded.getInteger("size") == 3
+class AnnotationArgSchema {
+public:
+  AnnotationArgSchema();
+
+  ~AnnotationArgSchema();
+
+  AnnotationArgSchema(AnnotationArgSchema&& other);
+
+  AnnotationArgSchema& operator=(AnnotationArgSchema&& other);
+
+  AnnotationArgSchema& addField(
+    std::string name
+    , AnnotationArgType type
+    , bool required = false
+    , AnnotationArgValue defaultValue = AnnotationArgValue());
+
+  // Returns |false| and sets |error| if argument is unknown,
+  // has invalid value, is passed twice or required argument is missing.
+  bool decode(
+    const parsed_func& func
+    , DecodedAnnotationArgs* result
+    , std::string* error) const;
+
+  // Returns index in |fields| or -1.
+  int findField(std::string_view name) const;
+
+  const std::vector<AnnotationArgField>& fields() const { return fields_; }
+
+private:
+  std::vector<AnnotationArgField> fields_;
+};
+
+// Returns |false| if |value| is not valid for |type|.
+bool decodeAnnotationArgValue(
+  std::string_view value
+  , AnnotationArgType type
+  , AnnotationArgValue* result);
+
+} // namespace flexlib
+
+// DISABLE_DOCTEST: custom macro
+#if !defined(DISABLE_DOCTEST)
+
+DOCTEST_TEST_SUITE("decodeAnnotationArgValue") {
+  using namespace flexlib;
+
+  DOCTEST_TEST_CASE("decodeAnnotationArgValue 1") {
+    AnnotationArgValue value;
+    DOCTEST_REQUIRE(decodeAnnotationArgValue(
+      R"raw("a \"b\"\n")raw", AnnotationArgType::kString, &value));
+    DOCTEST_CHECK(std::get<std::string>(value) == "a \"b\"\n");
+    DOCTEST_REQUIRE(decodeAnnotationArgValue(
+      R"raw(R"d(x ")" y)d")raw", AnnotationArgType::kString, &value));
+    DOCTEST_CHECK(std::get<std::string>(value) == R"raw(x ")" y)raw");
+    DOCTEST_CHECK(!decodeAnnotationArgValue(
+      "abc", AnnotationArgType::kString, &value));
+  }
+  DOCTEST_TEST_CASE("decodeAnnotationArgValue 2") {
+    AnnotationArgValue value;
+    DOCTEST_REQUIRE(decodeAnnotationArgValue(
+      "-42", AnnotationArgType::kInteger, &value));
+    DOCTEST_CHECK(std::get<int64_t>(value) == -42);
+    DOCTEST_REQUIRE(decodeAnnotationArgValue(
+      "0x10", AnnotationArgType::kInteger, &value));
+    DOCTEST_CHECK(std::get<int64_t>(value) == 16);
+    DOCTEST_CHECK(!decodeAnnotationArgValue(
+      "4x", AnnotationArgType::kInteger, &value));
+    DOCTEST_REQUIRE(decodeAnnotationArgValue(
+      "true", AnnotationArgType::kBoolean, &value));
+    DOCTEST_CHECK(std::get<bool>(value));
+    DOCTEST_CHECK(!decodeAnnotationArgValue(
+      "yes", AnnotationArgType::kBoolean, &value));
+  }
+}
+
+DOCTEST_TEST_SUITE("AnnotationArgSchema") {
+  using namespace flexlib;
+
+  DOCTEST_TEST_CASE("AnnotationArgSchema 1") {
+    AnnotationArgSchema schema;
+    schema
+      .addField("name", AnnotationArgType::kString, true)
+      .addField("size", AnnotationArgType::kInteger, false, int64_t{7})
+      .addField("flag", AnnotationArgType::kBoolean);
+    std::vector<parsed_func> funcs
+      = split_to_funcs(R"raw(make_enum("Color", flag = false))raw");
+    DOCTEST_REQUIRE(funcs.size() == 1);
+    DecodedAnnotationArgs decoded;
+    std::string error;
+    DOCTEST_REQUIRE(schema.decode(funcs[0], &decoded, &error));
+    DOCTEST_CHECK(decoded.getString("name") == "Color");
+    DOCTEST_CHECK(decoded.getInteger("size") == 7);
+    DOCTEST_CHECK(decoded.getBoolean("flag") == false);
+  }
+  DOCTEST_TEST_CASE("AnnotationArgSchema 2") {
+    AnnotationArgSchema schema;
+    schema.addField("name", AnnotationArgType::kString, true);
+    DecodedAnnotationArgs decoded;
+    std::string error;
+    DOCTEST_CHECK(!schema.decode(
+      split_to_funcs("foo()")[0], &decoded, &error));
+    DOCTEST_CHECK(!error.empty());
+    DOCTEST_CHECK(!schema.decode(
+      split_to_funcs(R"raw(foo(name = "a", other = 1))raw")[0]
+      , &decoded, &error));
+    DOCTEST_CHECK(!schema.decode(
+      split_to_funcs(R"raw(foo(name = 1))raw")[0], &decoded, &error));
+  }
+}
+#endif // DISABLE_DOCTEST
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "flexlib/annotation_parser.hpp"
+
+#include <base/macros.h>
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace flexlib {
+
+// Prefix trie over names of |AnnotationMethods|,
+// alternative to linear scan over |AnnotationMethods|.
+// Finds method with longest name that is prefix of annotation
+// in O(annotation length), so dispatch cost does not grow
+// with number of registered methods.
+//
+// Build it once after plugins handled
+// |plugin::ToolPlugin::Events::RegisterAnnotationMethods|.
+//
+// EXAMPLE:
+// // methods: "{funccall};" and "{funccall};make_reflect;"
+// // annotation: "{funccall};make_reflect;foo"
+// // found method: "{funccall};make_reflect;", method length: 24
+//
+/// \note stores positions of methods in |AnnotationMethods|,
+/// so table must be rebuilt if |AnnotationMethods| changes.
+class AnnotationDispatchTable {
+public:
+  explicit AnnotationDispatchTable(
+    const AnnotationMethods* annotationMethods);
+
+  ~AnnotationDispatchTable();
+
+  // Returns |AnnotationMethods::end| if no method name
+  // is prefix of |annotation|.
+  /// \note |annotation| must not contain |kRequiredAnnotationPrefix|
+  AnnotationMethods::const_iterator findLongestPrefix(
+    std::string_view annotation
+    , size_t* methodLength) const;
+
+  // number of methods in |AnnotationMethods| when table was built
+  size_t numMethods() const { return numMethods_; }
+
+  // |true| if |annotationMethods| was not changed after table was built
+  /// \note detects only added and removed methods
+  bool isBuiltFor(const AnnotationMethods* annotationMethods) const;
+
+private:
+  static constexpr int32_t kNoMethod = -1;
+
+  struct Edge {
+    unsigned char label;
+
+    // index in |nodes_|
+    uint32_t target;
+  };
+
+  struct Node {
+    // outgoing edges are |edges_[firstEdge, firstEdge + numEdges)|
+    // sorted by |Edge::label|
+    uint32_t firstEdge = 0;
+
+    uint32_t numEdges = 0;
+
+    // index in |AnnotationMethods| of method
+    // which name ends at this node
+    int32_t methodIndex = kNoMethod;
+  };
+
+  void build();
+
+  const AnnotationMethods* annotationMethods_;
+
+  size_t numMethods_ = 0;
+
+  // |nodes_[0]| is root
+  std::vector<Node> nodes_;
+
+  std::vector<Edge> edges_;
+
+  DISALLOW_COPY_AND_ASSIGN(AnnotationDispatchTable);
+};
+
+} // namespace flexlib
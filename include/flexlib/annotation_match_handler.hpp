@@ -24,6 +24,10 @@ namespace flexlib {
 
 class AnnotationMatchHandler {
 public:
+  // see |OutputSink::writeRewriteBuffer|
+  // to skip writing of unchanged files
+  // and |AsyncOutputWriter::writeRewriteBuffer|
+  // to write files on background threads
   using SaveFileHandler
     = base::RepeatingCallback<
         void(const clang::FileID& fileID
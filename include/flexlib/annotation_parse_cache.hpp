@@ -0,0 +1,203 @@
+#pragma once
+
+#include "flexlib/funcParser.hpp"
+
+#include <base/macros.h>
+#include <base/memory/ref_counted.h>
+#include <base/memory/scoped_refptr.h>
+#include <base/containers/mru_cache.h>
+#include <base/synchronization/lock.h>
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+namespace flexlib {
+
+// Immutable result of |AnnotationParser::parseToMethods|
+// and |split_to_flat_funcs| for one annotation text.
+// Keeps copy of text after method name, so it is passed
+// to |AnnotationMethodCallback| without copy per match.
+//
+// |AnnotationMatchHandler| makes entry current while
+// |AnnotationMethodCallback| runs, so callback may use parsed
+// arguments instead of calling |split_to_funcs| again.
+//
+// USAGE:
+// // in |AnnotationMethodCallback|
+// const flexlib::ParsedAnnotation* parsedAnnotation
+//   = flexlib::ParsedAnnotation::current();
+// if(parsedAnnotation) {
+//   useFuncs(parsedAnnotation->funcs());
+// } else {
+//   useFuncs(flexlib::split_to_flat_funcs(processedAnnotation));
+// }
+//
+/// \note thread-safe (immutable after creation)
+class ParsedAnnotation
+  : public base::RefCountedThreadSafe<ParsedAnnotation>
+{
+public:
+  // Makes |parsedAnnotation| current for this thread while in scope.
+  class ScopedCurrent {
+  public:
+    explicit ScopedCurrent(const ParsedAnnotation* parsedAnnotation);
+
+    ~ScopedCurrent();
+
+  private:
+    const ParsedAnnotation* previous_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedCurrent);
+  };
+
+  // |methodName| is empty if annotation has no registered method,
+  // |withoutMethodOffset| is position in |annotation|
+  // of text after method name,
+  // |methodsKey| identifies |AnnotationMethods| used to parse
+  // (see |AnnotationParseCache|).
+  ParsedAnnotation(
+    std::string annotation
+    , std::string methodName
+    , size_t withoutMethodOffset
+    , size_t methodsKey);
+
+  // Returns entry made current by |ScopedCurrent| on this thread
+  // or |nullptr|.
+  static const ParsedAnnotation* current();
+
+  // annotation text as stored in |clang::AnnotateAttr|
+  const std::string& annotation() const { return annotation_; }
+
+  bool hasMethod() const { return !methodName_.empty(); }
+
+  // name of method in |AnnotationMethods|
+  const std::string& methodName() const { return methodName_; }
+
+  // text after method name, see |AnnotationParser::parseToMethods|
+  const std::string& annotationWithoutMethod() const
+  {
+    return annotationWithoutMethod_;
+  }
+
+  // |annotationWithoutMethod| split by |split_to_flat_funcs|
+  /// \note empty if annotation has no registered method
+  const flat_parsed_funcs& funcs() const { return funcs_; }
+
+  size_t methodsKey() const { return methodsKey_; }
+
+  // approximate number of bytes used by entry
+  size_t estimatedSize() const { return estimatedSize_; }
+
+private:
+  friend class base::RefCountedThreadSafe<ParsedAnnotation>;
+
+  ~ParsedAnnotation();
+
+  const std::string annotation_;
+
+  const std::string methodName_;
+
+  const std::string annotationWithoutMethod_;
+
+  const size_t methodsKey_;
+
+  const flat_parsed_funcs funcs_;
+
+  size_t estimatedSize_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(ParsedAnnotation);
+};
+
+// Process-wide cache of |ParsedAnnotation| keyed by hash
+// of annotation text and |methodsKey|, so annotations
+// from widely included headers are parsed once per run
+// instead of once per translation unit.
+// Least recently used entries are evicted
+// when entries use more than |Options::maxBytes|.
+//
+// |methodsKey| identifies names of |AnnotationMethods|
+// (see |AnnotationParser::methodsKey|), so parsers of workers
+// with same method names share entries and parsers with other
+// methods never get entry parsed for other methods.
+//
+// USAGE:
+// // shared by parsers of all workers
+// flexlib::AnnotationParseCache parseCache{
+//   flexlib::AnnotationParseCache::Options{}};
+// annotationParser->setParseCache(&parseCache);
+//
+/// \note thread-safe
+class AnnotationParseCache {
+public:
+  struct Options {
+    // memory cap for all entries
+    size_t maxBytes = 64 * 1024 * 1024;
+
+    // hashes annotation text, |std::hash| is used if null
+    /// \note used by tests to force hash collisions
+    size_t (*hashFunction)(std::string_view annotation) = nullptr;
+  };
+
+  struct Stats {
+    std::atomic<size_t> hits{0};
+
+    std::atomic<size_t> misses{0};
+
+    std::atomic<size_t> evictions{0};
+  };
+
+  explicit AnnotationParseCache(Options&& options);
+
+  ~AnnotationParseCache();
+
+  // Returns |nullptr| if |annotation| was not parsed yet
+  // with methods identified by |methodsKey|.
+  scoped_refptr<const ParsedAnnotation> lookup(
+    std::string_view annotation
+    , size_t methodsKey);
+
+  // Returns entry stored for same annotation text and methods
+  // if other thread stored it first,
+  // otherwise stores and returns |parsedAnnotation|.
+  scoped_refptr<const ParsedAnnotation> store(
+    scoped_refptr<const ParsedAnnotation> parsedAnnotation);
+
+  // approximate number of bytes used by all entries
+  size_t totalBytes() const;
+
+  // number of entries
+  size_t size() const;
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  using EntryMap
+    = base::HashingMRUCache<
+        size_t
+        , scoped_refptr<const ParsedAnnotation>
+      >;
+
+  size_t hashAnnotation(
+    std::string_view annotation
+    , size_t methodsKey) const;
+
+  // evicts least recently used entries until |totalBytes_| fits
+  void evictIfNeeded();
+
+  const Options options_;
+
+  Stats stats_;
+
+  mutable base::Lock lock_;
+
+  // guarded by |lock_|
+  EntryMap entries_;
+
+  // guarded by |lock_|
+  size_t totalBytes_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(AnnotationParseCache);
+};
+
+} // namespace flexlib
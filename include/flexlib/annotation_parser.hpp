@@ -2,7 +2,9 @@
 
 #include "flexlib/matchers/annotation_matcher.hpp"
 
+#include <memory>
 #include <string>
+#include <string_view>
 
 #include <clang/Rewrite/Core/Rewriter.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
@@ -20,6 +22,7 @@
 #include <base/callback.h>
 #include <base/logging.h>
 #include <base/containers/flat_map.h>
+#include <base/memory/scoped_refptr.h>
 
 namespace flexlib {
 
@@ -39,16 +42,68 @@ typedef
     , AnnotationMethodCallback
   > AnnotationMethods;
 
+class AnnotationDispatchTable;
+class AnnotationParseCache;
+class ParsedAnnotation;
+
 class AnnotationParser {
 public:
   AnnotationParser(
     AnnotationMethods* supportedAnnotationMethods);
 
+  ~AnnotationParser();
+
+  // Builds |AnnotationDispatchTable|, so |parseToMethods| finds method
+  // with longest name in O(annotation length).
+  // Call it after plugins registered annotation methods.
+  /// \note without dispatch table |parseToMethods| finds
+  /// first method (in order of names) that is prefix of annotation
+  void buildDispatchTable();
+
+  // Sets |resultWithoutPrefix| to view into |unprocessedAnnotation|
+  // (no copy), so view is valid while annotation storage is alive
+  // (like |clang::AnnotateAttr::getAnnotation|).
+  bool tryRemovePrefix(
+    std::string_view unprocessedAnnotation
+    , std::string_view& resultWithoutPrefix
+    , std::string_view prefix);
+
+  // Sets |resultWithoutMethod| to view into |unprocessedAnnotation|,
+  // see |tryRemovePrefix|.
+  AnnotationMethods::const_iterator parseToMethods(
+    std::string_view unprocessedAnnotation
+    , std::string_view& resultWithoutMethod);
+
+  // Same as |parseToMethods|, but result is shared
+  // with other parsers using same |AnnotationParseCache|
+  // (parsed once per annotation text).
+  // Result is not cached if |setParseCache| was not called.
+  /// \note returns |ParsedAnnotation| even if annotation
+  /// has no registered method (see |ParsedAnnotation::hasMethod|)
+  scoped_refptr<const ParsedAnnotation> parseToMethodsCached(
+    std::string_view unprocessedAnnotation);
+
+  // |parseCache| may be shared between threads
+  // and must outlive parser
+  void setParseCache(AnnotationParseCache* parseCache);
+
+  AnnotationParseCache* parseCache() const { return parseCache_; }
+
+  // Identifies names of |AnnotationMethods| and lookup rule
+  // (with or without dispatch table), so parsers with same methods
+  // share entries of |AnnotationParseCache|.
+  /// \note recomputed only if number of methods changed
+  size_t methodsKey();
+
+  // Same as overload that uses |std::string_view|,
+  // but copies result into |resultWithoutPrefix|.
   bool tryRemovePrefix(
     const std::string& unprocessedAnnotation
     , std::string& resultWithoutPrefix
     , const std::string& prefix);
 
+  // Same as overload that uses |std::string_view|,
+  // but copies result into |resultWithoutMethod|.
   AnnotationMethods::const_iterator parseToMethods(
     const std::string& unprocessedAnnotation
     , std::string& resultWithoutMethod);
@@ -56,6 +111,20 @@ public:
 private:
   AnnotationMethods* annotationMethods;
 
+  // created by |buildDispatchTable|
+  std::unique_ptr<AnnotationDispatchTable> dispatchTable_;
+
+  // set by |setParseCache|
+  AnnotationParseCache* parseCache_ = nullptr;
+
+  static constexpr size_t kNoMethodsKey = static_cast<size_t>(-1);
+
+  // cached by |methodsKey|
+  size_t methodsKey_ = 0;
+
+  // number of methods when |methodsKey_| was computed
+  size_t methodsKeySize_ = kNoMethodsKey;
+
   SEQUENCE_CHECKER(sequence_checker_);
 
   DISALLOW_COPY_AND_ASSIGN(AnnotationParser);
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <base/macros.h>
+#include <base/files/file_path.h>
+#include <base/time/time.h>
+#include <base/synchronization/lock.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace flexlib {
+
+// Finds translation units that can not contain annotations
+// without running clang.
+//
+// Main file and its project-local includes are memory-mapped and searched
+// for |kRequiredAnnotationPrefix| and |kAnnotateAttrSpelling|.
+// Translation unit is skipped only if neither of these strings
+// (nor any of |Options::extraMarkers|) was found.
+// Results are cached per file by modification time and size.
+//
+/// \note annotations produced by macros from headers that are not
+/// project-local (not found in |Options::localIncludeDirs|) can not
+/// be detected, use |Options::extraMarkers| with macro names
+/// or disable pre-scan using |Options::enabled|.
+/// \note thread-safe
+class AnnotationPrescanner {
+public:
+  struct Options {
+    // if |false|, then every translation unit may contain annotations
+    bool enabled = true;
+
+    // Directories used to resolve `#include` directives.
+    // Only headers found in directory of including file
+    // or in |localIncludeDirs| are scanned.
+    std::vector<base::FilePath> localIncludeDirs;
+
+    // Substrings that mark file as annotated,
+    // like names of macros that expand into annotations.
+    /// \note computed includes (`#include MACRO`) are not followed,
+    /// so translation unit that gets annotations only from header
+    /// included that way is skipped by mistake,
+    /// add marker found in including file (like name of |MACRO|)
+    std::vector<std::string> extraMarkers;
+  };
+
+  struct Stats {
+    // files that were memory-mapped and searched
+    std::atomic<size_t> scannedFiles{0};
+
+    // files found in cache
+    std::atomic<size_t> cachedFiles{0};
+
+    // translation units that can not contain annotations
+    std::atomic<size_t> skippedTranslationUnits{0};
+  };
+
+  explicit AnnotationPrescanner(Options&& options);
+
+  ~AnnotationPrescanner();
+
+  // Returns |false| only if |mainFile| and its project-local includes
+  // can not contain annotations.
+  bool mayContainAnnotations(const base::FilePath& mainFile);
+
+  // Returns |sourcePaths| that may contain annotations
+  // (in same order), so list can be passed to |clang::tooling::ClangTool|
+  // and |AnnotationMatchFactory::create| will not be called
+  // for skipped translation units.
+  std::vector<std::string> filterTranslationUnits(
+    const std::vector<std::string>& sourcePaths);
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct FileScanResult {
+    base::Time lastModified;
+
+    int64_t size = 0;
+
+    bool hasRequiredPrefix = false;
+
+    bool hasAnnotateAttr = false;
+
+    bool hasExtraMarker = false;
+
+    // resolved project-local includes
+    std::vector<base::FilePath> localIncludes;
+  };
+
+  // Returns |false| if |filePath| can not be read.
+  bool getFileScanResult(
+    const base::FilePath& filePath
+    , FileScanResult* result);
+
+  // Memory-maps |filePath| and searches for annotations and includes.
+  bool scanFile(
+    const base::FilePath& filePath
+    , FileScanResult* result) const;
+
+  // Searches |includePath| in |includingDir|
+  // or in |Options::localIncludeDirs| if |includingDir| is empty.
+  // Returns empty path if header is not project-local.
+  base::FilePath resolveInclude(
+    const base::FilePath& includingDir
+    , const std::string& includePath) const;
+
+  const Options options_;
+
+  Stats stats_;
+
+  base::Lock cacheLock_;
+
+  // guarded by |cacheLock_|
+  std::map<base::FilePath, FileScanResult> cache_;
+
+  DISALLOW_COPY_AND_ASSIGN(AnnotationPrescanner);
+};
+
+} // namespace flexlib
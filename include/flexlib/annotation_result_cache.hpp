@@ -0,0 +1,121 @@
+#pragma once
+
+#include "flexlib/parallel_annotation_driver.hpp"
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <base/macros.h>
+#include <base/files/file_path.h>
+#include <base/strings/string_piece.h>
+#include <base/time/time.h>
+#include <base/synchronization/lock.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace clang_utils {
+
+// Returns hex-encoded SHA1 of |contents|,
+// see |AnnotationFileDependency::contentHash|.
+std::string computeContentHash(base::StringPiece contents);
+
+// Persistent cache of |AnnotationFileResult| for incremental regeneration.
+//
+// Entry key is SHA1 of source path, compile command,
+// registered annotation methods and tool (plugin) versions.
+// Entry stores SHA1 of every file read by clang
+// (main file and all included headers)
+// and paths searched for included headers before directory
+// header was found in (see |AnnotationFileResult::absentDependencies|),
+// so entry is used only if none of these files changed
+// and no new header shadows included one.
+/// \note |__has_include| lookups are not recorded,
+/// translation units that depend on them may use outdated entry
+/// if header appears later
+//
+// Each entry is separate file in |Options::cacheDir|
+// written atomically, so same cache may be used by many workers
+// (and by many processes).
+//
+/// \note thread-safe
+class AnnotationResultCache {
+public:
+  struct Options {
+    base::FilePath cacheDir;
+
+    // names of registered |flexlib::AnnotationMethods|
+    std::vector<std::string> annotationMethodNames;
+
+    // versions of loaded plugins and of tool itself
+    /// \note change version of plugin if it produces different output
+    std::vector<std::string> toolVersions;
+  };
+
+  struct Stats {
+    std::atomic<size_t> hits{0};
+
+    std::atomic<size_t> misses{0};
+
+    std::atomic<size_t> stores{0};
+  };
+
+  explicit AnnotationResultCache(Options&& options);
+
+  ~AnnotationResultCache();
+
+  // Returns empty string if no compile command found for |sourcePath|.
+  // |extraKeyParts| may be used for inputs that are not part
+  // of compile command, like stamp of precompiled header.
+  std::string computeKey(
+    const clang::tooling::CompilationDatabase& compilations
+    , const std::string& sourcePath
+    , const std::vector<std::string>& extraKeyParts
+        = std::vector<std::string>()) const;
+
+  // Returns |true| and fills rewritten buffer and side outputs
+  // of |result| if entry for |key| exists
+  // and none of its dependencies changed.
+  bool lookup(
+    const std::string& key
+    , AnnotationFileResult* result);
+
+  // Stores result with |AnnotationFileResult::Status::kDone|.
+  /// \note |result.dependencies| must be filled
+  bool store(
+    const std::string& key
+    , const AnnotationFileResult& result);
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct FileHash {
+    base::Time lastModified;
+
+    int64_t size = 0;
+
+    // SHA1 of file contents
+    std::string contentHash;
+  };
+
+  // Returns empty string if file can not be read.
+  std::string getFileContentHash(
+    const base::FilePath& filePath);
+
+  base::FilePath getEntryPath(
+    const std::string& key) const;
+
+  const Options options_;
+
+  Stats stats_;
+
+  base::Lock fileHashesLock_;
+
+  // guarded by |fileHashesLock_|
+  std::map<base::FilePath, FileHash> fileHashes_;
+
+  DISALLOW_COPY_AND_ASSIGN(AnnotationResultCache);
+};
+
+} // namespace clang_utils
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "flexlib/output_sink.hpp"
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <base/macros.h>
+#include <base/files/file_path.h>
+#include <base/synchronization/condition_variable.h>
+#include <base/synchronization/lock.h>
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace base {
+class DelegateSimpleThread;
+} // namespace base
+
+namespace flexlib {
+
+// Writes files on background I/O threads using |OutputSink|,
+// so parsing thread does not wait for disk
+// (for example, on network-mounted build directory).
+//
+// |write| takes ownership of contents and returns immediately
+// unless too many bytes (or files) are pending,
+// in that case caller waits until I/O threads catch up (backpressure).
+// |flush| waits until all pending files are written.
+// Writes of same file are never run in parallel
+// and finish in order of |write| calls, so last contents win.
+//
+// USAGE:
+// flexlib::OutputSink outputSink;
+// flexlib::AsyncOutputWriter outputWriter(
+//   &outputSink, flexlib::AsyncOutputWriter::Options{});
+// // in |AnnotationMatchHandler::SaveFileHandler|
+// outputWriter.writeRewriteBuffer(outputPath, rewriter, fileID);
+// // before exit
+// outputWriter.flush();
+//
+/// \note thread-safe, may be shared by all workers
+class AsyncOutputWriter {
+public:
+  struct Options {
+    size_t numThreads = 2;
+
+    // |write| waits while pending contents use more memory
+    size_t maxPendingBytes = 256 * 1024 * 1024;
+
+    // |write| waits while more files are pending
+    size_t maxPendingWrites = 1024;
+  };
+
+  // |outputSink| must outlive writer
+  AsyncOutputWriter(
+    OutputSink* outputSink
+    , Options&& options);
+
+  // waits for pending writes
+  ~AsyncOutputWriter();
+
+  void write(
+    const base::FilePath& outputPath
+    , std::string&& contents);
+
+  // Copies buffer of |fileID| edited by |rewriter|
+  // (or original buffer if |rewriter| has no edits for |fileID|),
+  // so |rewriter| may be destroyed right after call.
+  void writeRewriteBuffer(
+    const base::FilePath& outputPath
+    , const clang::Rewriter& rewriter
+    , clang::FileID fileID);
+
+  // Waits until all files passed to |write| before call are written.
+  /// \note returns |false| if some write failed since last |flush|
+  bool flush();
+
+private:
+  class IOThread;
+
+  struct PendingWrite {
+    base::FilePath outputPath;
+
+    std::string contents;
+  };
+
+  // Returns |false| if writer is stopping.
+  // Takes oldest write of file not written by other I/O thread.
+  /// \note called on I/O threads
+  bool takePendingWrite(PendingWrite* pendingWrite);
+
+  /// \note called on I/O threads
+  void finishPendingWrite(
+    const base::FilePath& outputPath
+    , size_t contentsSize
+    , OutputSink::WriteResult writeResult);
+
+  OutputSink* outputSink_;
+
+  const Options options_;
+
+  base::Lock lock_;
+
+  // signaled when write is added, when write is finished
+  // (next write of same file may be taken)
+  // or when writer is stopping
+  base::ConditionVariable hasPendingWrites_;
+
+  // signaled when write is finished
+  base::ConditionVariable writeFinished_;
+
+  // guarded by |lock_|
+  std::deque<PendingWrite> pendingWrites_;
+
+  // files taken by I/O threads
+  // guarded by |lock_|
+  std::set<base::FilePath> writingPaths_;
+
+  // size of contents in |pendingWrites_|
+  // and in writes taken by I/O threads
+  // guarded by |lock_|
+  size_t pendingBytes_ = 0;
+
+  // number of writes in |pendingWrites_|
+  // and writes taken by I/O threads
+  // guarded by |lock_|
+  size_t numUnfinishedWrites_ = 0;
+
+  // guarded by |lock_|
+  bool hasFailedWrites_ = false;
+
+  // guarded by |lock_|
+  bool isStopping_ = false;
+
+  std::vector<std::unique_ptr<IOThread>> ioThreads_;
+
+  std::vector<std::unique_ptr<base::DelegateSimpleThread>> threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncOutputWriter);
+};
+
+} // namespace flexlib
@@ -3,6 +3,7 @@
 #include "flexlib/clangUtils.hpp"
 
 #include "flexlib/funcParser.hpp"
+#include "flexlib/annotation_arg_schema.hpp"
 
 #if defined(CLING_IS_ON)
 #include "ClingInterpreterModule.hpp"
@@ -25,6 +26,7 @@
 #include <base/callback.h>
 #include <base/logging.h>
 #include <base/containers/flat_map.h>
+#include <base/optional.h>
 
 namespace clang_utils {
 
@@ -68,6 +70,13 @@ struct SourceTransformOptions {
     * becomes two `parsed_func` - `interface` and `foo_with_args`.
   **/
   const std::vector<flexlib::parsed_func>& all_func_with_args;
+
+  /**
+    * Arguments of `func_with_args` decoded by schema
+    * registered in `SourceTransformPipeline::sourceTransformArgSchemas`.
+    * nullptr if no schema registered for rule.
+  **/
+  const flexlib::DecodedAnnotationArgs* decoded_args = nullptr;
 };
 
 typedef
@@ -82,12 +91,33 @@ typedef
     , SourceTransformCallback
   > SourceTransformRules;
 
+// schema of arguments for rule with same name in |SourceTransformRules|
+typedef
+  base::flat_map<
+    std::string
+    , flexlib::AnnotationArgSchema
+  > SourceTransformArgSchemas;
+
 class SourceTransformPipeline {
 public:
   SourceTransformPipeline();
 
+  // Runs rule registered in |sourceTransformRules| by |ruleName|
+  // (wrapped in trace event tagged with |ruleName|).
+  // Returns |base::nullopt| if rule is not registered.
+  // If |sourceTransformArgSchemas| has schema for |ruleName|,
+  // then arguments are decoded before rule runs
+  // (see |SourceTransformOptions::decoded_args|)
+  // and rule is not called if arguments are invalid
+  // (returns result that keeps original code).
+  base::Optional<SourceTransformResult> runSourceTransformRule(
+    const std::string& ruleName
+    , const SourceTransformOptions& callback_args);
+
   SourceTransformRules sourceTransformRules;
 
+  SourceTransformArgSchemas sourceTransformArgSchemas;
+
 private:
 
   SEQUENCE_CHECKER(sequence_checker_);
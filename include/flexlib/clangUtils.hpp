@@ -88,6 +88,8 @@ enum Options
 
 namespace clang_utils {
 
+class TokenBoundaryIndexCache;
+
 extern const char kSeparatorWhitespace[];
 
 extern const char kStructPrefix[];
@@ -160,10 +162,19 @@ void expandLocations(clang::SourceLocation& startLoc,
 /// ReplaceText(
 ///   clang::SourceRange(startLoc, endLoc)
 ///   , replacement);
+/// \note uses |TokenBoundaryIndex| of file from
+/// |TokenBoundaryIndexCache::Current()| instead of lexing
 clang::SourceLocation findSemiAfterLocation(
   const clang::SourceLocation& loc
   , clang::Rewriter& rewriter);
 
+/// \note lexes if |tokenIndexCache| is nullptr
+/// or made for other |clang::SourceManager|
+clang::SourceLocation findSemiAfterLocation(
+  const clang::SourceLocation& loc
+  , clang::Rewriter& rewriter
+  , TokenBoundaryIndexCache* tokenIndexCache);
+
 /// \note prints up to return type
 /// (without method name, arguments or body)
 /// \note order matters:
@@ -221,6 +232,7 @@ std::string forwardMethodParamNames(
   const std::vector<reflection::MethodParamInfo>& params);
 
 // replaces clang matchResult with |replacement| in source code
+// (see |replaceText|)
 void replaceWith(
   clang::Rewriter& rewriter
   , const clang::Decl* decl
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <llvm/ADT/SmallVector.h>
+
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 
@@ -36,9 +41,111 @@ struct parsed_func {
   parsed_func_detail parsed_func_;
 };
 
-functionArgument extract_func_arg(std::string const& inStr);
+functionArgument extract_func_arg(std::string_view inStr);
+
+// Splits annotation like `foo(a=1, b(2)); bar` by ';' into functions
+// using single pass over |inStr|.
+// Whitespace outside of string literals is removed.
+// Nested parentheses, string literals with escaped quotes (\")
+// and raw string literals (R"delim(...)delim") are kept verbatim
+// inside argument values.
+/// \note same as |split_to_flat_funcs| followed by |to_parsed_func|
+std::vector<parsed_func> split_to_funcs(std::string_view inStr);
+
+// Same as |functionArgument|, but points into
+// |flat_parsed_funcs| that owns parsed text.
+struct flat_function_argument {
+  std::string_view name_;
+  std::string_view value_;
+};
+
+// Same as |parsed_func|, but without per-argument allocations:
+// all strings point into |flat_parsed_funcs| that owns parsed text.
+struct flat_parsed_func {
+  // most of annotations have few arguments
+  static constexpr unsigned kInlineArgs = 4;
+
+  using name_index_type = llvm::SmallVector<uint32_t, kInlineArgs>;
+
+  // Returns first argument named |name| or |nullptr|.
+  /// \note O(log(number of arguments))
+  const flat_function_argument* find_arg(std::string_view name) const;
+
+  // Returns number of arguments named |name|.
+  size_t count_args(std::string_view name) const;
+
+  std::string_view func_with_args_as_string_;
+
+  std::string_view func_name_;
+
+  llvm::SmallVector<flat_function_argument, kInlineArgs> args_;
+
+  // indices in |args_| of named arguments sorted by name,
+  // arguments with same name keep order of appearance
+  // (replaces |args::as_name_to_value_|)
+  name_index_type sorted_name_index_;
+};
+
+// Owns single buffer with text of all parsed functions
+// (whitespace outside of string literals removed)
+// and |flat_parsed_func| pointing into it.
+//
+// USAGE:
+// flexlib::flat_parsed_funcs funcs
+//   = flexlib::split_to_flat_funcs("foo(a=1, b); bar");
+// const flexlib::flat_function_argument* arg
+//   = funcs[0].find_arg("a"); // arg->value_ == "1"
+// flexlib::parsed_func legacy = flexlib::to_parsed_func(funcs[0]);
+//
+/// \note move-only, moving does not invalidate |std::string_view|
+/// returned by |flat_parsed_func|
+class flat_parsed_funcs {
+public:
+  using container_type = llvm::SmallVector<flat_parsed_func, 2>;
+
+  flat_parsed_funcs();
+
+  flat_parsed_funcs(flat_parsed_funcs&& other);
+
+  flat_parsed_funcs& operator=(flat_parsed_funcs&& other);
+
+  ~flat_parsed_funcs();
+
+  size_t size() const { return funcs_.size(); }
+
+  bool empty() const { return funcs_.empty(); }
+
+  const flat_parsed_func& operator[](size_t index) const {
+    return funcs_[index];
+  }
+
+  container_type::const_iterator begin() const { return funcs_.begin(); }
+
+  container_type::const_iterator end() const { return funcs_.end(); }
+
+  // size of owned buffer in bytes
+  size_t buffer_size() const { return buffer_size_; }
+
+private:
+  friend flat_parsed_funcs split_to_flat_funcs(std::string_view inStr);
+
+  std::unique_ptr<char[]> buffer_;
+
+  size_t buffer_size_ = 0;
+
+  container_type funcs_;
+
+  flat_parsed_funcs(const flat_parsed_funcs&) = delete;
+  flat_parsed_funcs& operator=(const flat_parsed_funcs&) = delete;
+};
+
+// Parses |inStr| like |split_to_funcs|
+// using one allocation for text of all functions.
+flat_parsed_funcs split_to_flat_funcs(std::string_view inStr);
 
-std::vector<parsed_func> split_to_funcs(std::string const& inStr);
+// Converts to representation expected by existing callbacks
+// (see |clang_utils::SourceTransformOptions|).
+parsed_func to_parsed_func(const flat_parsed_func& flat_func);
 
 } // namespace flexlib
 
@@ -83,4 +190,122 @@ DOCTEST_TEST_SUITE("extract_func_arg") {
       , hh = 3)raw");
   }
 }
+
+DOCTEST_TEST_SUITE("split_to_funcs") {
+  using namespace flexlib;
+
+  DOCTEST_TEST_CASE("split_to_funcs 1") {
+    std::vector<parsed_func> funcs
+      = split_to_funcs(R"raw(foo(a = 1, b) ; bar)raw");
+    DOCTEST_REQUIRE(funcs.size() == 2);
+    DOCTEST_CHECK(funcs[0].func_with_args_as_string_ == "foo(a=1,b)");
+    DOCTEST_CHECK(funcs[0].parsed_func_.func_name_ == "foo");
+    DOCTEST_REQUIRE(funcs[0].parsed_func_.args_.as_vec_.size() == 2);
+    DOCTEST_CHECK(funcs[0].parsed_func_.args_.as_vec_[0].name_ == "a");
+    DOCTEST_CHECK(funcs[0].parsed_func_.args_.as_vec_[0].value_ == "1");
+    DOCTEST_CHECK(funcs[0].parsed_func_.args_.as_vec_[1].value_ == "b");
+    DOCTEST_CHECK(
+      funcs[0].parsed_func_.args_.as_name_to_value_.at("a").front() == "1");
+    DOCTEST_CHECK(funcs[1].parsed_func_.func_name_ == "bar");
+    DOCTEST_CHECK(funcs[1].parsed_func_.args_.as_vec_.empty());
+  }
+  DOCTEST_TEST_CASE("split_to_funcs 2") {
+    /// \note nested parentheses and separators
+    /// inside them are part of argument
+    std::vector<parsed_func> funcs
+      = split_to_funcs(R"raw(foo(a = bar(1, 2; 3), b))raw");
+    DOCTEST_REQUIRE(funcs.size() == 1);
+    DOCTEST_CHECK(funcs[0].parsed_func_.func_name_ == "foo");
+    DOCTEST_REQUIRE(funcs[0].parsed_func_.args_.as_vec_.size() == 2);
+    DOCTEST_CHECK(
+      funcs[0].parsed_func_.args_.as_vec_[0].value_ == "bar(1,2;3)");
+    DOCTEST_CHECK(funcs[0].parsed_func_.args_.as_vec_[1].value_ == "b");
+  }
+  DOCTEST_TEST_CASE("split_to_funcs 3") {
+    /// \note escaped quotes and whitespace
+    /// inside string literals are kept
+    std::vector<parsed_func> funcs
+      = split_to_funcs(R"raw(foo(a = "x \" ;, y", b = R"d(q ")" )d"))raw");
+    DOCTEST_REQUIRE(funcs.size() == 1);
+    DOCTEST_REQUIRE(funcs[0].parsed_func_.args_.as_vec_.size() == 2);
+    DOCTEST_CHECK(
+      funcs[0].parsed_func_.args_.as_vec_[0].value_
+        == R"raw("x \" ;, y")raw");
+    DOCTEST_CHECK(
+      funcs[0].parsed_func_.args_.as_vec_[1].value_
+        == R"raw(R"d(q ")" )d")raw");
+  }
+}
+
+DOCTEST_TEST_SUITE("split_to_funcs raw string prefix") {
+  using namespace flexlib;
+
+  DOCTEST_TEST_CASE("raw string with encoding prefix") {
+    /// \note inner quote and separators are part of raw string
+    for(const char* prefix: {"R", "LR", "uR", "UR", "u8R"}) {
+      const std::string rawString
+        = std::string(prefix) + R"raw("d(x", y;)d")raw";
+      std::vector<parsed_func> funcs
+        = split_to_funcs("foo(a = " + rawString + ")");
+      DOCTEST_REQUIRE(funcs.size() == 1);
+      DOCTEST_REQUIRE(funcs[0].parsed_func_.args_.as_vec_.size() == 1);
+      DOCTEST_CHECK(
+        funcs[0].parsed_func_.args_.as_vec_[0].value_ == rawString);
+    }
+  }
+  DOCTEST_TEST_CASE("identifier that ends with R") {
+    /// \note FOR"(x" is identifier followed by ordinary string literal
+    std::vector<parsed_func> funcs
+      = split_to_funcs(R"raw(foo(a = FOR"(x", b = ")"))raw");
+    DOCTEST_REQUIRE(funcs.size() == 1);
+    DOCTEST_REQUIRE(funcs[0].parsed_func_.args_.as_vec_.size() == 2);
+    DOCTEST_CHECK(
+      funcs[0].parsed_func_.args_.as_vec_[0].value_ == R"raw(FOR"(x")raw");
+    DOCTEST_CHECK(
+      funcs[0].parsed_func_.args_.as_vec_[1].value_ == R"raw(")")raw");
+  }
+  DOCTEST_TEST_CASE("identifier that ends with encoding prefix") {
+    for(const char* identifier: {"xLR", "xuR", "xu8R", "_UR", "Lu8R"}) {
+      std::vector<parsed_func> funcs
+        = split_to_funcs(
+            std::string("foo(a = ") + identifier + R"raw("(x", b = ")"))raw");
+      DOCTEST_REQUIRE(funcs.size() == 1);
+      DOCTEST_CHECK(funcs[0].parsed_func_.args_.as_vec_.size() == 2);
+    }
+  }
+}
+
+DOCTEST_TEST_SUITE("split_to_flat_funcs") {
+  using namespace flexlib;
+
+  DOCTEST_TEST_CASE("split_to_flat_funcs 1") {
+    flat_parsed_funcs funcs
+      = split_to_flat_funcs(R"raw(foo(a = 1, b, a = "2") ; bar)raw");
+    DOCTEST_REQUIRE(funcs.size() == 2);
+    DOCTEST_CHECK(
+      funcs[0].func_with_args_as_string_ == R"raw(foo(a=1,b,a="2"))raw");
+    DOCTEST_CHECK(funcs[0].func_name_ == "foo");
+    DOCTEST_REQUIRE(funcs[0].args_.size() == 3);
+    DOCTEST_CHECK(funcs[0].args_[1].name_.empty());
+    DOCTEST_CHECK(funcs[0].args_[1].value_ == "b");
+    DOCTEST_REQUIRE(funcs[0].find_arg("a") != nullptr);
+    DOCTEST_CHECK(funcs[0].find_arg("a")->value_ == "1");
+    DOCTEST_CHECK(funcs[0].count_args("a") == 2);
+    DOCTEST_CHECK(funcs[0].find_arg("b") == nullptr);
+    DOCTEST_CHECK(funcs[1].func_name_ == "bar");
+    DOCTEST_CHECK(funcs[1].args_.empty());
+  }
+  DOCTEST_TEST_CASE("split_to_flat_funcs 2") {
+    /// \note string views remain valid after move
+    flat_parsed_funcs funcs = split_to_flat_funcs("foo(x = 1)");
+    flat_parsed_funcs moved = std::move(funcs);
+    DOCTEST_REQUIRE(moved.size() == 1);
+    parsed_func legacy = to_parsed_func(moved[0]);
+    DOCTEST_CHECK(legacy.func_with_args_as_string_ == "foo(x=1)");
+    DOCTEST_CHECK(legacy.parsed_func_.func_name_ == "foo");
+    DOCTEST_REQUIRE(legacy.parsed_func_.args_.as_vec_.size() == 1);
+    DOCTEST_CHECK(
+      legacy.parsed_func_.args_.as_name_to_value_.at("x").front() == "1");
+  }
+}
 #endif // DISABLE_DOCTEST
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/Support/VirtualFileSystem.h>
+
+#include <base/macros.h>
+#include <base/files/file_path.h>
+#include <base/strings/string_piece.h>
+#include <base/synchronization/lock.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace flexlib {
+
+class OutputSink;
+
+// Keeps generated files (like headers named by
+// |clang_utils::normalizeFileName|) in memory,
+// so later passes in same process parse them
+// without disk round-trip.
+//
+// |OutputSink| created with overlay writes into it,
+// |createFileSystem| returns file system for |clang::tooling::ClangTool|
+// where generated files shadow files on disk
+// (see |ParallelAnnotationDriver::Options::generatedFilesOverlay|).
+// |flushToDisk| optionally writes generated files at the end of run.
+//
+// USAGE:
+// flexlib::GeneratedFilesOverlay overlay;
+// flexlib::OutputSink overlaySink(&overlay);
+// // pass 1 writes into |overlaySink|,
+// // pass 2 uses |overlay.createFileSystem(...)|
+// flexlib::OutputSink diskSink;
+// overlay.flushToDisk(&diskSink);
+//
+/// \note thread-safe
+/// \note only files read through returned file system
+/// see generated files (not |AnnotationPrescanner|
+/// or |AnnotationResultCache|)
+class GeneratedFilesOverlay {
+public:
+  GeneratedFilesOverlay();
+
+  ~GeneratedFilesOverlay();
+
+  // Adds or replaces file at absolute |path|.
+  // Returns |false| if file with same contents already exists.
+  bool addFile(
+    const base::FilePath& path
+    , base::StringPiece contents);
+
+  // |true| if file at |path| was added
+  bool hasFile(const base::FilePath& path) const;
+
+  // Returns file system that reads generated files from memory
+  // and other files from |baseFileSystem|.
+  /// \note returned file system sees files added before call
+  /// \note each call returns new file system (with own working directory),
+  /// so result may be used by one thread only
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> createFileSystem(
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> baseFileSystem) const;
+
+  // Writes all generated files using |diskSink|
+  // (unchanged files are skipped by |OutputSink|).
+  // Returns |false| if any file can not be written.
+  bool flushToDisk(OutputSink* diskSink) const;
+
+  size_t numFiles() const;
+
+private:
+  // contents shared with |llvm::MemoryBuffer| of created file systems,
+  // so replaced file stays valid while file system uses it
+  using SharedContents = std::shared_ptr<const std::string>;
+
+  mutable base::Lock lock_;
+
+  // guarded by |lock_|
+  std::map<base::FilePath, SharedContents> files_;
+
+  DISALLOW_COPY_AND_ASSIGN(GeneratedFilesOverlay);
+};
+
+} // namespace flexlib
@@ -1,5 +1,11 @@
 ﻿#pragma once
 
+#include "flexlib/matchers/traversal_scope.hpp"
+#include "flexlib/matchers/annotation_visitor.hpp"
+#include "flexlib/replacement_collector.hpp"
+#include "flexlib/token_boundary_index.hpp"
+#include "flexlib/reflect/ReflectionArena.hpp"
+
 #include <clang/Rewrite/Core/Rewriter.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
 #include <clang/AST/ASTContext.h>
@@ -18,6 +24,10 @@
 #include <base/memory/ref_counted.h>
 #include <base/sequence_checker.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace clang_utils {
 
 using MatchResult
@@ -38,6 +48,14 @@ typedef
          , clang::Rewriter&)
   > EndSourceFileActionCallback;
 
+// Receives edits collected for translation unit
+// (see |collectFileEdits|).
+typedef
+  base::RepeatingCallback<
+    void(const clang::FileID&
+         , const ReplacementCollector&)
+  > ExportReplacementsCallback;
+
 class AnnotationMatchOptions
   : public base::RefCountedThreadSafe<AnnotationMatchOptions>
 {
@@ -56,6 +74,58 @@ class AnnotationMatchOptions
   // may be used to save result after clang-rewrite
   EndSourceFileActionCallback endSourceFileAction;
 
+  // Annotation methods (annotation without |kRequiredAnnotationPrefix|
+  // must start with one of them, like "{executeCodeAndReplace};")
+  // that |MultiplexAnnotateMatchCallback| will route to
+  // |annotationMatchCallback|.
+  /// \note empty list means that all annotations will be routed
+  std::vector<std::string> annotationMethodPrefixes;
+
+  // If set, AST matchers will visit only top-level decls
+  // from main file and from headers matching |traversalHeaderGlobs|
+  // (see |clang::ASTContext::setTraversalScope|).
+  /// \note annotations from other headers will not be found
+  bool restrictTraversalScope = false;
+
+  // see |TraversalScopeFilter|
+  std::vector<std::string> traversalHeaderGlobs;
+
+  // filled only if |restrictTraversalScope| is set
+  TraversalScopeStats traversalScopeStats;
+
+  // |AnnotationMatchBackend::kAttrVisitor| is used only if
+  // all options passed to |AnnotateConsumer| select it
+  AnnotationMatchBackend matchBackend
+    = AnnotationMatchBackend::kMatchFinder;
+
+  // If set, edits made by |replaceText| (like |replaceWith|)
+  // are collected into |ReplacementCollector|, checked for conflicts
+  // and applied once in |AnnotationMatchAction::EndSourceFileAction|
+  // (before |endSourceFileAction|).
+  /// \note collector is used if any of options passed
+  /// to |AnnotationMatchAction| sets it
+  bool collectReplacements = false;
+
+  // If set (and |collectReplacements| is set), collected edits
+  // are passed to callback instead of being applied to |clang::Rewriter|,
+  // so |endSourceFileAction| sees unmodified buffers
+  // and only edit set may be saved (see |serializeFileEdits|).
+  /// \note all options passed to one |AnnotationMatchAction|
+  /// must set it or none of them, otherwise file is not processed
+  /// (edits of options that expect them to be applied would be lost)
+  ExportReplacementsCallback exportReplacements;
+
+  // If set, reflection nodes created by callbacks
+  // (see |reflection::MakeReflectionNode|) are allocated
+  // in |reflection::ReflectionArena| of translation unit
+  // and freed together at end of |AnnotationMatchAction::EndSourceFileAction|.
+  /// \note callbacks must not keep reflection nodes
+  /// after translation unit
+  /// \note arena is current only while callbacks of options
+  /// that set it run, callbacks of other options
+  /// passed to same |AnnotationMatchAction| are not affected
+  bool useReflectionArena = false;
+
 private:
  friend class base::RefCountedThreadSafe<AnnotationMatchOptions>;
  ~AnnotationMatchOptions() = default;
@@ -71,7 +141,8 @@ class AnnotateMatchCallback
 public:
   AnnotateMatchCallback(
     clang::Rewriter &rewriter
-    , scoped_refptr<AnnotationMatchOptions> annotateOptions);
+    , scoped_refptr<AnnotationMatchOptions> annotateOptions
+    , reflection::ReflectionArena* reflectionArena = nullptr);
 
   void run(const MatchResult& Result) override;
 
@@ -80,11 +151,51 @@ private:
 
   scoped_refptr<AnnotationMatchOptions> annotateOptions_;
 
+  // arena of translation unit (may be |nullptr|),
+  // see |AnnotationMatchOptions::useReflectionArena|
+  reflection::ReflectionArena* reflectionArena_;
+
   SEQUENCE_CHECKER(sequence_checker_);
 
   DISALLOW_COPY_AND_ASSIGN(AnnotateMatchCallback);
 };
 
+using AnnotationMatchOptionsList
+  = std::vector<scoped_refptr<AnnotationMatchOptions>>;
+
+// Called when the |Match| registered for |clang::AnnotateAttr|
+// was successfully found in the AST.
+// Routes each annotation of found declaration
+// (declaration may have many |clang::AnnotateAttr|)
+// to each |AnnotationMatchOptions|
+// that accepts its annotation method
+// (see |AnnotationMatchOptions::annotationMethodPrefixes|),
+// so many plugin families can share single AST traversal.
+class MultiplexAnnotateMatchCallback
+  : public clang::ast_matchers::MatchFinder::MatchCallback
+{
+public:
+  MultiplexAnnotateMatchCallback(
+    clang::Rewriter &rewriter
+    , const AnnotationMatchOptionsList& annotateOptions
+    , reflection::ReflectionArena* reflectionArena = nullptr);
+
+  void run(const MatchResult& Result) override;
+
+private:
+  clang::Rewriter& rewriter_;
+
+  AnnotationMatchOptionsList annotateOptions_;
+
+  // arena of translation unit (may be |nullptr|),
+  // see |AnnotationMatchOptions::useReflectionArena|
+  reflection::ReflectionArena* reflectionArena_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(MultiplexAnnotateMatchCallback);
+};
+
 // The ASTConsumer will read AST.
 // It provides many interfaces to be overridden when
 // certain type of AST node has been parsed,
@@ -93,12 +204,26 @@ class AnnotateConsumer
   : public clang::ASTConsumer
 {
 public:
+  // |reflectionArena| is passed to callbacks,
+  // see |AnnotationMatchOptions::useReflectionArena|
   explicit AnnotateConsumer(
     clang::Rewriter &Rewriter
-    , scoped_refptr<AnnotationMatchOptions> annotateOptions);
+    , scoped_refptr<AnnotationMatchOptions> annotateOptions
+    , reflection::ReflectionArena* reflectionArena = nullptr);
+
+  // Single |MatchFinder| traversal for all |annotateOptions|
+  // (see |MultiplexAnnotateMatchCallback|).
+  AnnotateConsumer(
+    clang::Rewriter &Rewriter
+    , const AnnotationMatchOptionsList& annotateOptions
+    , reflection::ReflectionArena* reflectionArena = nullptr);
 
   ~AnnotateConsumer() override = default;
 
+  // Collects top-level decls for |clang::ASTContext::setTraversalScope|
+  // (only if |AnnotationMatchOptions::restrictTraversalScope| is set).
+  bool HandleTopLevelDecl(clang::DeclGroupRef declGroup) override;
+
   // HandleTranslationUnit() called only after
   // the entire source file is parsed.
   // Translation unit effectively represents an entire source file.
@@ -107,9 +232,24 @@ public:
 private:
   clang::ast_matchers::MatchFinder matchFinder;
 
-  AnnotateMatchCallback annotateMatchCallback_;
+  std::unique_ptr<
+    clang::ast_matchers::MatchFinder::MatchCallback
+  > annotateMatchCallback_;
 
-  scoped_refptr<AnnotationMatchOptions> annotateOptions_;
+  AnnotationMatchOptionsList annotateOptions_;
+
+  // created only if all |annotateOptions_|
+  // have |restrictTraversalScope|
+  std::unique_ptr<TraversalScopeFilter> traversalScopeFilter_;
+
+  // top-level decls allowed by |traversalScopeFilter_|
+  std::vector<clang::Decl*> traversalScope_;
+
+  size_t skippedTopLevelDecls_ = 0;
+
+  // used instead of |matchFinder| if not null
+  // (see |AnnotationMatchOptions::matchBackend|)
+  std::unique_ptr<AnnotateAttrVisitor> annotateAttrVisitor_;
 
   SEQUENCE_CHECKER(sequence_checker_);
 
@@ -129,6 +269,11 @@ public:
   explicit AnnotationMatchAction(
     scoped_refptr<AnnotationMatchOptions> annotateOptions);
 
+  // Parses file once for all |annotateOptions|
+  // (see |MultiplexAnnotateMatchCallback|).
+  explicit AnnotationMatchAction(
+    const AnnotationMatchOptionsList& annotateOptions);
+
   ASTConsumerPointer CreateASTConsumer(
     // pass a pointer to the CompilerInstance because
     // it contains a lot of contextual information
@@ -140,13 +285,34 @@ public:
     // it contains a lot of contextual information
     clang::CompilerInstance&) override;
 
+  // parses translation unit
+  void ExecuteAction() override;
+
   void EndSourceFileAction() override;
 
+protected:
+  clang::Rewriter& getRewriter() { return rewriter_; }
+
 private:
   // Rewriter lets you make textual changes to the source code
   clang::Rewriter rewriter_;
 
-  scoped_refptr<AnnotationMatchOptions> annotateOptions_;
+  AnnotationMatchOptionsList annotateOptions_;
+
+  // |true| if created for |AnnotationMatchOptionsList|
+  bool isMultiplexed_ = false;
+
+  // created by |CreateASTConsumer|
+  // if |AnnotationMatchOptions::collectReplacements| is set
+  std::unique_ptr<ReplacementCollector> replacementCollector_;
+
+  // created by |CreateASTConsumer|
+  // if |AnnotationMatchOptions::useReflectionArena| is set
+  std::unique_ptr<reflection::ReflectionArena> reflectionArena_;
+
+  // created by |CreateASTConsumer|, current while callbacks run
+  // (used by |findSemiAfterLocation|)
+  std::unique_ptr<TokenBoundaryIndexCache> tokenIndexCache_;
 
   SEQUENCE_CHECKER(sequence_checker_);
 
@@ -160,10 +326,16 @@ struct AnnotationMatchFactory
   AnnotationMatchFactory(
     scoped_refptr<AnnotationMatchOptions> annotateOptions);
 
+  AnnotationMatchFactory(
+    const AnnotationMatchOptionsList& annotateOptions);
+
   clang::FrontendAction* create() override;
 
 private:
-  scoped_refptr<AnnotationMatchOptions> annotateOptions_;
+  AnnotationMatchOptionsList annotateOptions_;
+
+  // |true| if created for |AnnotationMatchOptionsList|
+  bool isMultiplexed_ = false;
 
   SEQUENCE_CHECKER(sequence_checker_);
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclBase.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+
+#include <base/macros.h>
+#include <base/sequence_checker.h>
+
+#include <string>
+#include <vector>
+
+namespace clang_utils {
+
+// How |AnnotateConsumer| finds decls with |clang::AnnotateAttr|.
+enum class AnnotationMatchBackend {
+  // `decl(hasAttr(attr::Annotate))` using |MatchFinder|
+  kMatchFinder
+  // |AnnotateAttrVisitor|, avoids memoization
+  // and bound nodes of generic AST matchers
+  , kAttrVisitor
+};
+
+// Alternative to |MatchFinder| for single matcher
+// `decl(hasAttr(attr::Annotate))`.
+// Checks only decls that have attributes and passes same
+// |MatchFinder::MatchResult| to |MatchFinder::MatchCallback|
+// (decl is bound to each of |boundNames|),
+// so callbacks work with both |AnnotationMatchBackend|.
+/// \note visits same nodes as |MatchFinder|
+/// (template instantiations and implicit code)
+/// and respects |clang::ASTContext::setTraversalScope|.
+class AnnotateAttrVisitor
+  : public clang::RecursiveASTVisitor<AnnotateAttrVisitor>
+{
+public:
+  AnnotateAttrVisitor(
+    const std::vector<std::string>& boundNames
+    , clang::ast_matchers::MatchFinder::MatchCallback* matchCallback);
+
+  void matchAST(clang::ASTContext& context);
+
+  bool shouldVisitTemplateInstantiations() const { return true; }
+
+  bool shouldVisitImplicitCode() const { return true; }
+
+  bool VisitDecl(clang::Decl* decl);
+
+private:
+  std::vector<std::string> boundNames_;
+
+  clang::ast_matchers::MatchFinder::MatchCallback* matchCallback_;
+
+  // valid only during |matchAST|
+  clang::ASTContext* context_ = nullptr;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(AnnotateAttrVisitor);
+};
+
+} // namespace clang_utils
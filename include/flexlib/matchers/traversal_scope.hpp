@@ -0,0 +1,60 @@
+#pragma once
+
+#include <clang/AST/DeclBase.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/GlobPattern.h>
+
+#include <base/macros.h>
+#include <base/sequence_checker.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace clang_utils {
+
+// Counters of top-level decls passed to |clang::ASTContext::setTraversalScope|.
+/// \note may be updated from many threads
+/// (same |AnnotationMatchOptions| may be used by many actions)
+struct TraversalScopeStats {
+  // top-level decls that will be visited by AST matchers
+  std::atomic<size_t> traversedDecls{0};
+
+  // top-level decls from headers that will never be visited
+  std::atomic<size_t> skippedDecls{0};
+};
+
+// Decides which top-level decls must be visited by AST matchers.
+// Allows decls from main file and from headers
+// which file name matches one of |headerGlobs|.
+// EXAMPLE:
+// // traverse main file and generated headers
+// TraversalScopeFilter filter({"*/generated/*.hpp"});
+class TraversalScopeFilter {
+public:
+  explicit TraversalScopeFilter(
+    const std::vector<std::string>& headerGlobs);
+
+  bool shouldTraverse(
+    const clang::Decl* decl
+    , const clang::SourceManager& SM);
+
+private:
+  bool isAllowedFile(
+    const clang::FileID& fileID
+    , const clang::SourceManager& SM);
+
+  std::vector<llvm::GlobPattern> headerGlobs_;
+
+  // result of |isAllowedFile| by |clang::FileID|
+  llvm::DenseMap<clang::FileID, bool> allowedFiles_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(TraversalScopeFilter);
+};
+
+} // namespace clang_utils
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <base/macros.h>
+#include <base/files/file_path.h>
+#include <base/strings/string_piece.h>
+#include <base/time/time.h>
+#include <base/synchronization/lock.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+
+namespace flexlib {
+
+class GeneratedFilesOverlay;
+
+// Writes rewritten and generated files only if contents changed,
+// so unchanged outputs keep their modification time
+// and build system does not rebuild dependents.
+//
+// Existing file is compared by size first, then by contents
+// (or by SHA1 of contents if file hash is remembered).
+// Contents are hashed only if size matches or file is written.
+// Hashes of files read or written by sink are remembered
+// (by path, modification time and size), so same output
+// is not read again during run.
+// Changed file is written to temporary file and renamed atomically.
+//
+// USAGE:
+// flexlib::OutputSink outputSink;
+// // in |AnnotationMatchHandler::SaveFileHandler|
+// outputSink.writeRewriteBuffer(outputPath, rewriter, fileID);
+// // in generator
+// outputSink.writeIfChanged(generatedPath, generatedContents);
+//
+/// \note thread-safe, may be shared by all workers
+class OutputSink {
+public:
+  enum class WriteResult {
+    kWritten
+    // file already has same contents
+    , kSkipped
+    , kFailed
+  };
+
+  struct Stats {
+    std::atomic<size_t> written{0};
+
+    std::atomic<size_t> skipped{0};
+
+    std::atomic<size_t> failed{0};
+  };
+
+  OutputSink();
+
+  // Writes into |generatedFilesOverlay| instead of disk,
+  // see |GeneratedFilesOverlay::flushToDisk|.
+  /// \note |generatedFilesOverlay| must outlive sink
+  /// \note paths passed to sink must be absolute
+  /// (relative path fails with |WriteResult::kFailed|)
+  explicit OutputSink(GeneratedFilesOverlay* generatedFilesOverlay);
+
+  ~OutputSink();
+
+  WriteResult writeIfChanged(
+    const base::FilePath& outputPath
+    , base::StringPiece contents);
+
+  // Writes buffer of |fileID| edited by |rewriter|
+  // (or original buffer if |rewriter| has no edits for |fileID|).
+  WriteResult writeRewriteBuffer(
+    const base::FilePath& outputPath
+    , const clang::Rewriter& rewriter
+    , clang::FileID fileID);
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct FileHash {
+    base::Time lastModified;
+
+    int64_t size = 0;
+
+    // SHA1 of file contents
+    std::string contentHash;
+  };
+
+  // |true| if file at |outputPath| has same size and contents.
+  // Stores hash of |contents| into |contentHash|
+  // if it was required for comparison (otherwise keeps it empty).
+  bool isSameContents(
+    const base::FilePath& outputPath
+    , base::StringPiece contents
+    , std::string* contentHash);
+
+  void rememberFileHash(
+    const base::FilePath& outputPath
+    , const std::string& contentHash);
+
+  // not null if sink writes into memory
+  GeneratedFilesOverlay* generatedFilesOverlay_ = nullptr;
+
+  Stats stats_;
+
+  base::Lock fileHashesLock_;
+
+  // guarded by |fileHashesLock_|
+  std::map<base::FilePath, FileHash> fileHashes_;
+
+  DISALLOW_COPY_AND_ASSIGN(OutputSink);
+};
+
+} // namespace flexlib
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "flexlib/matchers/annotation_matcher.hpp"
+#include "flexlib/annotation_prescan.hpp"
+
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <base/macros.h>
+#include <base/callback.h>
+#include <base/optional.h>
+#include <base/memory/ref_counted.h>
+#include <base/sequence_checker.h>
+#include <base/synchronization/lock.h>
+#include <base/synchronization/condition_variable.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flexlib {
+class GeneratedFilesOverlay;
+} // namespace flexlib
+
+namespace clang_utils {
+
+class AnnotationResultCache;
+class SharedPrecompiledHeader;
+
+// File read by clang while processing translation unit.
+struct AnnotationFileDependency {
+  std::string path;
+
+  // see |computeContentHash|
+  std::string contentHash;
+};
+
+// Result of |AnnotationMatchAction| for single translation unit.
+struct AnnotationFileResult {
+  enum class Status {
+    // clang tool finished without errors
+    kDone
+    // clang tool reported errors
+    , kFailed
+    // clang tool was not started,
+    // because |flexlib::AnnotationPrescanner| found no annotations
+    /// \note not passed to |AnnotationFileResultCallback|,
+    /// file is left as is
+    , kSkipped
+  };
+
+  // index of file in list passed to |ParallelAnnotationDriver::run|
+  size_t index = 0;
+
+  std::string sourcePath;
+
+  Status status = Status::kFailed;
+
+  // |true| if |clang::Rewriter| has edits for main file
+  bool isRewritten = false;
+
+  // contents of main file after |clang::Rewriter| edits
+  /// \note contains original file contents if |!isRewritten|
+  std::string rewrittenBuffer;
+
+  // Additional files produced for translation unit
+  // (by path), see |CollectSideOutputsCallback|.
+  /// \note |AnnotationFileResultCallback| must write them,
+  /// because plugins are not called if |isFromCache|
+  std::map<std::string, std::string> sideOutputs;
+
+  // |true| if result was replayed by |AnnotationResultCache|
+  // without running clang tool
+  bool isFromCache = false;
+
+  // filled only if |AnnotationResultCache| is used
+  std::vector<AnnotationFileDependency> dependencies;
+
+  // Absolute paths searched for included headers
+  // before directory header was found in,
+  // so new file on any of them shadows included header.
+  // Filled only if |AnnotationResultCache| is used.
+  /// \note lookups of |__has_include| are not recorded
+  std::vector<std::string> absentDependencies;
+};
+
+// Creates |AnnotationMatchOptions| used by single worker.
+/// \note callbacks stored in returned options
+/// are called only on worker thread with index |workerIndex|,
+/// so they may be bound to per-worker state
+/// (like |AnnotationMatchHandler| and |AnnotationParser|).
+/// \note |endSourceFileAction| of all workers runs one at a time
+/// in order of source files (see |ParallelAnnotationDriver|),
+/// so it may also write shared state (like output files).
+typedef
+  base::RepeatingCallback<
+    scoped_refptr<AnnotationMatchOptions>(size_t workerIndex)
+  > CreateWorkerOptionsCallback;
+
+// Called on sequence that started |ParallelAnnotationDriver::run|
+// in order of source files (not in order of completion),
+// so output produced by it does not depend on number of workers.
+/// \note not called for translation units skipped by pre-scan
+/// (see |AnnotationFileResult::Status::kSkipped|)
+typedef
+  base::RepeatingCallback<
+    void(const AnnotationFileResult&)
+  > AnnotationFileResultCallback;
+
+// Called on worker thread with index |workerIndex|
+// after |endSourceFileAction| from worker options.
+// Must move outputs produced by per-worker state
+// (like files generated by |AnnotationMatchHandler::endSourceFileHandler|)
+// into |AnnotationFileResult::sideOutputs|,
+// so they can be stored in |AnnotationResultCache|.
+typedef
+  base::RepeatingCallback<
+    void(size_t workerIndex, AnnotationFileResult* result)
+  > CollectSideOutputsCallback;
+
+// Runs |AnnotationMatchAction| over files from compilation database
+// using pool of worker threads.
+//
+// Each worker gets own |AnnotationMatchOptions|
+// (see |CreateWorkerOptionsCallback|) and each translation unit gets own
+// |clang::CompilerInstance| and |clang::Rewriter|.
+// |endSourceFileAction| from worker options is called on worker thread,
+// but only after |endSourceFileAction| of all previous source files
+// finished (translation units are parsed in parallel,
+// end of file callbacks form single sequence in order of source files),
+// then rewritten main file is passed to |onFileResult| by merge step.
+//
+// USAGE:
+// clang_utils::ParallelAnnotationDriver::Options driverOptions;
+// driverOptions.createWorkerOptions
+//   = base::BindRepeating(&createOptionsForWorker);
+// driverOptions.onFileResult
+//   = base::BindRepeating(&saveRewrittenFile);
+// // optional
+// driverOptions.prescanner = &annotationPrescanner;
+// driverOptions.resultCache = &annotationResultCache;
+// clang_utils::ParallelAnnotationDriver driver(
+//   compilationDatabase, std::move(driverOptions));
+// const bool ok = driver.run(compilationDatabase.getAllFiles());
+class ParallelAnnotationDriver {
+public:
+  struct Options {
+    // uses |base::SysInfo::NumberOfProcessors| if zero
+    /// \note worker holds whole AST of parsed translation unit
+    /// while it waits for its turn to run |endSourceFileAction|,
+    /// so peak memory grows with number of workers
+    /// (and with parse time of earlier source files)
+    size_t numWorkers = 0;
+
+    CreateWorkerOptionsCallback createWorkerOptions;
+
+    AnnotationFileResultCallback onFileResult;
+
+    // Skips translation units without annotations if not null.
+    /// \note ignored if |generatedFilesOverlay| is set,
+    /// pre-scan reads files from disk and would miss
+    /// annotations in generated files
+    /// \note must outlive |ParallelAnnotationDriver::run|
+    flexlib::AnnotationPrescanner* prescanner = nullptr;
+
+    // Replays stored results of unchanged translation units
+    // and stores new results if not null.
+    /// \note ignored if |generatedFilesOverlay| is set,
+    /// stored results are validated against files on disk
+    /// and would be replayed after generated files changed
+    /// \note must outlive |ParallelAnnotationDriver::run|
+    AnnotationResultCache* resultCache = nullptr;
+
+    CollectSideOutputsCallback collectSideOutputs;
+
+    // Precompiled header for common include prefix
+    // used by all translation units if not null.
+    /// \note |SharedPrecompiledHeader::prepare| must be called before |run|
+    /// \note must outlive |ParallelAnnotationDriver::run|
+    SharedPrecompiledHeader* precompiledHeader = nullptr;
+
+    // Translation units see files generated by previous passes
+    // from memory (files on disk are shadowed) if not null.
+    /// \note must outlive |ParallelAnnotationDriver::run|
+    flexlib::GeneratedFilesOverlay* generatedFilesOverlay = nullptr;
+  };
+
+  ParallelAnnotationDriver(
+    const clang::tooling::CompilationDatabase& compilations
+    , Options&& options);
+
+  ~ParallelAnnotationDriver();
+
+  // Blocks until all |sourcePaths| are processed.
+  // Returns |false| if clang tool failed for any of |sourcePaths|.
+  bool run(const std::vector<std::string>& sourcePaths);
+
+private:
+  class Worker;
+
+  // called by workers
+  size_t takeNextIndex();
+
+  // called by workers
+  void storeResult(AnnotationFileResult&& result);
+
+  // called by workers
+  // blocks until |endSourceFileAction| of all source files
+  // before |index| finished
+  void waitForEndSourceFileTurn(size_t index);
+
+  // called by workers (for every index, even if
+  // |waitForEndSourceFileTurn| was not called)
+  void finishEndSourceFileTurn(size_t index);
+
+  // called on |sequence_checker_|
+  // blocks until result for |index| becomes available
+  AnnotationFileResult waitForResult(size_t index);
+
+  const clang::tooling::CompilationDatabase& compilations_;
+
+  Options options_;
+
+  // files passed to |run|
+  const std::vector<std::string>* sourcePaths_ = nullptr;
+
+  std::atomic<size_t> nextIndex_{0};
+
+  base::Lock resultsLock_;
+
+  base::ConditionVariable resultReady_;
+
+  // guarded by |resultsLock_|
+  std::vector<base::Optional<AnnotationFileResult>> results_;
+
+  base::Lock endSourceFileTurnLock_;
+
+  base::ConditionVariable endSourceFileTurnReady_;
+
+  // guarded by |endSourceFileTurnLock_|
+  size_t nextEndSourceFileTurn_ = 0;
+
+  // guarded by |endSourceFileTurnLock_|
+  std::vector<bool> finishedEndSourceFileTurns_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelAnnotationDriver);
+};
+
+} // namespace clang_utils
@@ -9,4 +9,7 @@ extern const char kAnnotateAttrName[];
 
 extern const char kRequiredAnnotationPrefix[];
 
+// spelling of attribute used by annotations in source files
+extern const char kAnnotateAttrSpelling[];
+
 } // namespace flexlib
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "flexlib/reflect/ReflTypes.hpp"
+#include "flexlib/reflect/ReflectAST.hpp"
+
+#include <clang/AST/DeclCXX.h>
+
+#include <base/macros.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace reflection
+{
+
+// Proxy returned by |AstReflector::ReflectClassLazy|.
+// Name, scope, location, template params and flags
+// (like |ClassInfo::isAbstract|) are reflected on creation.
+// Other sections of |ClassInfo| (methods, bases, members
+// with inner declarations and record layout) are reflected
+// on first access and then reused.
+//
+// Generator that needs only names and methods of class
+// does not pay for |TypeInfo| of bases and members
+// and for record layout.
+//
+// EXAMPLE:
+// reflection::LazyClassInfoPtr classInfo
+//   = reflector.ReflectClassLazy(record, &namespacesTree);
+// for (const reflection::MethodInfoPtr& method
+//      : classInfo->GetMethods())
+// {
+//   // ...
+// }
+// // same as result of |AstReflector::ReflectClass|
+// reflection::ClassInfoPtr fullInfo = classInfo->GetClassInfo();
+//
+/// \note not thread-safe, must be used while
+/// |clang::ASTContext| of reflected class is alive
+class LazyClassInfo
+{
+public:
+  // |classInfo| must have sections reflected
+  // by |AstReflector::ReflectClassBasics| or all sections
+  // if |isComplete| is set
+  LazyClassInfo(
+    const AstReflector& reflector
+    , const clang::CXXRecordDecl* decl
+    , NamespacesTree* nsTree
+    , bool recursive
+    , ClassInfoPtr classInfo
+    , bool isComplete);
+
+  const clang::CXXRecordDecl* GetDecl() const { return m_decl; }
+
+  // sections reflected on creation,
+  // other sections are empty until accessed
+  const ClassInfo& GetBasics() const { return *m_classInfo; }
+
+  // also implicit special members
+  const std::vector<MethodInfoPtr>& GetMethods();
+
+  const std::vector<ClassInfo::BaseInfo>& GetBaseClasses();
+
+  const std::vector<MemberInfoPtr>& GetMembers();
+
+  const std::vector<ClassInfo::InnerDeclInfo>& GetInnerDecls();
+
+  // see |ClassInfo::ASTRecordSize|
+  uint64_t GetRecordSize();
+
+  // see |ClassInfo::ASTRecordNonVirtualAlignment|
+  unsigned GetRecordNonVirtualAlignment();
+
+  // Reflects sections that were not accessed yet,
+  // adds result to |NamespacesTree| and |ReflectionCache| (if any).
+  // If class was already added by other proxy or |ReflectClass|,
+  // returns that instance without reflecting sections.
+  /// \note references returned by other getters stay valid,
+  /// they point into own |ClassInfo| of proxy
+  ClassInfoPtr GetClassInfo();
+
+private:
+  enum Section : unsigned
+  {
+    kLayout = 1 << 0
+    , kMethods = 1 << 1
+    , kBases = 1 << 2
+    // members and inner declarations
+    , kDecls = 1 << 3
+    , kAllSections = kLayout | kMethods | kBases | kDecls
+  };
+
+  void EnsureSection(Section section);
+
+  AstReflector m_reflector;
+
+  const clang::CXXRecordDecl* m_decl;
+
+  NamespacesTree* m_nsTree;
+
+  const bool m_recursive;
+
+  // never replaced, getters return references into it
+  ClassInfoPtr m_classInfo;
+
+  // bitmask of |Section|
+  unsigned m_reflectedSections;
+
+  // instance shared with |NamespacesTree| and |ReflectionCache|,
+  // set by |GetClassInfo|
+  ClassInfoPtr m_registeredClassInfo;
+
+  DISALLOW_COPY_AND_ASSIGN(LazyClassInfo);
+};
+
+} // namespace reflection
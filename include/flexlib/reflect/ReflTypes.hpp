@@ -5,8 +5,11 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <unordered_map>
 
 #include "flexlib/reflect/TypeInfo.hpp"
+#include "flexlib/reflect/ReflectionArena.hpp"
+#include "flexlib/reflect/StringInterner.hpp"
 
 /// \todo improve based on p1240r1
 /// http://www.open-std.org/JTC1/SC22/WG21/docs/papers/2019/p1240r1.pdf
@@ -24,9 +27,10 @@ using NamespaceInfoPtr = std::shared_ptr<NamespaceInfo>;
 
 struct NamedDeclInfo
 {
-    std::string name;
-    std::string namespaceQualifier;
-    std::string scopeSpecifier;
+    // interned, same names and qualifiers share storage
+    InternedString name;
+    InternedString namespaceQualifier;
+    InternedString scopeSpecifier;
 
     std::string GetFullQualifiedScope(bool includeGlobalScope = true) const
     {
@@ -49,7 +53,7 @@ struct NamedDeclInfo
     }
     std::string GetScopedName() const
     {
-        return scopeSpecifier.empty() ? name : scopeSpecifier + "::" + name;
+        return scopeSpecifier.empty() ? name.str() : scopeSpecifier + "::" + name;
     }
 };
 
@@ -57,7 +61,7 @@ struct MethodParamInfo
 {
     std::string name;
     TypeInfoPtr type;
-    std::string fullDecl;
+    InternedString fullDecl;
 
     const clang::ParmVarDecl* decl;
 };
@@ -311,9 +315,59 @@ struct NamespaceInfo : public NamedDeclInfo
     const clang::NamespaceDecl *decl = nullptr;
 };
 
+// Namespaces of reflected declarations.
+// Also indexes reflected classes, enums and typedefs
+// by canonical decl and by qualified name,
+// so |AstReflector| finds already reflected declaration in O(1)
+// instead of comparing qualified names of all declarations in namespace.
 class NamespacesTree
 {
 public:
+    ClassInfoPtr FindClass(const clang::CXXRecordDecl* decl)
+    {
+        return FindInIndex(m_classes, decl);
+    }
+
+    EnumInfoPtr FindEnum(const clang::EnumDecl* decl)
+    {
+        return FindInIndex(m_enums, decl);
+    }
+
+    TypedefInfoPtr FindTypedef(const clang::TypedefNameDecl* decl)
+    {
+        return FindInIndex(m_typedefs, decl);
+    }
+
+    // adds |info| to |ns| (if any) and indexes it by |decl|
+    void AddClass(
+        const NamespaceInfoPtr& ns
+        , const clang::CXXRecordDecl* decl
+        , const ClassInfoPtr& info)
+    {
+        AddToIndex(m_classes, decl, info);
+        if (ns)
+            ns->classes.push_back(info);
+    }
+
+    void AddEnum(
+        const NamespaceInfoPtr& ns
+        , const clang::EnumDecl* decl
+        , const EnumInfoPtr& info)
+    {
+        AddToIndex(m_enums, decl, info);
+        if (ns)
+            ns->enums.push_back(info);
+    }
+
+    void AddTypedef(
+        const NamespaceInfoPtr& ns
+        , const clang::TypedefNameDecl* decl
+        , const TypedefInfoPtr& info)
+    {
+        AddToIndex(m_typedefs, decl, info);
+        if (ns)
+            ns->typedefs.push_back(info);
+    }
 
     auto GetRootNamespace() const {return m_rootNamespace;}
     NamespaceInfoPtr GetNamespace(const clang::DeclContext* decl)
@@ -324,7 +378,7 @@ public:
 
         if (decl->isTranslationUnit())
         {
-            NamespaceInfoPtr nsInfo = std::make_shared<NamespaceInfo>();
+            NamespaceInfoPtr nsInfo = MakeReflectionNode<NamespaceInfo>();
             nsInfo->name = "";
             nsInfo->namespaceQualifier = "";
             nsInfo->scopeSpecifier = "";
@@ -352,7 +406,7 @@ public:
             return parentNs;
         }
 
-        NamespaceInfoPtr nsInfo = std::make_shared<NamespaceInfo>();
+        NamespaceInfoPtr nsInfo = MakeReflectionNode<NamespaceInfo>();
         nsInfo->name = nsDecl->getNameAsString();
         nsInfo->namespaceQualifier = parentNs->GetFullQualifiedName();
         nsInfo->scopeSpecifier = "";
@@ -364,8 +418,53 @@ public:
     }
 
 private:
+    template<typename InfoPtr>
+    struct DeclIndex
+    {
+        // by |clang::Decl::getCanonicalDecl|
+        std::unordered_map<const clang::Decl*, InfoPtr> byDecl;
+
+        // redeclarations and specializations of same template
+        // have same qualified name
+        std::unordered_map<std::string, InfoPtr> byQualifiedName;
+    };
+
+    template<typename InfoPtr>
+    static InfoPtr FindInIndex(
+        DeclIndex<InfoPtr>& index
+        , const clang::NamedDecl* decl)
+    {
+        const clang::Decl* canonicalDecl = decl->getCanonicalDecl();
+        auto p = index.byDecl.find(canonicalDecl);
+        if (p != index.byDecl.end())
+            return p->second;
+
+        auto q = index.byQualifiedName.find(
+            decl->getQualifiedNameAsString());
+        if (q == index.byQualifiedName.end())
+            return InfoPtr();
+
+        // next lookup of |decl| will not build qualified name
+        index.byDecl[canonicalDecl] = q->second;
+        return q->second;
+    }
+
+    template<typename InfoPtr>
+    static void AddToIndex(
+        DeclIndex<InfoPtr>& index
+        , const clang::NamedDecl* decl
+        , const InfoPtr& info)
+    {
+        index.byDecl[decl->getCanonicalDecl()] = info;
+        index.byQualifiedName.emplace(
+            decl->getQualifiedNameAsString(), info);
+    }
+
     NamespaceInfoPtr m_rootNamespace;
-    std::map<const clang::DeclContext*, NamespaceInfoPtr> m_namespaces;
+    std::unordered_map<const clang::DeclContext*, NamespaceInfoPtr> m_namespaces;
+    DeclIndex<ClassInfoPtr> m_classes;
+    DeclIndex<EnumInfoPtr> m_enums;
+    DeclIndex<TypedefInfoPtr> m_typedefs;
 };
 
 } // reflection
@@ -1,36 +1,58 @@
 ﻿#pragma once
 
 #include "flexlib/reflect/ReflTypes.hpp"
+#include "flexlib/reflect/ReflectionCache.hpp"
 
 /// \todo improve based on p1240r1
 /// http://www.open-std.org/JTC1/SC22/WG21/docs/papers/2019/p1240r1.pdf
 namespace reflection
 {
 
+class LazyClassInfo;
+using LazyClassInfoPtr = std::shared_ptr<LazyClassInfo>;
+
 using namespace clang;
 
 class AstReflector
 {
 public:
-    explicit AstReflector(const clang::ASTContext* context)
+    // |cache| is optional, see |ReflectionCache|
+    explicit AstReflector(
+        const clang::ASTContext* context
+        , ReflectionCache* cache = nullptr)
         : m_astContext(context)
+        , m_cache(cache)
     {
     }
 
     EnumInfoPtr ReflectEnum(const clang::EnumDecl* decl, NamespacesTree* nsTree);
     TypedefInfoPtr ReflectTypedef(const clang::TypedefNameDecl* decl, NamespacesTree* nsTree);
     ClassInfoPtr ReflectClass(const clang::CXXRecordDecl* decl, NamespacesTree* nsTree, bool recursive = true);
+    // Like |ReflectClass|, but methods, bases, members and layout
+    // are reflected on first access, see |LazyClassInfo|.
+    LazyClassInfoPtr ReflectClassLazy(const clang::CXXRecordDecl* decl, NamespacesTree* nsTree, bool recursive = true);
     MethodInfoPtr ReflectMethod(const clang::FunctionDecl* decl, NamespacesTree* nsTree);
 
     static void SetupNamedDeclInfo(const clang::NamedDecl* decl, NamedDeclInfo* info, const clang::ASTContext* astContext);
 
 private:
+    friend class LazyClassInfo;
 
     const clang::NamedDecl* FindEnclosingOpaqueDecl(const clang::DeclContext* decl);
+    // sections of |ReflectClass|, all except |ReflectClassBasics|
+    // require |decl| with definition
+    void ReflectClassBasics(const clang::CXXRecordDecl* decl, ClassInfo* classInfo);
+    void ReflectClassLayout(const clang::CXXRecordDecl* decl, ClassInfo* classInfo);
+    void ReflectClassMethods(const clang::CXXRecordDecl* decl, ClassInfo* classInfo, NamespacesTree* nsTree);
+    void ReflectClassBases(const clang::CXXRecordDecl* decl, ClassInfo* classInfo);
+    // inner declarations and members
+    void ReflectClassDecls(const clang::CXXRecordDecl* decl, ClassInfo* classInfo, bool recursive);
     void ReflectImplicitSpecialMembers(const clang::CXXRecordDecl* decl, ClassInfo* classInfo, NamespacesTree* nsTree);
 
 private:
     const clang::ASTContext* m_astContext;
+
+    ReflectionCache* m_cache;
 };
 
 } // namespace reflection
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <base/macros.h>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace reflection
+{
+
+// Bump allocator for nodes of reflection graph
+// (|ClassInfo|, |MethodInfo|, |TypeInfo|, ...),
+// so graph of one translation unit uses few large blocks
+// instead of separate heap block and atomic reference count per node.
+// Destructors of all nodes run and blocks are freed together
+// when arena is destroyed.
+//
+// |MakeReflectionNode| allocates node in arena that is current
+// on this thread (see |ScopedCurrent|) and returns non-owning
+// |std::shared_ptr| (aliasing constructor with empty owner),
+// so code that expects |ClassInfoPtr| (and other pointer types)
+// works without changes and copies of pointer do not touch
+// reference count.
+// |New| returns raw pointer.
+//
+// |AnnotationMatchAction| creates arena per translation unit
+// if |AnnotationMatchOptions::useReflectionArena| is set,
+// makes it current only for callbacks of options that set it
+// and destroys it at end of |EndSourceFileAction|.
+//
+// USAGE:
+// reflection::ReflectionArena arena;
+// {
+//   reflection::ReflectionArena::ScopedCurrent scopedArena(&arena);
+//   // nodes are allocated in |arena|
+//   reflection::ClassInfoPtr classInfo
+//     = reflector.ReflectClass(record, &namespacesTree);
+// }
+//
+/// \note nodes (and pointers to them) are valid only while arena is alive,
+/// so do not keep them after translation unit
+/// (like in |ReflectionCache::Lifetime::kRun|)
+/// \note not thread-safe, use arena per thread
+class ReflectionArena
+{
+public:
+  // Makes |arena| current for this thread while in scope.
+  // |nullptr| disables arena of outer scope
+  // (nodes are created by |std::make_shared|).
+  class ScopedCurrent
+  {
+  public:
+    explicit ScopedCurrent(ReflectionArena* arena);
+
+    ~ScopedCurrent();
+
+  private:
+    ReflectionArena* m_previous;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedCurrent);
+  };
+
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit ReflectionArena(size_t blockSize = kDefaultBlockSize);
+
+  ~ReflectionArena();
+
+  // Returns arena made current by |ScopedCurrent| on this thread
+  // or |nullptr|.
+  static ReflectionArena* Current();
+
+  template<typename T, typename... Args>
+  T* New(Args&&... args)
+  {
+    void* memory = Allocate(sizeof(T), alignof(T));
+    T* object = new (memory) T(std::forward<Args>(args)...);
+    m_destructors.push_back(Destructor{
+      [](void* ptr) { static_cast<T*>(ptr)->~T(); }
+      , object});
+    return object;
+  }
+
+  // Returns pointer that does not own node, see |New|.
+  template<typename T, typename... Args>
+  std::shared_ptr<T> Make(Args&&... args)
+  {
+    return std::shared_ptr<T>(
+      std::shared_ptr<void>(), New<T>(std::forward<Args>(args)...));
+  }
+
+  // number of objects created by |New| and |Make|
+  size_t GetNumNodes() const { return m_destructors.size(); }
+
+  // bytes of all blocks
+  size_t GetAllocatedBytes() const { return m_allocatedBytes; }
+
+private:
+  struct Destructor
+  {
+    void (*destroy)(void*);
+
+    void* object;
+  };
+
+  void* Allocate(size_t size, size_t alignment);
+
+  const size_t m_blockSize;
+
+  std::vector<std::unique_ptr<char[]>> m_blocks;
+
+  // free space of last block
+  char* m_current = nullptr;
+
+  char* m_end = nullptr;
+
+  size_t m_allocatedBytes = 0;
+
+  // in order of creation
+  std::vector<Destructor> m_destructors;
+
+  DISALLOW_COPY_AND_ASSIGN(ReflectionArena);
+};
+
+// Creates node in current |ReflectionArena| (if any)
+// or by |std::make_shared|.
+template<typename T, typename... Args>
+std::shared_ptr<T> MakeReflectionNode(Args&&... args)
+{
+  ReflectionArena* arena = ReflectionArena::Current();
+  if (!arena) {
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+  return arena->Make<T>(std::forward<Args>(args)...);
+}
+
+} // namespace reflection
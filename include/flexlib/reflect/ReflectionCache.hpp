@@ -1 +1,164 @@
 ﻿#pragma once
+
+#include "flexlib/reflect/ReflTypes.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+
+#include <base/macros.h>
+#include <base/synchronization/lock.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace reflection
+{
+
+// Memoizes |ClassInfo| and |EnumInfo| by clang USR,
+// so class reflected by |AstReflector::ReflectClass|
+// (with its methods, bases, members and |TypeInfo|)
+// is built once instead of once per annotation.
+//
+// |Lifetime::kTranslationUnit| drops all entries
+// in |EndTranslationUnit|.
+// |Lifetime::kRun| keeps entries between translation units,
+// entries built for other translation unit are returned
+// only by |findClass| and |findEnum|
+// (see note about clang pointers below).
+//
+// Entries are matched by translation unit id,
+// not by |clang::ASTContext| address
+// (next |clang::ASTContext| may be allocated at same address).
+// Id is assigned on first use of |clang::ASTContext|
+// and forgotten in |EndTranslationUnit|, so it is never reused.
+//
+// USAGE:
+// reflection::ReflectionCache reflectionCache(
+//   reflection::ReflectionCache::Lifetime::kTranslationUnit);
+// // in |AnnotationMatchCallback|
+// reflection::AstReflector reflector(
+//   &decl->getASTContext(), &reflectionCache);
+// reflection::ClassInfoPtr classInfo
+//   = reflector.ReflectClass(record, &namespacesTree);
+// // in |EndSourceFileActionCallback|
+// reflectionCache.EndTranslationUnit(&compilerInstance.getASTContext());
+//
+/// \note clang pointers stored in cached entries
+/// (like |ClassInfo::decl| or |TypeInfo::getTypeDecl|)
+/// are valid only while |clang::ASTContext| entry was built for is alive
+/// \note do not use |Lifetime::kRun| with |ReflectionArena|,
+/// nodes allocated in arena are freed at end of translation unit
+/// (|StoreClass| and |StoreEnum| DCHECK that no arena is current)
+/// \note thread-safe, |Lifetime::kRun| cache may be shared by workers
+class ReflectionCache
+{
+public:
+  enum class Lifetime
+  {
+    kTranslationUnit
+    , kRun
+  };
+
+  struct Stats
+  {
+    std::atomic<size_t> hits{0};
+
+    std::atomic<size_t> misses{0};
+  };
+
+  explicit ReflectionCache(Lifetime lifetime);
+
+  ~ReflectionCache();
+
+  // Returns USR of |decl| (stable between translation units)
+  // or empty string if USR can not be generated.
+  static std::string GetUSR(const clang::Decl* decl);
+
+  // Returns cached entry built for translation unit of |astContext|
+  // or |nullptr|.
+  /// \note counts hit or miss
+  ClassInfoPtr LookupClass(
+    const std::string& usr
+    , const clang::ASTContext* astContext
+    , bool recursive);
+
+  EnumInfoPtr LookupEnum(
+    const std::string& usr
+    , const clang::ASTContext* astContext);
+
+  // Returns entry stored for same USR if other thread stored it first,
+  // otherwise stores and returns |classInfo|.
+  ClassInfoPtr StoreClass(
+    const std::string& usr
+    , const clang::ASTContext* astContext
+    , bool recursive
+    , ClassInfoPtr classInfo);
+
+  EnumInfoPtr StoreEnum(
+    const std::string& usr
+    , const clang::ASTContext* astContext
+    , EnumInfoPtr enumInfo);
+
+  // Returns entry built for any |clang::ASTContext| or |nullptr|.
+  /// \note use only fields that do not refer to clang AST
+  /// if entry may be built for other translation unit
+  ClassInfoPtr FindClass(const std::string& usr) const;
+
+  EnumInfoPtr FindEnum(const std::string& usr) const;
+
+  // Drops entries if lifetime is |Lifetime::kTranslationUnit|.
+  // Forgets id of |astContext|, so entries built for it
+  // are not returned by |LookupClass| and |LookupEnum| any more.
+  /// \note must be called before |astContext| is destroyed
+  void EndTranslationUnit(const clang::ASTContext* astContext);
+
+  // number of cached classes and enums
+  size_t GetSize() const;
+
+  Lifetime GetLifetime() const { return lifetime_; }
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  template<typename InfoPtr>
+  struct Entry
+  {
+    InfoPtr info;
+
+    uint64_t translationUnitId = 0;
+  };
+
+  // assigns new id on first use of |astContext|
+  uint64_t GetTranslationUnitIdLocked(const clang::ASTContext* astContext);
+
+  // |ReflectClass| with |recursive| unset skips inner classes,
+  // so it is cached separately
+  static std::string GetClassKey(
+    const std::string& usr
+    , bool recursive);
+
+  const Lifetime lifetime_;
+
+  Stats stats_;
+
+  mutable base::Lock lock_;
+
+  // guarded by |lock_|
+  std::unordered_map<const clang::ASTContext*, uint64_t>
+    translationUnitIds_;
+
+  // guarded by |lock_|, zero is not used as id
+  uint64_t lastTranslationUnitId_ = 0;
+
+  // guarded by |lock_|
+  std::unordered_map<std::string, Entry<ClassInfoPtr>> classes_;
+
+  // guarded by |lock_|
+  std::unordered_map<std::string, Entry<EnumInfoPtr>> enums_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReflectionCache);
+};
+
+} // namespace reflection
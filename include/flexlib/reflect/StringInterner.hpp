@@ -0,0 +1,236 @@
+#pragma once
+
+#include <base/macros.h>
+#include <base/synchronization/lock.h>
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+
+#include <basis/doctest_util.h>
+
+namespace reflection
+{
+
+// Stores one copy of every distinct string,
+// so names repeated in reflection graph
+// (like "::base::internal" or "std::basic_string<char>")
+// share memory and are compared by pointer (see |InternedString|).
+// Strings are kept until interner is destroyed,
+// default interner lives until end of run.
+// Strings are split between shards by hash, every shard has own lock,
+// so threads that parse different translation units
+// rarely wait for each other.
+/// \note thread-safe
+class StringInterner
+{
+public:
+  StringInterner();
+
+  ~StringInterner();
+
+  // Returns stable copy of |str|
+  // or |nullptr| if |str| is empty.
+  const std::string* Intern(const std::string& str);
+
+  // process-wide interner used by |InternedString|
+  static StringInterner* GetDefault();
+
+  // number of distinct strings
+  size_t GetSize() const;
+
+  // bytes of characters of distinct strings
+  size_t GetBytes() const;
+
+private:
+  static constexpr size_t kNumShards = 16;
+
+  struct Shard
+  {
+    mutable base::Lock lock;
+
+    // elements of node-based set do not move on rehash
+    // guarded by |lock|
+    std::unordered_set<std::string> strings;
+
+    // guarded by |lock|
+    size_t bytes = 0;
+  };
+
+  std::array<Shard, kNumShards> m_shards;
+
+  DISALLOW_COPY_AND_ASSIGN(StringInterner);
+};
+
+// Immutable string stored in |StringInterner::GetDefault|.
+// Converts to |const std::string&| without copying,
+// so it can replace |std::string| field of reflection types.
+// Equal interned strings share storage, so |==| of two
+// |InternedString| compares pointers.
+/// \note pointer comparison is valid only because every
+/// |InternedString| is stored in same (default) interner,
+/// do not compare by pointer strings from other |StringInterner|
+//
+// EXAMPLE:
+// reflection::InternedString a = std::string("::base::internal");
+// reflection::InternedString b = "::base::internal";
+// DCHECK(a == b); // same pointer
+// std::string scoped = a + "::" + "Foo";
+class InternedString
+{
+public:
+  InternedString() = default;
+
+  InternedString(const std::string& str)
+    : m_str(StringInterner::GetDefault()->Intern(str))
+  {}
+
+  InternedString(const char* str)
+    : InternedString(std::string(str))
+  {}
+
+  const std::string& str() const;
+
+  operator const std::string&() const { return str(); }
+
+  const char* c_str() const { return str().c_str(); }
+
+  const char* data() const { return str().data(); }
+
+  size_t size() const { return m_str ? m_str->size() : 0; }
+
+  bool empty() const { return !m_str; }
+
+  // same pointer for equal strings
+  const void* identity() const { return m_str; }
+
+  // compares pointers (see |StringInterner::GetDefault|)
+  bool operator==(const InternedString& other) const
+  {
+    return m_str == other.m_str;
+  }
+
+  bool operator!=(const InternedString& other) const
+  {
+    return m_str != other.m_str;
+  }
+
+private:
+  // |nullptr| for empty string
+  const std::string* m_str = nullptr;
+};
+
+inline bool operator==(const InternedString& lhs, const std::string& rhs)
+{
+  return lhs.str() == rhs;
+}
+
+inline bool operator==(const std::string& lhs, const InternedString& rhs)
+{
+  return lhs == rhs.str();
+}
+
+inline bool operator==(const InternedString& lhs, const char* rhs)
+{
+  return lhs.str() == rhs;
+}
+
+inline bool operator!=(const InternedString& lhs, const std::string& rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const std::string& lhs, const InternedString& rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const InternedString& lhs, const char* rhs)
+{
+  return !(lhs == rhs);
+}
+
+// by contents, so order does not depend on addresses
+inline bool operator<(const InternedString& lhs, const InternedString& rhs)
+{
+  return lhs.str() < rhs.str();
+}
+
+// |std::operator+| is template and does not apply conversions
+inline std::string operator+(const InternedString& lhs, const std::string& rhs)
+{
+  return lhs.str() + rhs;
+}
+
+inline std::string operator+(const std::string& lhs, const InternedString& rhs)
+{
+  return lhs + rhs.str();
+}
+
+inline std::string operator+(const InternedString& lhs, const char* rhs)
+{
+  return lhs.str() + rhs;
+}
+
+inline std::string operator+(const char* lhs, const InternedString& rhs)
+{
+  return lhs + rhs.str();
+}
+
+inline std::string operator+(const InternedString& lhs, const InternedString& rhs)
+{
+  return lhs.str() + rhs.str();
+}
+
+inline std::ostream& operator<<(std::ostream& os, const InternedString& str)
+{
+  return os << str.str();
+}
+
+} // namespace reflection
+
+namespace std {
+
+template<>
+struct hash<reflection::InternedString>
+{
+  size_t operator()(const reflection::InternedString& str) const
+  {
+    return std::hash<const void*>()(str.identity());
+  }
+};
+
+} // namespace std
+
+// DISABLE_DOCTEST: custom macro
+#if !defined(DISABLE_DOCTEST)
+
+DOCTEST_TEST_SUITE("InternedString") {
+  using namespace reflection;
+
+  DOCTEST_TEST_CASE("InternedString 1") {
+    InternedString a = std::string("::base::internal");
+    InternedString b = "::base::internal";
+    InternedString c = "::base";
+    DOCTEST_CHECK(a == b);
+    DOCTEST_CHECK(a.identity() == b.identity());
+    DOCTEST_CHECK(a != c);
+    DOCTEST_CHECK(a == std::string("::base::internal"));
+    DOCTEST_CHECK(c + "::internal" == a.str());
+    DOCTEST_CHECK("::" + c == "::::base");
+  }
+  DOCTEST_TEST_CASE("InternedString 2") {
+    InternedString empty;
+    DOCTEST_CHECK(empty.empty());
+    DOCTEST_CHECK(empty.str().empty());
+    DOCTEST_CHECK(empty == InternedString(std::string()));
+    std::string str = "a";
+    str += empty;
+    DOCTEST_CHECK(str == "a");
+  }
+}
+
+#endif // DISABLE_DOCTEST
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include "flexlib/reflect/StringInterner.hpp"
+
 #include <variant>
 
 #include <clang/AST/DeclCXX.h>
@@ -253,22 +255,22 @@ public:
     return m_pointingLevels;
   }
 
-  std::string getDeclaredName() const
+  const std::string& getDeclaredName() const
   {
     return m_declaredName;
   }
 
-  std::string getScopedName() const
+  const std::string& getScopedName() const
   {
     return m_scopedName;
   }
 
-  std::string getFullQualifiedName() const
+  const std::string& getFullQualifiedName() const
   {
     return m_fullQualifiedName;
   }
 
-  std::string getPrintedName() const
+  const std::string& getPrintedName() const
   {
     return m_printedName;
   }
@@ -340,10 +342,11 @@ private:
   bool m_isReference = false;
   bool m_isRVReference = false;
   int m_pointingLevels = 0;
-  std::string m_declaredName;
-  std::string m_scopedName;
-  std::string m_fullQualifiedName;
-  std::string m_printedName;
+  // interned, same type names share storage
+  InternedString m_declaredName;
+  InternedString m_scopedName;
+  InternedString m_fullQualifiedName;
+  InternedString m_printedName;
   Type m_type;
   const clang::Type* m_typeDecl;
 
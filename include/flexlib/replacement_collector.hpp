@@ -0,0 +1,144 @@
+#pragma once
+
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/Core/Replacement.h>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+#include <base/macros.h>
+#include <base/sequence_checker.h>
+
+#include <map>
+#include <string>
+
+namespace clang_utils {
+
+// Collects |clang::tooling::Replacement| per file instead of
+// editing |clang::Rewriter| one edit at a time,
+// so overlapping edits (for example, from different plugins)
+// are reported instead of silently corrupting output.
+// Collected replacements are applied once by |applyAll|.
+//
+// |AnnotationMatchAction| creates collector if
+// |AnnotationMatchOptions::collectReplacements| is set
+// and makes it current while translation unit is parsed,
+// so |replaceText| (and |replaceWith|) record edits into it.
+//
+// USAGE:
+// clang_utils::ReplacementCollector collector(&rewriter);
+// {
+//   clang_utils::ReplacementCollector::ScopedCurrent
+//     scopedCollector(&collector);
+//   // calls |replaceText|
+//   runCallbacks();
+// }
+// collector.applyAll();
+class ReplacementCollector {
+public:
+  // Makes |collector| current for this thread while in scope.
+  class ScopedCurrent {
+  public:
+    explicit ScopedCurrent(ReplacementCollector* collector);
+
+    ~ScopedCurrent();
+
+  private:
+    ReplacementCollector* previous_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedCurrent);
+  };
+
+  // |rewriter| provides |clang::SourceManager| and receives edits
+  // in |applyAll|, must outlive collector
+  explicit ReplacementCollector(clang::Rewriter* rewriter);
+
+  ~ReplacementCollector();
+
+  // Returns error if |replacement| overlaps
+  // with already collected replacement in same file.
+  /// \note insertions at same offset are merged
+  /// in order of addition (see |clang::tooling::Replacements::add|)
+  llvm::Error add(const clang::tooling::Replacement& replacement);
+
+  // |range| is token range like in |clang::Rewriter::ReplaceText|
+  llvm::Error add(
+    const clang::SourceRange& range
+    , llvm::StringRef replacementText);
+
+  // Applies collected replacements to |rewriter|
+  // and clears collected replacements.
+  // Returns |false| if some replacement can not be applied.
+  bool applyAll();
+
+  // Clears collected replacements, content hashes
+  // and number of conflicts without applying replacements
+  // (for example, after export, see |collectFileEdits|).
+  void clear();
+
+  // number of collected (not applied) replacements in all files
+  size_t size() const;
+
+  // number of replacements rejected by |add|
+  // since creation or |clear|
+  size_t numConflicts() const { return numConflicts_; }
+
+  // collected (not applied) replacements by file path
+  const std::map<std::string, clang::tooling::Replacements>&
+    fileReplacements() const
+  {
+    return fileReplacements_;
+  }
+
+  // SHA1 (see |computeContentHash|) of original contents
+  // of files edited by |add|, by path of edited file
+  /// \note file that is not loaded by |clang::SourceManager|
+  /// is hashed as read from disk
+  const std::map<std::string, std::string>& fileContentHashes() const
+  {
+    return fileContentHashes_;
+  }
+
+  clang::Rewriter* rewriter() const { return rewriter_; }
+
+  // Returns collector made current by |ScopedCurrent| on this thread
+  // or |nullptr|.
+  static ReplacementCollector* current();
+
+private:
+  // |fileID| may be invalid, then file is found by path of |replacement|
+  llvm::Error addToFile(
+    const clang::tooling::Replacement& replacement
+    , clang::FileID fileID);
+
+  // hashes file once, so exported edits can be checked
+  // against file they are applied to
+  void rememberContentHash(
+    const std::string& filePath
+    , clang::FileID fileID);
+
+  clang::Rewriter* rewriter_;
+
+  std::map<std::string, clang::tooling::Replacements> fileReplacements_;
+
+  std::map<std::string, std::string> fileContentHashes_;
+
+  size_t numConflicts_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(ReplacementCollector);
+};
+
+// Replaces token |range| with |replacementText| using
+// current |ReplacementCollector| for |rewriter| (if any)
+// or |clang::Rewriter::ReplaceText|.
+// Returns |false| if edit conflicts with collected edit
+// or can not be applied by |rewriter|.
+bool replaceText(
+  clang::Rewriter& rewriter
+  , const clang::SourceRange& range
+  , llvm::StringRef replacementText);
+
+} // namespace clang_utils
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <clang/Tooling/Core/Replacement.h>
+
+#include <base/files/file_path.h>
+#include <base/strings/string_piece.h>
+
+#include <string>
+#include <vector>
+
+namespace flexlib {
+class OutputSink;
+} // namespace flexlib
+
+namespace clang_utils {
+
+class ReplacementCollector;
+
+// Edits of one file, exported instead of whole rewritten file,
+// so small deltas can be cached and shipped between build shards
+// and applied later by |applyFileEdits|.
+struct FileEdits {
+  std::string path;
+
+  // SHA1 (see |computeContentHash|) of contents edits were made for,
+  // empty if unknown (edits are applied without check)
+  std::string contentHash;
+
+  clang::tooling::Replacements replacements;
+};
+
+using FileEditsList = std::vector<FileEdits>;
+
+// Returns edits collected (but not applied) by |collector|.
+FileEditsList collectFileEdits(const ReplacementCollector& collector);
+
+// Returns edits in format of clang-apply-replacements
+// (see |clang::tooling::TranslationUnitReplacements|).
+/// \note content hashes are not part of that format
+std::string serializeFileEditsYaml(
+  const std::string& mainSourceFile
+  , const FileEditsList& fileEdits);
+
+// Returns compact binary edit list (see |base::Pickle|)
+// with content hash of every edited file.
+std::string serializeFileEdits(const FileEditsList& fileEdits);
+
+// Returns |false| if |data| is not produced by |serializeFileEdits|
+// (or produced by other format version).
+bool deserializeFileEdits(
+  base::StringPiece data
+  , FileEditsList* result);
+
+// Applies |fileEdits| to files on disk and writes results
+// using |outputSink| (unchanged files are not written).
+// File with contents that do not match |FileEdits::contentHash|
+// is not edited.
+// Returns |false| if some file can not be edited.
+//
+// USAGE:
+// // build shard
+// std::string data = serializeFileEdits(collectFileEdits(collector));
+// // apply step
+// FileEditsList fileEdits;
+// if(deserializeFileEdits(data, &fileEdits)) {
+//   applyFileEdits(fileEdits, &outputSink);
+// }
+bool applyFileEdits(
+  const FileEditsList& fileEdits
+  , flexlib::OutputSink* outputSink);
+
+} // namespace clang_utils
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <clang/Tooling/ArgumentsAdjusters.h>
+
+#include <base/macros.h>
+#include <base/files/file_path.h>
+#include <base/sequence_checker.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace clang_utils {
+
+// Precompiled header for include prefix shared by all translation units
+// (like chromium base, entt, Corrade and boost headers).
+//
+// Built once by |prepare| and reused by every |AnnotationMatchAction|
+// of run (and by next runs) using `-include-pch`.
+// Stamp file stores modification time and size of every header
+// read while building precompiled header,
+// so it is rebuilt automatically when any of them changes.
+//
+// USAGE:
+// clang_utils::SharedPrecompiledHeader::Options pchOptions;
+// pchOptions.prefixHeader = base::FilePath("src/common_prefix.hpp");
+// pchOptions.outputDir = base::FilePath("build/pch");
+// pchOptions.compileArgs = {"-std=c++17", "-Iinclude"};
+// clang_utils::SharedPrecompiledHeader pch(std::move(pchOptions));
+// if(pch.prepare()) {
+//   driverOptions.precompiledHeader = &pch;
+// }
+//
+/// \note precompiled header is used only by translation units
+/// that start with all includes of |Options::prefixHeader|
+/// (in same order) and have same language, target, defines,
+/// include paths and language standard as |Options::compileArgs|.
+/// Other translation units are parsed without precompiled header.
+/// \note other flags (like warnings or optimization level) are ignored,
+/// clang reports error if they make precompiled header incompatible
+class SharedPrecompiledHeader {
+public:
+  struct Stats {
+    // translation units parsed with precompiled header
+    std::atomic<size_t> used{0};
+
+    // translation units parsed without precompiled header
+    std::atomic<size_t> skipped{0};
+  };
+
+  struct Options {
+    // header that includes common prefix, like
+    // #pragma once
+    // #include <base/logging.h>
+    // #include <entt/entt.hpp>
+    /// \note only includes at start of file are compared
+    /// with includes of translation units (see |prepare|)
+    base::FilePath prefixHeader;
+
+    // Precompiled header built by external tool.
+    // If not empty, then |prefixHeader| is used only to check
+    // includes of translation units (every translation unit
+    // with matching flags is checked if it is empty)
+    // and precompiled header is never rebuilt.
+    base::FilePath prebuiltPch;
+
+    // where to store precompiled header and its stamp
+    base::FilePath outputDir;
+
+    // working directory for |compileArgs|
+    base::FilePath workingDir;
+
+    // compiler flags without compiler path, input and output
+    // (for |prebuiltPch| flags used by external tool)
+    std::vector<std::string> compileArgs;
+  };
+
+  explicit SharedPrecompiledHeader(Options&& options);
+
+  ~SharedPrecompiledHeader();
+
+  // Builds precompiled header if it does not exist or outdated.
+  // Returns |false| if precompiled header can not be used
+  // (like when |Options::prefixHeader| does not start with includes).
+  bool prepare();
+
+  bool isReady() const;
+
+  const base::FilePath& pchPath() const;
+
+  // Changes when contents of any header in prefix changes,
+  // may be used as part of cache key.
+  const std::string& stamp() const;
+
+  // Adds `-include-pch` to compile command
+  // if flags of compile command match |Options::compileArgs|
+  // and file starts with includes of |Options::prefixHeader|.
+  /// \note precompiled header must outlive adjuster
+  clang::tooling::ArgumentsAdjuster getArgumentsAdjuster() const;
+
+  // counted by adjusters returned by |getArgumentsAdjuster|
+  const Stats& stats() const { return stats_; }
+
+private:
+  // Returns |true| if stamp file exists
+  // and none of headers from stamp file changed.
+  bool readValidStamp();
+
+  bool build();
+
+  // SHA1 of |Options::prefixHeader| and |Options::compileArgs|
+  std::string computeArgsHash() const;
+
+  base::FilePath stampPath() const;
+
+  const Options options_;
+
+  base::FilePath pchPath_;
+
+  std::string stamp_;
+
+  // includes at start of |Options::prefixHeader|
+  std::vector<std::string> prefixIncludes_;
+
+  bool isReady_ = false;
+
+  mutable Stats stats_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(SharedPrecompiledHeader);
+};
+
+} // namespace clang_utils
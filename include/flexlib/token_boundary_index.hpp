@@ -0,0 +1,138 @@
+#pragma once
+
+#include <clang/Basic/LangOptions.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Basic/TokenKinds.h>
+
+#include <llvm/ADT/StringRef.h>
+
+#include <base/macros.h>
+#include <base/sequence_checker.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace clang_utils {
+
+// Sorted offsets, lengths and kinds of raw tokens of one file,
+// so token boundaries are found by binary search
+// instead of re-lexing file for every replacement
+// (see |findSemiAfterLocation|).
+//
+// Use |TokenBoundaryIndexCache::getOrBuild|, index is built lazily
+// on first use for |clang::FileID|.
+//
+/// \note tokens are produced by raw lexer
+/// (like |clang::Lexer::LexFromRawLexer|), comments are skipped
+class TokenBoundaryIndex {
+public:
+  struct Token {
+    // offset of first character in file buffer
+    uint32_t offset;
+
+    uint32_t length;
+
+    clang::tok::TokenKind kind;
+  };
+
+  ~TokenBoundaryIndex();
+
+  // Returns token that starts exactly at |offset| or |nullptr|.
+  const Token* findTokenAt(unsigned offset) const;
+
+  // Returns first token that starts at or after |offset| or |nullptr|.
+  const Token* findFirstTokenFrom(unsigned offset) const;
+
+  // |true| if index was built for |buffer| (same data and size)
+  bool isBuiltFor(llvm::StringRef buffer) const;
+
+  size_t size() const { return tokens_.size(); }
+
+private:
+  friend class TokenBoundaryIndexCache;
+
+  TokenBoundaryIndex(
+    clang::SourceLocation fileStart
+    , llvm::StringRef buffer
+    , const clang::LangOptions& langOptions);
+
+  const char* bufferData_;
+
+  size_t bufferSize_;
+
+  // sorted by |Token::offset|
+  std::vector<Token> tokens_;
+
+  DISALLOW_COPY_AND_ASSIGN(TokenBoundaryIndex);
+};
+
+// Token indexes of files of one translation unit
+// (of one |clang::SourceManager|).
+//
+// |AnnotationMatchAction| owns cache of translation unit
+// and makes it current while callbacks run,
+// so |findSemiAfterLocation| called by callbacks uses it.
+// Indexes are freed together with cache
+// (before |clang::SourceManager| releases file buffers).
+//
+// USAGE:
+// clang_utils::TokenBoundaryIndexCache tokenIndexCache(
+//   sourceManager, langOptions);
+// endLoc = findSemiAfterLocation(endLoc, rewriter, &tokenIndexCache);
+//
+/// \note not thread-safe, use cache per translation unit
+class TokenBoundaryIndexCache {
+public:
+  // Makes |cache| current for this thread while in scope.
+  class ScopedCurrent {
+  public:
+    explicit ScopedCurrent(TokenBoundaryIndexCache* cache);
+
+    ~ScopedCurrent();
+
+  private:
+    TokenBoundaryIndexCache* previous_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedCurrent);
+  };
+
+  // |sourceManager| and |langOptions| must outlive cache
+  TokenBoundaryIndexCache(
+    const clang::SourceManager& sourceManager
+    , const clang::LangOptions& langOptions);
+
+  ~TokenBoundaryIndexCache();
+
+  // Returns cache made current by |ScopedCurrent| on this thread
+  // or |nullptr|.
+  static TokenBoundaryIndexCache* Current();
+
+  // Returns index for |fileID|, index is built on first call.
+  // Returns |nullptr| if file buffer is invalid.
+  const TokenBoundaryIndex* getOrBuild(clang::FileID fileID);
+
+  const clang::SourceManager& sourceManager() const
+  {
+    return sourceManager_;
+  }
+
+  // number of built indexes
+  size_t size() const { return indexes_.size(); }
+
+private:
+  const clang::SourceManager& sourceManager_;
+
+  const clang::LangOptions& langOptions_;
+
+  // by hash of |clang::FileID|
+  std::map<unsigned, std::unique_ptr<TokenBoundaryIndex>> indexes_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(TokenBoundaryIndexCache);
+};
+
+} // namespace clang_utils
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <base/macros.h>
+#include <base/files/file_path.h>
+#include <base/sequence_checker.h>
+#include <base/trace_event/common/trace_event_common.h>
+
+#include <string>
+
+namespace flexlib {
+
+// trace category used by annotation pipeline
+// (|AnnotationMatchAction|, |AnnotateConsumer|,
+// annotation methods and source transform rules)
+/// \note must be string literal, trace macros cache
+/// category state per call site by category pointer
+//
+// USAGE:
+// TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY, "AnnotationMethodCallback"
+//   , "method", methodName);
+#define FLEXLIB_TRACE_CATEGORY TRACE_DISABLED_BY_DEFAULT("flexlib")
+
+// Records trace events and writes them
+// in Chrome trace-event JSON format,
+// open result in chrome://tracing or https://ui.perfetto.dev
+// to get per-thread (per-worker) flame charts.
+// Spans are tagged with file and annotation method names.
+//
+// USAGE:
+// flexlib::TraceEventRecorder traceRecorder;
+// traceRecorder.start();
+// driver.run(sourcePaths);
+// traceRecorder.stopAndWrite(base::FilePath("trace.json"));
+class TraceEventRecorder {
+public:
+  TraceEventRecorder();
+
+  ~TraceEventRecorder();
+
+  // |categoryFilter| uses format of |base::trace_event::TraceConfig|
+  void start(
+    const std::string& categoryFilter = FLEXLIB_TRACE_CATEGORY);
+
+  // Returns |false| if |outputPath| can not be written.
+  bool stopAndWrite(const base::FilePath& outputPath);
+
+  bool isRecording() const;
+
+private:
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(TraceEventRecorder);
+};
+
+} // namespace flexlib
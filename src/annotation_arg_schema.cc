@@ -0,0 +1,354 @@
+#include "flexlib/annotation_arg_schema.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_piece.h>
+
+namespace flexlib {
+
+namespace {
+
+static const char kQuote = '"';
+
+static const char kEscape = '\\';
+
+static const char kRawStringPrefix = 'R';
+
+static const char kHexPrefix[] = "0x";
+
+// |value| is like "a \"b\"" including quotes
+bool decodeQuotedString(std::string_view value, std::string* result)
+{
+  DCHECK(result);
+
+  if(value.size() < 2
+     || value.front() != kQuote
+     || value.back() != kQuote)
+  {
+    return false;
+  }
+
+  result->clear();
+  result->reserve(value.size() - 2);
+  for(size_t i = 1; i < value.size() - 1; ++i) {
+    const char c = value[i];
+    if(c != kEscape) {
+      if(c == kQuote) {
+        // quote not escaped, like "a"b"
+        return false;
+      }
+      result->push_back(c);
+      continue;
+    }
+
+    ++i;
+    if(i == value.size() - 1) {
+      // escaped closing quote
+      return false;
+    }
+    switch(value[i]) {
+      case 'n': result->push_back('\n'); break;
+      case 't': result->push_back('\t'); break;
+      case 'r': result->push_back('\r'); break;
+      case '0': result->push_back('\0'); break;
+      case '\\':
+      case '\'':
+      case '"': result->push_back(value[i]); break;
+      default:
+        // unknown escape sequence is kept as is
+        result->push_back(kEscape);
+        result->push_back(value[i]);
+        break;
+    }
+  }
+  return true;
+}
+
+// |value| is like R"delim(a "b")delim"
+bool decodeRawString(std::string_view value, std::string* result)
+{
+  DCHECK(result);
+
+  if(value.size() < 5
+     || value[0] != kRawStringPrefix
+     || value[1] != kQuote
+     || value.back() != kQuote)
+  {
+    return false;
+  }
+
+  const size_t contentBegin = value.find('(', 2);
+  if(contentBegin == std::string_view::npos) {
+    return false;
+  }
+  const std::string_view delimiter
+    = value.substr(2, contentBegin - 2);
+
+  // |)delim"| at the end
+  if(value.size() < contentBegin + 1 + delimiter.size() + 2) {
+    return false;
+  }
+  const size_t contentEnd
+    = value.size() - 1 - delimiter.size() - 1;
+  if(value[contentEnd] != ')'
+     || value.substr(contentEnd + 1, delimiter.size()) != delimiter)
+  {
+    return false;
+  }
+
+  result->assign(value.data() + contentBegin + 1
+    , contentEnd - contentBegin - 1);
+  return true;
+}
+
+bool decodeInteger(std::string_view value, int64_t* result)
+{
+  DCHECK(result);
+
+  const base::StringPiece input(value.data(), value.size());
+  if(input.starts_with(kHexPrefix)) {
+    return base::HexStringToInt64(input, result);
+  }
+  return base::StringToInt64(input, result);
+}
+
+bool decodeBoolean(std::string_view value, bool* result)
+{
+  DCHECK(result);
+
+  if(value == "true" || value == "1") {
+    *result = true;
+    return true;
+  }
+  if(value == "false" || value == "0") {
+    *result = false;
+    return true;
+  }
+  return false;
+}
+
+const char* argTypeName(AnnotationArgType type)
+{
+  switch(type) {
+    case AnnotationArgType::kString: return "string";
+    case AnnotationArgType::kInteger: return "integer";
+    case AnnotationArgType::kBoolean: return "boolean";
+    case AnnotationArgType::kRaw: return "raw";
+  }
+  NOTREACHED();
+  return "";
+}
+
+} // namespace
+
+bool decodeAnnotationArgValue(
+  std::string_view value
+  , AnnotationArgType type
+  , AnnotationArgValue* result)
+{
+  DCHECK(result);
+
+  switch(type) {
+    case AnnotationArgType::kString: {
+      std::string decoded;
+      const bool isDecoded
+        = (!value.empty() && value.front() == kRawStringPrefix)
+          ? decodeRawString(value, &decoded)
+          : decodeQuotedString(value, &decoded);
+      if(!isDecoded) {
+        return false;
+      }
+      *result = std::move(decoded);
+      return true;
+    }
+    case AnnotationArgType::kInteger: {
+      int64_t decoded = 0;
+      if(!decodeInteger(value, &decoded)) {
+        return false;
+      }
+      *result = decoded;
+      return true;
+    }
+    case AnnotationArgType::kBoolean: {
+      bool decoded = false;
+      if(!decodeBoolean(value, &decoded)) {
+        return false;
+      }
+      *result = decoded;
+      return true;
+    }
+    case AnnotationArgType::kRaw: {
+      *result = std::string(value);
+      return true;
+    }
+  }
+  NOTREACHED();
+  return false;
+}
+
+DecodedAnnotationArgs::DecodedAnnotationArgs() = default;
+
+DecodedAnnotationArgs::~DecodedAnnotationArgs() = default;
+
+DecodedAnnotationArgs::DecodedAnnotationArgs(
+  DecodedAnnotationArgs&& other) = default;
+
+DecodedAnnotationArgs& DecodedAnnotationArgs::operator=(
+  DecodedAnnotationArgs&& other) = default;
+
+const AnnotationArgValue* DecodedAnnotationArgs::find(
+  std::string_view name) const
+{
+  DCHECK(schema_);
+  const int index = schema_->findField(name);
+  if(index < 0) {
+    return nullptr;
+  }
+  DCHECK_LT(static_cast<size_t>(index), values_.size());
+  return &values_[index];
+}
+
+bool DecodedAnnotationArgs::has(std::string_view name) const
+{
+  const AnnotationArgValue* value = find(name);
+  return value && !std::holds_alternative<std::monostate>(*value);
+}
+
+const std::string& DecodedAnnotationArgs::getString(
+  std::string_view name) const
+{
+  const AnnotationArgValue* value = find(name);
+  CHECK(value && std::holds_alternative<std::string>(*value))
+    << "no string argument: "
+    << name;
+  return std::get<std::string>(*value);
+}
+
+int64_t DecodedAnnotationArgs::getInteger(
+  std::string_view name) const
+{
+  const AnnotationArgValue* value = find(name);
+  CHECK(value && std::holds_alternative<int64_t>(*value))
+    << "no integer argument: "
+    << name;
+  return std::get<int64_t>(*value);
+}
+
+bool DecodedAnnotationArgs::getBoolean(
+  std::string_view name) const
+{
+  const AnnotationArgValue* value = find(name);
+  CHECK(value && std::holds_alternative<bool>(*value))
+    << "no boolean argument: "
+    << name;
+  return std::get<bool>(*value);
+}
+
+AnnotationArgSchema::AnnotationArgSchema() = default;
+
+AnnotationArgSchema::~AnnotationArgSchema() = default;
+
+AnnotationArgSchema::AnnotationArgSchema(
+  AnnotationArgSchema&& other) = default;
+
+AnnotationArgSchema& AnnotationArgSchema::operator=(
+  AnnotationArgSchema&& other) = default;
+
+AnnotationArgSchema& AnnotationArgSchema::addField(
+  std::string name
+  , AnnotationArgType type
+  , bool required
+  , AnnotationArgValue defaultValue)
+{
+  DCHECK(!name.empty());
+  DCHECK_LT(findField(name), 0)
+    << "argument registered twice: "
+    << name;
+  DCHECK(!required || std::holds_alternative<std::monostate>(defaultValue))
+    << "required argument can not have default value: "
+    << name;
+
+  fields_.push_back(AnnotationArgField{
+    std::move(name), type, required, std::move(defaultValue)});
+  return *this;
+}
+
+int AnnotationArgSchema::findField(std::string_view name) const
+{
+  /// \note number of fields is small, so linear search is fast
+  for(size_t i = 0; i < fields_.size(); ++i) {
+    if(fields_[i].name == name) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+bool AnnotationArgSchema::decode(
+  const parsed_func& func
+  , DecodedAnnotationArgs* result
+  , std::string* error) const
+{
+  DCHECK(result);
+  DCHECK(error);
+
+  const std::string& funcName = func.parsed_func_.func_name_;
+
+  result->schema_ = this;
+  result->values_.assign(fields_.size(), AnnotationArgValue());
+  std::vector<bool> isSet(fields_.size(), false);
+
+  size_t nextPositional = 0;
+  for(const functionArgument& arg: func.parsed_func_.args_.as_vec_) {
+    int index = -1;
+    std::string_view value = arg.value_;
+    if(arg.name_.empty()) {
+      if(value.empty()) {
+        // like `foo()`
+        continue;
+      }
+      if(nextPositional >= fields_.size()) {
+        *error = "too many arguments in " + funcName;
+        return false;
+      }
+      index = static_cast<int>(nextPositional++);
+    } else {
+      index = findField(arg.name_);
+      if(index < 0) {
+        *error = "unknown argument " + arg.name_ + " in " + funcName;
+        return false;
+      }
+    }
+
+    const AnnotationArgField& field = fields_[index];
+    if(isSet[index]) {
+      *error = "argument " + field.name + " passed twice in " + funcName;
+      return false;
+    }
+    if(!decodeAnnotationArgValue(value, field.type, &result->values_[index]))
+    {
+      *error = "argument " + field.name + " in " + funcName
+        + " must be " + argTypeName(field.type)
+        + ", got: " + arg.value_;
+      return false;
+    }
+    isSet[index] = true;
+  }
+
+  for(size_t i = 0; i < fields_.size(); ++i) {
+    if(isSet[i]) {
+      continue;
+    }
+    if(fields_[i].required) {
+      *error = "missing required argument " + fields_[i].name
+        + " in " + funcName;
+      return false;
+    }
+    result->values_[i] = fields_[i].defaultValue;
+  }
+
+  return true;
+}
+
+} // namespace flexlib
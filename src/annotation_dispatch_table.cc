@@ -0,0 +1,135 @@
+#include "flexlib/annotation_dispatch_table.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+
+#include <algorithm>
+#include <map>
+
+namespace flexlib {
+
+AnnotationDispatchTable::AnnotationDispatchTable(
+  const AnnotationMethods* annotationMethods)
+  : annotationMethods_(annotationMethods)
+{
+  DCHECK(annotationMethods_);
+
+  build();
+}
+
+AnnotationDispatchTable::~AnnotationDispatchTable()
+{}
+
+void AnnotationDispatchTable::build()
+{
+  // Trie with |std::map| children is simple to fill,
+  // then it is flattened into |nodes_| and |edges_|
+  // (contiguous memory for lookup).
+  struct BuildNode {
+    std::map<unsigned char, uint32_t> children;
+
+    int32_t methodIndex = kNoMethod;
+  };
+
+  std::vector<BuildNode> buildNodes(1);
+
+  numMethods_ = annotationMethods_->size();
+
+  int32_t methodIndex = 0;
+  for(auto it = annotationMethods_->begin()
+      ; it != annotationMethods_->end()
+      ; ++it, ++methodIndex)
+  {
+    uint32_t node = 0;
+    for(const char c: it->first) {
+      const unsigned char label = static_cast<unsigned char>(c);
+      auto childIt = buildNodes[node].children.find(label);
+      if(childIt != buildNodes[node].children.end()) {
+        node = childIt->second;
+        continue;
+      }
+      const uint32_t child = static_cast<uint32_t>(buildNodes.size());
+      buildNodes[node].children.emplace(label, child);
+      buildNodes.emplace_back();
+      node = child;
+    }
+    // keys of |base::flat_map| are unique
+    DCHECK_EQ(buildNodes[node].methodIndex, kNoMethod);
+    buildNodes[node].methodIndex = methodIndex;
+  }
+
+  nodes_.clear();
+  edges_.clear();
+  nodes_.resize(buildNodes.size());
+  edges_.reserve(buildNodes.size() - 1);
+  for(size_t i = 0; i < buildNodes.size(); ++i) {
+    Node& node = nodes_[i];
+    node.methodIndex = buildNodes[i].methodIndex;
+    node.firstEdge = static_cast<uint32_t>(edges_.size());
+    node.numEdges
+      = static_cast<uint32_t>(buildNodes[i].children.size());
+    // |std::map| is sorted by label
+    for(const auto& child: buildNodes[i].children) {
+      edges_.push_back(Edge{child.first, child.second});
+    }
+  }
+
+  DVLOG(9)
+    << "built annotation dispatch table for "
+    << numMethods_
+    << " methods using "
+    << nodes_.size()
+    << " nodes";
+}
+
+AnnotationMethods::const_iterator
+  AnnotationDispatchTable::findLongestPrefix(
+    std::string_view annotation
+    , size_t* methodLength) const
+{
+  DCHECK(methodLength);
+  DCHECK(isBuiltFor(annotationMethods_));
+
+  int32_t foundMethod = nodes_[0].methodIndex;
+  size_t foundLength = 0;
+
+  uint32_t node = 0;
+  for(size_t i = 0; i < annotation.size(); ++i) {
+    const unsigned char label
+      = static_cast<unsigned char>(annotation[i]);
+
+    const Edge* edgesBegin = edges_.data() + nodes_[node].firstEdge;
+    const Edge* edgesEnd = edgesBegin + nodes_[node].numEdges;
+    const Edge* edge
+      = std::lower_bound(edgesBegin, edgesEnd, label
+          , [](const Edge& edge, unsigned char label) {
+              return edge.label < label;
+            });
+    if(edge == edgesEnd || edge->label != label) {
+      break;
+    }
+
+    node = edge->target;
+    if(nodes_[node].methodIndex != kNoMethod) {
+      // longer match found
+      foundMethod = nodes_[node].methodIndex;
+      foundLength = i + 1;
+    }
+  }
+
+  if(foundMethod == kNoMethod) {
+    return annotationMethods_->end();
+  }
+
+  *methodLength = foundLength;
+  return annotationMethods_->begin() + foundMethod;
+}
+
+bool AnnotationDispatchTable::isBuiltFor(
+  const AnnotationMethods* annotationMethods) const
+{
+  return annotationMethods == annotationMethods_
+    && annotationMethods->size() == numMethods_;
+}
+
+} // namespace flexlib
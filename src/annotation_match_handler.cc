@@ -1,6 +1,10 @@
 ﻿#include "flexlib/annotation_match_handler.hpp" // IWYU pragma: associated
 
+#include "flexlib/trace_event_recorder.hpp"
+#include "flexlib/annotation_parse_cache.hpp"
+
 #include <base/check.h>
+#include <base/trace_event/trace_event.h>
 
 namespace flexlib {
 
@@ -33,11 +37,30 @@ void AnnotationMatchHandler::matchHandler(
     << "found annotation method: "
     << annotateAttr->getAnnotation().str();
 
-  std::string resultWithoutMethod;
+  const llvm::StringRef annotation
+    = annotateAttr->getAnnotation();
+
+  // view into |clang::AnnotateAttr| storage
+  std::string_view resultWithoutMethod;
+  // passed to callback without copy if parse cache is used
+  scoped_refptr<const ParsedAnnotation> parsedAnnotation;
+  AnnotationMethods::const_iterator callback_iter;
   DCHECK(annotationParser_);
-  AnnotationMethods::const_iterator callback_iter
-    = annotationParser_->parseToMethods(
-        annotateAttr->getAnnotation().str(), resultWithoutMethod);
+  if(annotationParser_->parseCache()) {
+    parsedAnnotation
+      = annotationParser_->parseToMethodsCached(
+          std::string_view(annotation.data(), annotation.size()));
+    DCHECK(parsedAnnotation);
+    callback_iter
+      = parsedAnnotation->hasMethod()
+        ? annotationMethods_->find(parsedAnnotation->methodName())
+        : annotationMethods_->end();
+  } else {
+    callback_iter
+      = annotationParser_->parseToMethods(
+          std::string_view(annotation.data(), annotation.size())
+          , resultWithoutMethod);
+  }
 
   if(callback_iter == annotationMethods_->end()) {
     LOG(WARNING)
@@ -46,7 +69,26 @@ void AnnotationMatchHandler::matchHandler(
     return;
   }
 
-  callback_iter->second.Run(resultWithoutMethod
+  // tagged with method name to find slow generators
+  TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY
+    , "AnnotationMethodCallback"
+    , "method", callback_iter->first);
+
+  if(parsedAnnotation) {
+    // callback may use parsed arguments,
+    // see |ParsedAnnotation::current|
+    ParsedAnnotation::ScopedCurrent scopedParsedAnnotation(
+      parsedAnnotation.get());
+    callback_iter->second.Run(parsedAnnotation->annotationWithoutMethod()
+                              , annotateAttr
+                              , matchResult
+                              , rewriter
+                              , nodeDecl);
+    return;
+  }
+
+  // callback takes ownership of copy
+  callback_iter->second.Run(std::string(resultWithoutMethod)
                             , annotateAttr
                             , matchResult
                             , rewriter
@@ -60,6 +102,9 @@ void AnnotationMatchHandler::endSourceFileHandler(
 {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
+  TRACE_EVENT0(FLEXLIB_TRACE_CATEGORY
+    , "AnnotationMatchHandler::endSourceFileHandler");
+
   CHECK(saveFileHandler_);
   saveFileHandler_.Run(fileID
                   , fileEntry
@@ -0,0 +1,187 @@
+#include "flexlib/annotation_parse_cache.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/lazy_instance.h>
+#include <base/threading/thread_local.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace flexlib {
+
+namespace {
+
+base::LazyInstance<base::ThreadLocalPointer<const ParsedAnnotation>>::Leaky
+  g_currentParsedAnnotation = LAZY_INSTANCE_INITIALIZER;
+
+} // namespace
+
+ParsedAnnotation::ScopedCurrent::ScopedCurrent(
+  const ParsedAnnotation* parsedAnnotation)
+  : previous_(g_currentParsedAnnotation.Get().Get())
+{
+  DCHECK(parsedAnnotation);
+  g_currentParsedAnnotation.Get().Set(parsedAnnotation);
+}
+
+ParsedAnnotation::ScopedCurrent::~ScopedCurrent()
+{
+  g_currentParsedAnnotation.Get().Set(previous_);
+}
+
+ParsedAnnotation::ParsedAnnotation(
+  std::string annotation
+  , std::string methodName
+  , size_t withoutMethodOffset
+  , size_t methodsKey)
+  : annotation_(std::move(annotation))
+  , methodName_(std::move(methodName))
+  , annotationWithoutMethod_(
+      annotation_.substr(
+        std::min(withoutMethodOffset, annotation_.size())))
+  , methodsKey_(methodsKey)
+  // arguments of unregistered method are never used
+  , funcs_(
+      methodName_.empty()
+        ? flat_parsed_funcs()
+        : split_to_flat_funcs(annotationWithoutMethod_))
+{
+  DCHECK_LE(withoutMethodOffset, annotation_.size());
+
+  estimatedSize_
+    = sizeof(ParsedAnnotation)
+      + annotation_.capacity()
+      + methodName_.capacity()
+      + annotationWithoutMethod_.capacity()
+      + funcs_.buffer_size();
+  for(const flat_parsed_func& func: funcs_) {
+    estimatedSize_
+      += func.args_.capacity() * sizeof(flat_function_argument)
+         + func.sorted_name_index_.capacity() * sizeof(uint32_t);
+  }
+}
+
+ParsedAnnotation::~ParsedAnnotation()
+{}
+
+// static
+const ParsedAnnotation* ParsedAnnotation::current()
+{
+  return g_currentParsedAnnotation.Get().Get();
+}
+
+AnnotationParseCache::AnnotationParseCache(Options&& options)
+  : options_(std::move(options))
+  // evicted by |evictIfNeeded| based on size of entries
+  , entries_(EntryMap::NO_AUTO_EVICT)
+{}
+
+AnnotationParseCache::~AnnotationParseCache()
+{
+  DVLOG(9)
+    << "annotation parse cache: hits "
+    << stats_.hits
+    << ", misses "
+    << stats_.misses
+    << ", evictions "
+    << stats_.evictions;
+}
+
+size_t AnnotationParseCache::hashAnnotation(
+  std::string_view annotation
+  , size_t methodsKey) const
+{
+  const size_t hash
+    = options_.hashFunction
+      ? options_.hashFunction(annotation)
+      : std::hash<std::string_view>{}(annotation);
+  // same as |boost::hash_combine|
+  return hash ^ (methodsKey + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+scoped_refptr<const ParsedAnnotation> AnnotationParseCache::lookup(
+  std::string_view annotation
+  , size_t methodsKey)
+{
+  const size_t hash = hashAnnotation(annotation, methodsKey);
+
+  base::AutoLock lock(lock_);
+
+  auto it = entries_.Get(hash);
+  /// \note on hash collision entry is treated as missing
+  if(it == entries_.end()
+     || it->second->methodsKey() != methodsKey
+     || it->second->annotation() != annotation)
+  {
+    stats_.misses++;
+    return nullptr;
+  }
+
+  stats_.hits++;
+  return it->second;
+}
+
+scoped_refptr<const ParsedAnnotation> AnnotationParseCache::store(
+  scoped_refptr<const ParsedAnnotation> parsedAnnotation)
+{
+  DCHECK(parsedAnnotation);
+
+  const size_t hash
+    = hashAnnotation(
+        parsedAnnotation->annotation(), parsedAnnotation->methodsKey());
+
+  base::AutoLock lock(lock_);
+
+  auto it = entries_.Peek(hash);
+  if(it != entries_.end()) {
+    if(it->second->methodsKey() == parsedAnnotation->methodsKey()
+       && it->second->annotation() == parsedAnnotation->annotation())
+    {
+      // other thread parsed same annotation first
+      return it->second;
+    }
+    // replace entry with same hash
+    DCHECK_GE(totalBytes_, it->second->estimatedSize());
+    totalBytes_ -= it->second->estimatedSize();
+    entries_.Erase(it);
+  }
+
+  totalBytes_ += parsedAnnotation->estimatedSize();
+  entries_.Put(hash, parsedAnnotation);
+
+  evictIfNeeded();
+
+  return parsedAnnotation;
+}
+
+size_t AnnotationParseCache::totalBytes() const
+{
+  base::AutoLock lock(lock_);
+
+  return totalBytes_;
+}
+
+size_t AnnotationParseCache::size() const
+{
+  base::AutoLock lock(lock_);
+
+  return entries_.size();
+}
+
+void AnnotationParseCache::evictIfNeeded()
+{
+  lock_.AssertAcquired();
+
+  /// \note most recently used entry is kept even if it exceeds limit,
+  /// it is still referenced by caller
+  while(totalBytes_ > options_.maxBytes && entries_.size() > 1) {
+    auto oldest = entries_.rbegin();
+    DCHECK_GE(totalBytes_, oldest->second->estimatedSize());
+    totalBytes_ -= oldest->second->estimatedSize();
+    entries_.Erase(oldest);
+    stats_.evictions++;
+  }
+}
+
+} // namespace flexlib
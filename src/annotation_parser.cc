@@ -1,9 +1,13 @@
 ﻿#include "flexlib/annotation_parser.hpp" // IWYU pragma: associated
 
 #include "flexlib/parser_constants.hpp"
+#include "flexlib/annotation_dispatch_table.hpp"
+#include "flexlib/annotation_parse_cache.hpp"
 
 #include <base/check.h>
 
+#include <functional>
+
 namespace flexlib {
 
 AnnotationParser::AnnotationParser(
@@ -15,30 +19,68 @@ AnnotationParser::AnnotationParser(
   DCHECK(annotationMethods);
 }
 
+AnnotationParser::~AnnotationParser()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+void AnnotationParser::buildDispatchTable()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  DCHECK(annotationMethods);
+  dispatchTable_
+    = std::make_unique<AnnotationDispatchTable>(annotationMethods);
+  // dispatch table finds other method than linear scan
+  methodsKeySize_ = kNoMethodsKey;
+}
+
+size_t AnnotationParser::methodsKey()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  DCHECK(annotationMethods);
+  /// \note like |AnnotationDispatchTable::isBuiltFor|,
+  /// methods are assumed to be changed only by adding or removing
+  if(methodsKeySize_ == annotationMethods->size()) {
+    return methodsKey_;
+  }
+
+  std::string names(dispatchTable_ ? "longest;" : "first;");
+  for(const auto& method: *annotationMethods) {
+    names += method.first;
+    // method names may contain any character except |'\0'|
+    names += '\0';
+  }
+  methodsKey_ = std::hash<std::string>{}(names);
+  methodsKeySize_ = annotationMethods->size();
+  return methodsKey_;
+}
+
 bool AnnotationParser::tryRemovePrefix(
-    const std::string& unprocessed
-    , std::string& resultWithoutPrefix
-    , const std::string& prefix)
+    std::string_view unprocessed
+    , std::string_view& resultWithoutPrefix
+    , std::string_view prefix)
 {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
   const bool startsWithPrefix
-    = unprocessed.rfind(prefix, 0) == 0;
+    = unprocessed.size() >= prefix.size()
+      && unprocessed.compare(0, prefix.size(), prefix) == 0;
   if(!startsWithPrefix) {
     return false;
   }
-  resultWithoutPrefix = unprocessed;
-  resultWithoutPrefix.erase(0, prefix.size());
+  resultWithoutPrefix = unprocessed.substr(prefix.size());
   return true;
 }
 
 AnnotationMethods::const_iterator AnnotationParser::parseToMethods(
-  const std::string& unprocessedAnnotation
-  , std::string& resultWithoutMethod)
+  std::string_view unprocessedAnnotation
+  , std::string_view& resultWithoutMethod)
 {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
-  std::string resultWithoutPrefix;
+  std::string_view resultWithoutPrefix;
   const bool startsWithGen
     = tryRemovePrefix(unprocessedAnnotation
                       , resultWithoutPrefix
@@ -48,6 +90,19 @@ AnnotationMethods::const_iterator AnnotationParser::parseToMethods(
   }
 
   DCHECK(annotationMethods);
+  if(dispatchTable_) {
+    DCHECK(dispatchTable_->isBuiltFor(annotationMethods))
+      << "call buildDispatchTable after changing annotation methods";
+    size_t methodLength = 0;
+    AnnotationMethods::const_iterator callback_iter
+      = dispatchTable_->findLongestPrefix(
+          resultWithoutPrefix, &methodLength);
+    if(callback_iter != annotationMethods->end()) {
+      resultWithoutMethod = resultWithoutPrefix.substr(methodLength);
+    }
+    return callback_iter;
+  }
+
   for(auto callback_iter = annotationMethods->begin();
       callback_iter != annotationMethods->end();
       ++callback_iter)
@@ -65,4 +120,89 @@ AnnotationMethods::const_iterator AnnotationParser::parseToMethods(
   return annotationMethods->end();
 }
 
+scoped_refptr<const ParsedAnnotation>
+  AnnotationParser::parseToMethodsCached(
+    std::string_view unprocessedAnnotation)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  const size_t parsedMethodsKey = methodsKey();
+
+  if(parseCache_) {
+    scoped_refptr<const ParsedAnnotation> cached
+      = parseCache_->lookup(unprocessedAnnotation, parsedMethodsKey);
+    if(cached) {
+      return cached;
+    }
+  }
+
+  std::string_view resultWithoutMethod;
+  AnnotationMethods::const_iterator callback_iter
+    = parseToMethods(unprocessedAnnotation, resultWithoutMethod);
+
+  std::string methodName;
+  size_t withoutMethodOffset = unprocessedAnnotation.size();
+  if(callback_iter != annotationMethods->end()) {
+    methodName = callback_iter->first;
+    // |resultWithoutMethod| is view into |unprocessedAnnotation|
+    withoutMethodOffset
+      = resultWithoutMethod.data() - unprocessedAnnotation.data();
+  }
+
+  scoped_refptr<const ParsedAnnotation> parsed
+    = base::MakeRefCounted<ParsedAnnotation>(
+        std::string(unprocessedAnnotation)
+        , std::move(methodName)
+        , withoutMethodOffset
+        , parsedMethodsKey);
+
+  if(parseCache_) {
+    return parseCache_->store(std::move(parsed));
+  }
+  return parsed;
+}
+
+void AnnotationParser::setParseCache(
+  AnnotationParseCache* parseCache)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  parseCache_ = parseCache;
+}
+
+bool AnnotationParser::tryRemovePrefix(
+    const std::string& unprocessed
+    , std::string& resultWithoutPrefix
+    , const std::string& prefix)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  std::string_view resultView;
+  if(!tryRemovePrefix(std::string_view(unprocessed)
+                      , resultView
+                      , std::string_view(prefix)))
+  {
+    return false;
+  }
+  /// \note |resultView| may point into |resultWithoutPrefix|
+  /// (if same string passed as |unprocessed|), |assign| handles it
+  resultWithoutPrefix.assign(resultView.data(), resultView.size());
+  return true;
+}
+
+AnnotationMethods::const_iterator AnnotationParser::parseToMethods(
+  const std::string& unprocessedAnnotation
+  , std::string& resultWithoutMethod)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  std::string_view resultView;
+  AnnotationMethods::const_iterator callback_iter
+    = parseToMethods(std::string_view(unprocessedAnnotation), resultView);
+  if(callback_iter != annotationMethods->end()) {
+    resultWithoutMethod.assign(resultView.data(), resultView.size());
+  }
+  return callback_iter;
+}
+
 } // namespace flexlib
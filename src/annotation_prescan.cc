@@ -0,0 +1,334 @@
+#include "flexlib/annotation_prescan.hpp" // IWYU pragma: associated
+
+#include "flexlib/parser_constants.hpp"
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/files/file.h>
+#include <base/files/file_util.h>
+#include <base/files/memory_mapped_file.h>
+#include <base/strings/string_piece.h>
+
+#include <cstring>
+#include <deque>
+#include <set>
+
+namespace flexlib {
+
+namespace {
+
+// Returns |true| if |needle| found in |data|.
+/// \note |memchr| is vectorized by libc, so we use it to find
+/// candidates for first char of |needle| and |memcmp| to check them.
+bool containsSubstring(
+  const char* data
+  , size_t size
+  , base::StringPiece needle)
+{
+  if(needle.empty()) {
+    return true;
+  }
+
+  if(size < needle.size()) {
+    return false;
+  }
+
+  const char* pos = data;
+  // last position where |needle| may start
+  const char* const lastPos = data + (size - needle.size());
+  while(pos <= lastPos) {
+    const void* found
+      = std::memchr(pos, needle[0], static_cast<size_t>(lastPos - pos) + 1);
+    if(!found) {
+      return false;
+    }
+    pos = static_cast<const char*>(found);
+    if(std::memcmp(pos + 1, needle.data() + 1, needle.size() - 1) == 0) {
+      return true;
+    }
+    ++pos;
+  }
+
+  return false;
+}
+
+bool isHorizontalSpace(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+// Finds paths from `#include "path"` and `#include <path>`.
+/// \note does not handle comments and conditional compilation,
+/// so may return more includes than preprocessor will see
+/// (that is fine for pre-scan).
+void collectIncludes(
+  const char* data
+  , size_t size
+  , std::vector<std::string>* quotedIncludes
+  , std::vector<std::string>* angledIncludes)
+{
+  DCHECK(quotedIncludes);
+  DCHECK(angledIncludes);
+
+  static constexpr base::StringPiece kIncludeDirective = "include";
+
+  const char* pos = data;
+  const char* const end = data + size;
+  while(pos < end) {
+    const void* found
+      = std::memchr(pos, '#', static_cast<size_t>(end - pos));
+    if(!found) {
+      return;
+    }
+    pos = static_cast<const char*>(found) + 1;
+
+    while(pos < end && isHorizontalSpace(*pos)) {
+      ++pos;
+    }
+
+    if(static_cast<size_t>(end - pos) < kIncludeDirective.size()
+       || std::memcmp(pos, kIncludeDirective.data()
+                      , kIncludeDirective.size()) != 0)
+    {
+      continue;
+    }
+    pos += kIncludeDirective.size();
+
+    while(pos < end && isHorizontalSpace(*pos)) {
+      ++pos;
+    }
+
+    if(pos == end || (*pos != '"' && *pos != '<')) {
+      continue;
+    }
+    const bool isQuoted = *pos == '"';
+    const char closingChar = isQuoted ? '"' : '>';
+    ++pos;
+
+    const char* pathStart = pos;
+    while(pos < end && *pos != closingChar && *pos != '\n') {
+      ++pos;
+    }
+    if(pos == end || *pos != closingChar || pos == pathStart) {
+      continue;
+    }
+
+    (isQuoted ? quotedIncludes : angledIncludes)->emplace_back(
+      pathStart, static_cast<size_t>(pos - pathStart));
+  }
+}
+
+} // namespace
+
+AnnotationPrescanner::AnnotationPrescanner(Options&& options)
+  : options_(std::move(options))
+{}
+
+AnnotationPrescanner::~AnnotationPrescanner()
+{}
+
+bool AnnotationPrescanner::mayContainAnnotations(
+  const base::FilePath& mainFile)
+{
+  /// \note may be called on any thread
+  if(!options_.enabled) {
+    return true;
+  }
+
+  std::set<base::FilePath> visited{mainFile};
+  std::deque<base::FilePath> pending{mainFile};
+  while(!pending.empty()) {
+    const base::FilePath filePath = std::move(pending.front());
+    pending.pop_front();
+
+    FileScanResult scanResult;
+    if(!getFileScanResult(filePath, &scanResult)) {
+      if(filePath == mainFile) {
+        // let clang report error
+        return true;
+      }
+      DVLOG(9)
+        << "unable to pre-scan included file: "
+        << filePath;
+      continue;
+    }
+
+    // any of strings is enough, because other part of annotation
+    // may come from header that is not scanned,
+    // like macro with annotate attribute defined in system header
+    // and used with |kRequiredAnnotationPrefix| in main file
+    if(scanResult.hasExtraMarker
+       || scanResult.hasRequiredPrefix
+       || scanResult.hasAnnotateAttr)
+    {
+      return true;
+    }
+
+    for(base::FilePath& include: scanResult.localIncludes) {
+      if(visited.insert(include).second) {
+        pending.push_back(std::move(include));
+      }
+    }
+  }
+
+  stats_.skippedTranslationUnits++;
+
+  DVLOG(9)
+    << "pre-scan found no annotations in translation unit: "
+    << mainFile;
+
+  return false;
+}
+
+std::vector<std::string> AnnotationPrescanner::filterTranslationUnits(
+  const std::vector<std::string>& sourcePaths)
+{
+  std::vector<std::string> result;
+  result.reserve(sourcePaths.size());
+  for(const std::string& sourcePath: sourcePaths) {
+    if(mayContainAnnotations(base::FilePath::FromUTF8Unsafe(sourcePath))) {
+      result.push_back(sourcePath);
+    }
+  }
+  return result;
+}
+
+bool AnnotationPrescanner::getFileScanResult(
+  const base::FilePath& filePath
+  , FileScanResult* result)
+{
+  DCHECK(result);
+
+  base::File::Info fileInfo;
+  if(!base::GetFileInfo(filePath, &fileInfo)
+     || fileInfo.is_directory)
+  {
+    return false;
+  }
+
+  {
+    base::AutoLock lock(cacheLock_);
+    auto it = cache_.find(filePath);
+    if(it != cache_.end()
+       && it->second.lastModified == fileInfo.last_modified
+       && it->second.size == fileInfo.size)
+    {
+      stats_.cachedFiles++;
+      *result = it->second;
+      return true;
+    }
+  }
+
+  // scan without lock, so workers can scan different files in parallel
+  result->lastModified = fileInfo.last_modified;
+  result->size = fileInfo.size;
+  if(!scanFile(filePath, result)) {
+    return false;
+  }
+
+  stats_.scannedFiles++;
+
+  {
+    base::AutoLock lock(cacheLock_);
+    cache_[filePath] = *result;
+  }
+
+  return true;
+}
+
+bool AnnotationPrescanner::scanFile(
+  const base::FilePath& filePath
+  , FileScanResult* result) const
+{
+  DCHECK(result);
+
+  result->hasRequiredPrefix = false;
+  result->hasAnnotateAttr = false;
+  result->hasExtraMarker = false;
+  result->localIncludes.clear();
+
+  if(result->size == 0) {
+    // nothing to map
+    return true;
+  }
+
+  base::MemoryMappedFile mappedFile;
+  if(!mappedFile.Initialize(filePath)) {
+    LOG(WARNING)
+      << "unable to map file for pre-scan: "
+      << filePath;
+    return false;
+  }
+
+  const char* data = reinterpret_cast<const char*>(mappedFile.data());
+  const size_t size = mappedFile.length();
+
+  result->hasRequiredPrefix
+    = containsSubstring(data, size, kRequiredAnnotationPrefix);
+  result->hasAnnotateAttr
+    = containsSubstring(data, size, kAnnotateAttrSpelling);
+  for(const std::string& extraMarker: options_.extraMarkers) {
+    if(containsSubstring(data, size, extraMarker)) {
+      result->hasExtraMarker = true;
+      break;
+    }
+  }
+
+  std::vector<std::string> quotedIncludes;
+  std::vector<std::string> angledIncludes;
+  collectIncludes(data, size, &quotedIncludes, &angledIncludes);
+
+  for(const std::string& include: quotedIncludes) {
+    base::FilePath includePath
+      = resolveInclude(filePath.DirName(), include);
+    if(includePath.empty()) {
+      includePath = resolveInclude(base::FilePath{}, include);
+    }
+    if(!includePath.empty()) {
+      result->localIncludes.push_back(std::move(includePath));
+    }
+  }
+
+  for(const std::string& include: angledIncludes) {
+    base::FilePath includePath
+      = resolveInclude(base::FilePath{}, include);
+    if(!includePath.empty()) {
+      result->localIncludes.push_back(std::move(includePath));
+    }
+  }
+
+  return true;
+}
+
+base::FilePath AnnotationPrescanner::resolveInclude(
+  const base::FilePath& includingDir
+  , const std::string& includePath) const
+{
+  const base::FilePath relativePath
+    = base::FilePath::FromUTF8Unsafe(includePath);
+  if(relativePath.IsAbsolute()) {
+    // project-local headers are included using relative paths
+    return base::FilePath{};
+  }
+
+  // normalizes paths like "dir/../dir/file.hpp",
+  // so same header is not scanned twice
+  /// \note On POSIX, |MakeAbsoluteFilePath| fails
+  /// if the path does not exist
+  if(!includingDir.empty()) {
+    return base::MakeAbsoluteFilePath(includingDir.Append(relativePath));
+  }
+
+  for(const base::FilePath& includeDir: options_.localIncludeDirs) {
+    base::FilePath absolutePath
+      = base::MakeAbsoluteFilePath(includeDir.Append(relativePath));
+    if(!absolutePath.empty()) {
+      return absolutePath;
+    }
+  }
+
+  // system or third-party header
+  return base::FilePath{};
+}
+
+} // namespace flexlib
@@ -0,0 +1,342 @@
+#include "flexlib/annotation_result_cache.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/pickle.h>
+#include <base/files/file.h>
+#include <base/files/file_util.h>
+#include <base/files/important_file_writer.h>
+#include <base/hash/sha1.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_piece.h>
+
+#include <algorithm>
+
+namespace clang_utils {
+
+namespace {
+
+// change it if format of key or entry changes
+const int kCacheFormatVersion = 2;
+
+std::string hexSHA1(const std::string& data)
+{
+  const std::string hash = base::SHA1HashString(data);
+  return base::HexEncode(hash.data(), hash.size());
+}
+
+void appendKeyPart(
+  std::string* keyData
+  , base::StringPiece part)
+{
+  DCHECK(keyData);
+  keyData->append(part.data(), part.size());
+  // separator, so {"ab", "c"} and {"a", "bc"} give different keys
+  keyData->push_back('\0');
+}
+
+} // namespace
+
+std::string computeContentHash(base::StringPiece contents)
+{
+  return hexSHA1(contents.as_string());
+}
+
+AnnotationResultCache::AnnotationResultCache(Options&& options)
+  : options_(std::move(options))
+{
+  DCHECK(!options_.cacheDir.empty());
+}
+
+AnnotationResultCache::~AnnotationResultCache()
+{}
+
+std::string AnnotationResultCache::computeKey(
+  const clang::tooling::CompilationDatabase& compilations
+  , const std::string& sourcePath
+  , const std::vector<std::string>& extraKeyParts) const
+{
+  /// \note may be called on any thread
+  const std::vector<clang::tooling::CompileCommand> compileCommands
+    = compilations.getCompileCommands(sourcePath);
+  if(compileCommands.empty()) {
+    return std::string();
+  }
+
+  std::string keyData;
+  appendKeyPart(&keyData, base::NumberToString(kCacheFormatVersion));
+  appendKeyPart(&keyData, sourcePath);
+
+  for(const clang::tooling::CompileCommand& command: compileCommands) {
+    appendKeyPart(&keyData, command.Directory);
+    appendKeyPart(&keyData, command.Filename);
+    for(const std::string& arg: command.CommandLine) {
+      appendKeyPart(&keyData, arg);
+    }
+  }
+
+  // key must not depend on order of plugin loading
+  std::vector<std::string> annotationMethodNames
+    = options_.annotationMethodNames;
+  std::sort(annotationMethodNames.begin(), annotationMethodNames.end());
+  for(const std::string& name: annotationMethodNames) {
+    appendKeyPart(&keyData, name);
+  }
+
+  std::vector<std::string> toolVersions = options_.toolVersions;
+  std::sort(toolVersions.begin(), toolVersions.end());
+  for(const std::string& version: toolVersions) {
+    appendKeyPart(&keyData, version);
+  }
+
+  for(const std::string& part: extraKeyParts) {
+    appendKeyPart(&keyData, part);
+  }
+
+  return hexSHA1(keyData);
+}
+
+bool AnnotationResultCache::lookup(
+  const std::string& key
+  , AnnotationFileResult* result)
+{
+  /// \note may be called on any thread
+  DCHECK(result);
+
+  std::string entryData;
+  if(key.empty()
+     || !base::ReadFileToString(getEntryPath(key), &entryData))
+  {
+    stats_.misses++;
+    return false;
+  }
+
+  base::Pickle pickle(entryData.data(), entryData.size());
+  base::PickleIterator iter(pickle);
+
+  int formatVersion = 0;
+  std::string entryKey;
+  int numDependencies = 0;
+  if(!iter.ReadInt(&formatVersion)
+     || formatVersion != kCacheFormatVersion
+     || !iter.ReadString(&entryKey)
+     || entryKey != key
+     || !iter.ReadInt(&numDependencies)
+     || numDependencies < 0)
+  {
+    LOG(WARNING)
+      << "ignored invalid cache entry: "
+      << getEntryPath(key);
+    stats_.misses++;
+    return false;
+  }
+
+  for(int i = 0; i < numDependencies; ++i) {
+    std::string path;
+    std::string contentHash;
+    if(!iter.ReadString(&path)
+       || !iter.ReadString(&contentHash))
+    {
+      LOG(WARNING)
+        << "ignored invalid cache entry: "
+        << getEntryPath(key);
+      stats_.misses++;
+      return false;
+    }
+    if(getFileContentHash(base::FilePath::FromUTF8Unsafe(path))
+       != contentHash)
+    {
+      DVLOG(9)
+        << "cache entry outdated by file: "
+        << path;
+      stats_.misses++;
+      return false;
+    }
+  }
+
+  int numAbsentDependencies = 0;
+  if(!iter.ReadInt(&numAbsentDependencies)
+     || numAbsentDependencies < 0)
+  {
+    LOG(WARNING)
+      << "ignored invalid cache entry: "
+      << getEntryPath(key);
+    stats_.misses++;
+    return false;
+  }
+
+  for(int i = 0; i < numAbsentDependencies; ++i) {
+    std::string path;
+    if(!iter.ReadString(&path)) {
+      LOG(WARNING)
+        << "ignored invalid cache entry: "
+        << getEntryPath(key);
+      stats_.misses++;
+      return false;
+    }
+    if(base::PathExists(base::FilePath::FromUTF8Unsafe(path))) {
+      // new header may shadow header that was included
+      DVLOG(9)
+        << "cache entry outdated by new file: "
+        << path;
+      stats_.misses++;
+      return false;
+    }
+  }
+
+  bool isRewritten = false;
+  std::string rewrittenBuffer;
+  int numSideOutputs = 0;
+  if(!iter.ReadBool(&isRewritten)
+     || !iter.ReadString(&rewrittenBuffer)
+     || !iter.ReadInt(&numSideOutputs)
+     || numSideOutputs < 0)
+  {
+    LOG(WARNING)
+      << "ignored invalid cache entry: "
+      << getEntryPath(key);
+    stats_.misses++;
+    return false;
+  }
+
+  std::map<std::string, std::string> sideOutputs;
+  for(int i = 0; i < numSideOutputs; ++i) {
+    std::string path;
+    std::string contents;
+    if(!iter.ReadString(&path)
+       || !iter.ReadString(&contents))
+    {
+      LOG(WARNING)
+        << "ignored invalid cache entry: "
+        << getEntryPath(key);
+      stats_.misses++;
+      return false;
+    }
+    sideOutputs[path] = std::move(contents);
+  }
+
+  result->isRewritten = isRewritten;
+  result->rewrittenBuffer = std::move(rewrittenBuffer);
+  result->sideOutputs = std::move(sideOutputs);
+  result->isFromCache = true;
+
+  stats_.hits++;
+
+  return true;
+}
+
+bool AnnotationResultCache::store(
+  const std::string& key
+  , const AnnotationFileResult& result)
+{
+  /// \note may be called on any thread
+  DCHECK(result.status == AnnotationFileResult::Status::kDone);
+
+  if(key.empty()) {
+    return false;
+  }
+
+  if(result.dependencies.empty()) {
+    // entry without dependencies will never become outdated
+    LOG(WARNING)
+      << "unable to cache result without dependencies for file: "
+      << result.sourcePath;
+    return false;
+  }
+
+  base::Pickle pickle;
+  pickle.WriteInt(kCacheFormatVersion);
+  pickle.WriteString(key);
+  pickle.WriteInt(static_cast<int>(result.dependencies.size()));
+  for(const AnnotationFileDependency& dependency: result.dependencies) {
+    pickle.WriteString(dependency.path);
+    pickle.WriteString(dependency.contentHash);
+  }
+  pickle.WriteInt(static_cast<int>(result.absentDependencies.size()));
+  for(const std::string& path: result.absentDependencies) {
+    pickle.WriteString(path);
+  }
+  pickle.WriteBool(result.isRewritten);
+  pickle.WriteString(result.rewrittenBuffer);
+  pickle.WriteInt(static_cast<int>(result.sideOutputs.size()));
+  for(const auto& it: result.sideOutputs) {
+    pickle.WriteString(it.first);
+    pickle.WriteString(it.second);
+  }
+
+  base::File::Error error;
+  if(!base::CreateDirectoryAndGetError(options_.cacheDir, &error)) {
+    LOG(WARNING)
+      << "unable to create cache directory: "
+      << options_.cacheDir
+      << " error: "
+      << base::File::ErrorToString(error);
+    return false;
+  }
+
+  // other workers (or processes) never see partially written entry
+  const bool isWritten
+    = base::ImportantFileWriter::WriteFileAtomically(
+        getEntryPath(key)
+        , base::StringPiece(
+            static_cast<const char*>(pickle.data()), pickle.size()));
+  if(!isWritten) {
+    LOG(WARNING)
+      << "unable to write cache entry: "
+      << getEntryPath(key);
+    return false;
+  }
+
+  stats_.stores++;
+
+  return true;
+}
+
+std::string AnnotationResultCache::getFileContentHash(
+  const base::FilePath& filePath)
+{
+  base::File::Info fileInfo;
+  if(!base::GetFileInfo(filePath, &fileInfo)
+     || fileInfo.is_directory)
+  {
+    return std::string();
+  }
+
+  {
+    base::AutoLock lock(fileHashesLock_);
+    auto it = fileHashes_.find(filePath);
+    if(it != fileHashes_.end()
+       && it->second.lastModified == fileInfo.last_modified
+       && it->second.size == fileInfo.size)
+    {
+      return it->second.contentHash;
+    }
+  }
+
+  // hash without lock, so workers can hash different files in parallel
+  std::string contents;
+  if(!base::ReadFileToString(filePath, &contents)) {
+    return std::string();
+  }
+
+  FileHash fileHash;
+  fileHash.lastModified = fileInfo.last_modified;
+  fileHash.size = fileInfo.size;
+  fileHash.contentHash = hexSHA1(contents);
+
+  {
+    base::AutoLock lock(fileHashesLock_);
+    fileHashes_[filePath] = fileHash;
+  }
+
+  return fileHash.contentHash;
+}
+
+base::FilePath AnnotationResultCache::getEntryPath(
+  const std::string& key) const
+{
+  DCHECK(!key.empty());
+  return options_.cacheDir.AppendASCII(key);
+}
+
+} // namespace clang_utils
@@ -0,0 +1,196 @@
+#include "flexlib/async_output_writer.hpp" // IWYU pragma: associated
+
+#include "flexlib/trace_event_recorder.hpp"
+
+#include <clang/Rewrite/Core/RewriteBuffer.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/threading/simple_thread.h>
+#include <base/trace_event/trace_event.h>
+
+#include <algorithm>
+
+namespace flexlib {
+
+class AsyncOutputWriter::IOThread
+  : public base::DelegateSimpleThread::Delegate
+{
+public:
+  explicit IOThread(AsyncOutputWriter* writer)
+    : writer_(writer)
+  {
+    DCHECK(writer_);
+  }
+
+  void Run() override
+  {
+    PendingWrite pendingWrite;
+    while(writer_->takePendingWrite(&pendingWrite)) {
+      TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY
+        , "AsyncOutputWriter::write"
+        , "file", pendingWrite.outputPath.AsUTF8Unsafe());
+
+      const OutputSink::WriteResult writeResult
+        = writer_->outputSink_->writeIfChanged(
+            pendingWrite.outputPath, pendingWrite.contents);
+
+      writer_->finishPendingWrite(
+        pendingWrite.outputPath
+        , pendingWrite.contents.size()
+        , writeResult);
+    }
+  }
+
+private:
+  AsyncOutputWriter* writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOThread);
+};
+
+AsyncOutputWriter::AsyncOutputWriter(
+  OutputSink* outputSink
+  , Options&& options)
+  : outputSink_(outputSink)
+  , options_(std::move(options))
+  , hasPendingWrites_(&lock_)
+  , writeFinished_(&lock_)
+{
+  DCHECK(outputSink_);
+  DCHECK(options_.maxPendingWrites);
+
+  const size_t numThreads = std::max<size_t>(1, options_.numThreads);
+  for(size_t threadIndex = 0; threadIndex < numThreads; ++threadIndex) {
+    ioThreads_.push_back(std::make_unique<IOThread>(this));
+    threads_.push_back(
+      std::make_unique<base::DelegateSimpleThread>(
+        ioThreads_.back().get()
+        , "OutputWriter" + base::NumberToString(threadIndex)));
+    threads_.back()->Start();
+  }
+}
+
+AsyncOutputWriter::~AsyncOutputWriter()
+{
+  flush();
+
+  {
+    base::AutoLock lock(lock_);
+    isStopping_ = true;
+    hasPendingWrites_.Broadcast();
+  }
+
+  for(std::unique_ptr<base::DelegateSimpleThread>& thread: threads_) {
+    thread->Join();
+  }
+}
+
+void AsyncOutputWriter::write(
+  const base::FilePath& outputPath
+  , std::string&& contents)
+{
+  /// \note may be called on any thread
+  const size_t contentsSize = contents.size();
+
+  base::AutoLock lock(lock_);
+  DCHECK(!isStopping_);
+
+  // backpressure: wait for I/O threads,
+  // but always accept write if nothing is pending
+  // (even if it is larger than |maxPendingBytes|)
+  while(numUnfinishedWrites_ > 0
+        && (numUnfinishedWrites_ >= options_.maxPendingWrites
+            || pendingBytes_ + contentsSize > options_.maxPendingBytes))
+  {
+    TRACE_EVENT0(FLEXLIB_TRACE_CATEGORY
+      , "AsyncOutputWriter::waitForBackpressure");
+    writeFinished_.Wait();
+  }
+
+  pendingWrites_.push_back(
+    PendingWrite{outputPath, std::move(contents)});
+  pendingBytes_ += contentsSize;
+  numUnfinishedWrites_++;
+  hasPendingWrites_.Signal();
+}
+
+void AsyncOutputWriter::writeRewriteBuffer(
+  const base::FilePath& outputPath
+  , const clang::Rewriter& rewriter
+  , clang::FileID fileID)
+{
+  const clang::RewriteBuffer* rewriteBuffer
+    = rewriter.getRewriteBufferFor(fileID);
+  if(!rewriteBuffer) {
+    write(outputPath
+      , rewriter.getSourceMgr().getBufferData(fileID).str());
+    return;
+  }
+
+  write(outputPath
+    , std::string(rewriteBuffer->begin(), rewriteBuffer->end()));
+}
+
+bool AsyncOutputWriter::flush()
+{
+  TRACE_EVENT0(FLEXLIB_TRACE_CATEGORY, "AsyncOutputWriter::flush");
+
+  base::AutoLock lock(lock_);
+  while(numUnfinishedWrites_ > 0) {
+    writeFinished_.Wait();
+  }
+
+  const bool isOk = !hasFailedWrites_;
+  hasFailedWrites_ = false;
+  return isOk;
+}
+
+bool AsyncOutputWriter::takePendingWrite(
+  PendingWrite* pendingWrite)
+{
+  DCHECK(pendingWrite);
+
+  base::AutoLock lock(lock_);
+  for(;;) {
+    // skip files written by other I/O threads,
+    // so writes of same file finish in order of |write| calls
+    auto it = std::find_if(pendingWrites_.begin(), pendingWrites_.end()
+      , [this](const PendingWrite& queuedWrite) {
+          return writingPaths_.find(queuedWrite.outputPath)
+            == writingPaths_.end();
+        });
+    if(it != pendingWrites_.end()) {
+      writingPaths_.insert(it->outputPath);
+      *pendingWrite = std::move(*it);
+      pendingWrites_.erase(it);
+      return true;
+    }
+    if(isStopping_ && pendingWrites_.empty()) {
+      return false;
+    }
+    hasPendingWrites_.Wait();
+  }
+}
+
+void AsyncOutputWriter::finishPendingWrite(
+  const base::FilePath& outputPath
+  , size_t contentsSize
+  , OutputSink::WriteResult writeResult)
+{
+  base::AutoLock lock(lock_);
+  DCHECK(writingPaths_.count(outputPath));
+  writingPaths_.erase(outputPath);
+  // next write of same file may be waiting
+  hasPendingWrites_.Broadcast();
+  DCHECK_GE(pendingBytes_, contentsSize);
+  DCHECK_GT(numUnfinishedWrites_, 0u);
+  pendingBytes_ -= contentsSize;
+  numUnfinishedWrites_--;
+  if(writeResult == OutputSink::WriteResult::kFailed) {
+    hasFailedWrites_ = true;
+  }
+  writeFinished_.Broadcast();
+}
+
+} // namespace flexlib
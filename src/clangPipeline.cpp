@@ -1,6 +1,9 @@
 ﻿#include "flexlib/clangPipeline.hpp" // IWYU pragma: associated
 
+#include "flexlib/trace_event_recorder.hpp"
+
 #include <base/logging.h>
+#include <base/trace_event/trace_event.h>
 
 namespace clang_utils {
 
@@ -9,4 +12,50 @@ SourceTransformPipeline::SourceTransformPipeline()
   DETACH_FROM_SEQUENCE(sequence_checker_);
 }
 
+base::Optional<SourceTransformResult>
+  SourceTransformPipeline::runSourceTransformRule(
+    const std::string& ruleName
+    , const SourceTransformOptions& callback_args)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  SourceTransformRules::const_iterator it
+    = sourceTransformRules.find(ruleName);
+  if(it == sourceTransformRules.end()) {
+    DVLOG(9)
+      << "unable to find source transform rule: "
+      << ruleName;
+    return base::nullopt;
+  }
+
+  // tagged with rule name to find slow generators
+  TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY
+    , "SourceTransformCallback"
+    , "rule", ruleName);
+
+  SourceTransformArgSchemas::const_iterator schemaIt
+    = sourceTransformArgSchemas.find(ruleName);
+  if(schemaIt == sourceTransformArgSchemas.end()) {
+    return it->second.Run(callback_args);
+  }
+
+  flexlib::DecodedAnnotationArgs decodedArgs;
+  std::string error;
+  if(!schemaIt->second.decode(
+       callback_args.func_with_args, &decodedArgs, &error))
+  {
+    LOG(ERROR)
+      << "invalid arguments of source transform rule "
+      << ruleName
+      << ": "
+      << error;
+    // keep original code
+    return SourceTransformResult{};
+  }
+
+  SourceTransformOptions decodedOptions = callback_args;
+  decodedOptions.decoded_args = &decodedArgs;
+  return it->second.Run(decodedOptions);
+}
+
 } // namespace clang_utils
@@ -1,5 +1,8 @@
 ﻿#include "flexlib/clangUtils.hpp" // IWYU pragma: associated
 
+#include "flexlib/replacement_collector.hpp"
+#include "flexlib/token_boundary_index.hpp"
+
 #include <clang/Lex/Lexer.h>
 
 #include <base/logging.h>
@@ -323,6 +326,15 @@ void expandLocations(clang::SourceLocation& startLoc,
 clang::SourceLocation findSemiAfterLocation(
   const clang::SourceLocation& loc
   , clang::Rewriter& rewriter)
+{
+  return findSemiAfterLocation(
+    loc, rewriter, TokenBoundaryIndexCache::Current());
+}
+
+clang::SourceLocation findSemiAfterLocation(
+  const clang::SourceLocation& loc
+  , clang::Rewriter& rewriter
+  , TokenBoundaryIndexCache* tokenIndexCache)
 {
   clang::SourceLocation result;
 
@@ -337,6 +349,31 @@ clang::SourceLocation findSemiAfterLocation(
       return clang::SourceLocation();
   }
 
+  if(loc.isFileID()
+     && tokenIndexCache
+     && &tokenIndexCache->sourceManager() == &SM)
+  {
+    // binary search in token index instead of lexing
+    const std::pair<clang::FileID, unsigned> locInfo
+      = SM.getDecomposedLoc(loc);
+    const TokenBoundaryIndex* tokenIndex
+      = tokenIndexCache->getOrBuild(locInfo.first);
+    const TokenBoundaryIndex::Token* token
+      = tokenIndex
+        ? tokenIndex->findTokenAt(locInfo.second)
+        : nullptr;
+    /// \note |loc| may point into token, like second '>' of '>>',
+    /// then fall back to lexing
+    if(token) {
+      const TokenBoundaryIndex::Token* nextToken
+        = tokenIndex->findFirstTokenFrom(token->offset + token->length);
+      if(!nextToken || nextToken->kind != clang::tok::semi) {
+        return clang::SourceLocation();
+      }
+      return loc.getLocWithOffset(nextToken->offset - locInfo.second);
+    }
+  }
+
   result
     = clang::Lexer::getLocForEndOfToken(
        loc, /*Offset=*/0, SM, rewriter.getLangOpts());
@@ -787,8 +824,10 @@ void replaceWith(
   }
 
   /// \note if result.replacer is nullptr, than we will keep old code
-  rewriter.ReplaceText(
-    clang::SourceRange(startLoc, endLoc)
+  /// \note edit is collected if |ReplacementCollector| is current
+  clang_utils::replaceText(
+    rewriter
+    , clang::SourceRange(startLoc, endLoc)
     , replacement);
 }
 
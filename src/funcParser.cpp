@@ -1,8 +1,10 @@
 #include "flexlib/funcParser.hpp" // IWYU pragma: associated
 
+#include <algorithm>
 #include <cassert>
-#include <sstream>
-#include <iomanip>
+#include <cctype>
+#include <cstring>
+#include <iterator>
 
 namespace flexlib {
 
@@ -10,136 +12,357 @@ namespace {
 
 static const char kArgumentAssign = '=';
 
-} // namespace
+static const char kFuncSeparator = ';';
 
-/// \todo use base::SplitStringIntoKeyValuePairs and base::StringPairs
-functionArgument extract_func_arg(std::string const& inStr) {
-  std::string arg_value_ = inStr;
-  std::string arg_name_ = "";
-  // split string by assign ('=')
+static const char kArgsBegin = '(';
+
+static const char kArgsEnd = ')';
+
+static const char kArgsSeparator = ',';
+
+static const char kQuote = '"';
+
+static const char kEscape = '\\';
+
+static const char kRawStringPrefix = 'R';
+
+// see https://en.cppreference.com/w/cpp/language/string_literal
+static const size_t kMaxRawStringDelimiterSize = 16;
+
+bool isWhitespace(char c) {
+  return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+bool isIdentifierChar(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_';
+}
+
+// Returns |true| if |inStr[quotePos]| is opening quote
+// of raw string literal with prefix R, LR, uR, UR or u8R,
+// but not if 'R' ends identifier (like FOR"x").
+bool hasRawStringPrefix(std::string_view inStr, size_t quotePos) {
+  assert(inStr[quotePos] == kQuote);
+  if(quotePos == 0 || inStr[quotePos - 1] != kRawStringPrefix) {
+    return false;
+  }
+
+  // start of prefix including optional encoding prefix
+  size_t prefixBegin = quotePos - 1;
+  if(prefixBegin >= 2
+     && inStr.substr(prefixBegin - 2, 2) == "u8")
+  {
+    prefixBegin -= 2;
+  } else if(prefixBegin >= 1
+            && (inStr[prefixBegin - 1] == 'L'
+                || inStr[prefixBegin - 1] == 'u'
+                || inStr[prefixBegin - 1] == 'U'))
+  {
+    prefixBegin -= 1;
+  }
+
+  return prefixBegin == 0 || !isIdentifierChar(inStr[prefixBegin - 1]);
+}
+
+// |inStr[pos]| must be opening quote.
+// Returns position after closing quote
+// or |inStr.size()| if string literal is not terminated.
+/// \note escape sequences are not processed, so inner quote (\")
+/// does not close string literal
+size_t skipStringLiteral(std::string_view inStr, size_t pos) {
+  assert(inStr[pos] == kQuote);
+  for(size_t i = pos + 1; i < inStr.size(); ++i) {
+    if(inStr[i] == kEscape) {
+      // skip escaped char
+      ++i;
+      continue;
+    }
+    if(inStr[i] == kQuote) {
+      return i + 1;
+    }
+  }
+  return inStr.size();
+}
+
+// |inStr[pos]| must be opening quote of raw string literal
+// like R"delim(...)delim".
+// Returns position after closing quote
+// or |std::string_view::npos| if raw string literal is malformed.
+size_t skipRawStringLiteral(std::string_view inStr, size_t pos) {
+  assert(inStr[pos] == kQuote);
+  const size_t argsBegin = inStr.find(kArgsBegin, pos + 1);
+  if(argsBegin == std::string_view::npos
+     || argsBegin - pos - 1 > kMaxRawStringDelimiterSize)
+  {
+    return std::string_view::npos;
+  }
+
+  const std::string_view delimiter
+    = inStr.substr(pos + 1, argsBegin - pos - 1);
+
+  size_t argsEnd = argsBegin;
+  while((argsEnd = inStr.find(kArgsEnd, argsEnd + 1))
+        != std::string_view::npos)
+  {
+    const size_t quotePos = argsEnd + 1 + delimiter.size();
+    if(quotePos < inStr.size()
+       && inStr[quotePos] == kQuote
+       && inStr.substr(argsEnd + 1, delimiter.size()) == delimiter)
+    {
+      return quotePos + 1;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+// splits |inStr| by first assign ('=')
+flat_function_argument splitFuncArg(std::string_view inStr) {
+  std::string_view arg_value_ = inStr;
+  std::string_view arg_name_;
   auto delim_pos = inStr.find(kArgumentAssign);
-  if(delim_pos != std::string::npos) {
+  if(delim_pos != std::string_view::npos) {
     arg_name_ = inStr.substr(0, delim_pos);
     // argument name is everything before assign ('=')
     /// \note empty argument name results in empty argument value
     if(!arg_name_.empty()) {
       assert(arg_name_.length() + 1 <= inStr.length());
-      arg_value_ = inStr.substr(arg_name_.length() + 1, inStr.length());
+      arg_value_ = inStr.substr(arg_name_.length() + 1);
     }
   }
   return {arg_name_, arg_value_};
 }
 
-std::vector<flexlib::parsed_func> split_to_funcs(std::string const& inStr) {
-  std::vector<flexlib::parsed_func> result;
-  std::stringstream ss;
-  ss << inStr
-    << ";"; // close funcs list with ';'
-
-  std::string func_with_args_;
-  std::string func_name_unprocessed_;
-  std::string func_arg_as_str;
-  bool is_in_args = false;
-  std::vector<functionArgument> func_args_vec_;
-  std::map<std::string, std::vector<std::string>> func_args_as_name_to_value_;
-  while (ss >> std::ws) {
-      if (ss.peek() == '"') { // TODO: inner "
-          std::string quoted;
-          /// \todo use base::StringTokenizer
-          ss >> std::quoted(quoted);
-          //std::cout << "quoted " << quoted << "\n";
-          func_with_args_ += '"' + quoted + '"';
-          if(is_in_args) {
-            func_arg_as_str += '"' + quoted + '"';
-          }
+// lower bound of |name| in |func.sorted_name_index_|
+flat_parsed_func::name_index_type::const_iterator findNameIndex(
+  const flat_parsed_func& func, std::string_view name)
+{
+  return std::lower_bound(
+    func.sorted_name_index_.begin()
+    , func.sorted_name_index_.end()
+    , name
+    , [&func](uint32_t index, std::string_view name) {
+        return func.args_[index].name_ < name;
+      });
+}
+
+} // namespace
+
+/// \todo use base::SplitStringIntoKeyValuePairs and base::StringPairs
+functionArgument extract_func_arg(std::string_view inStr) {
+  const flat_function_argument arg = splitFuncArg(inStr);
+  return {std::string(arg.name_), std::string(arg.value_)};
+}
+
+const flat_function_argument* flat_parsed_func::find_arg(
+  std::string_view name) const
+{
+  auto it = findNameIndex(*this, name);
+  if(it == sorted_name_index_.end() || args_[*it].name_ != name) {
+    return nullptr;
+  }
+  return &args_[*it];
+}
+
+size_t flat_parsed_func::count_args(std::string_view name) const
+{
+  size_t count = 0;
+  for(auto it = findNameIndex(*this, name)
+      ; it != sorted_name_index_.end() && args_[*it].name_ == name
+      ; ++it)
+  {
+    ++count;
+  }
+  return count;
+}
+
+flat_parsed_funcs::flat_parsed_funcs() = default;
+
+flat_parsed_funcs::flat_parsed_funcs(flat_parsed_funcs&& other) = default;
+
+flat_parsed_funcs& flat_parsed_funcs::operator=(
+  flat_parsed_funcs&& other) = default;
+
+flat_parsed_funcs::~flat_parsed_funcs() = default;
+
+flat_parsed_funcs split_to_flat_funcs(std::string_view inStr) {
+  flat_parsed_funcs result;
+
+  // text without whitespace is never longer than |inStr|
+  result.buffer_.reset(new char[std::max<size_t>(inStr.size(), 1)]);
+  char* const buffer = result.buffer_.get();
+  // everything except whitespace outside of string literals
+  size_t bufferSize = 0;
+  // start of current func in |buffer|
+  size_t funcBegin = 0;
+  // |buffer| before first '(' of current func
+  size_t funcNameEnd = std::string_view::npos;
+  // start of current argument in |buffer|
+  size_t argBegin = 0;
+  flat_parsed_func func;
+  // nesting level of parentheses,
+  // only arguments at level 1 are split by ','
+  size_t depth = 0;
+
+  auto appendText = [&](std::string_view text) {
+    std::memcpy(buffer + bufferSize, text.data(), text.size());
+    bufferSize += text.size();
+  };
+
+  auto appendChar = [&](char c) {
+    buffer[bufferSize++] = c;
+  };
+
+  auto finishArg = [&]() {
+    /// \note argument is empty outside of parentheses
+    const std::string_view argText
+      = depth > 0
+        ? std::string_view(buffer + argBegin, bufferSize - argBegin)
+        : std::string_view();
+    func.args_.push_back(splitFuncArg(argText));
+  };
+
+  auto finishFunc = [&]() {
+    depth = 0;
+    if(bufferSize == funcBegin) {
+      return;
+    }
+    func.func_with_args_as_string_
+      = std::string_view(buffer + funcBegin, bufferSize - funcBegin);
+    // func without args and without () uses whole string as name
+    /// \note same applies to func with empty name like "(arg)"
+    func.func_name_
+      = (funcNameEnd == std::string_view::npos || funcNameEnd == funcBegin)
+        ? func.func_with_args_as_string_
+        : std::string_view(buffer + funcBegin, funcNameEnd - funcBegin);
+    for(uint32_t i = 0; i < func.args_.size(); ++i) {
+      if(!func.args_[i].name_.empty()) {
+        func.sorted_name_index_.push_back(i);
       }
-      else if (ss.peek() == '(') {
-          is_in_args = true;
-          func_name_unprocessed_ = func_with_args_;
-          char c;
-          ss >> c;
-          func_with_args_ += c;
-          func_arg_as_str.clear();
+    }
+    std::stable_sort(
+      func.sorted_name_index_.begin()
+      , func.sorted_name_index_.end()
+      , [&func](uint32_t lhs, uint32_t rhs) {
+          return func.args_[lhs].name_ < func.args_[rhs].name_;
+        });
+    result.funcs_.push_back(std::move(func));
+    func = flat_parsed_func();
+    funcBegin = bufferSize;
+    funcNameEnd = std::string_view::npos;
+  };
+
+  size_t pos = 0;
+  while(pos < inStr.size()) {
+    const char c = inStr[pos];
+
+    /// \note space, tabulator, newline, or the like will be removed
+    if(isWhitespace(c)) {
+      ++pos;
+      continue;
+    }
+
+    if(c == kQuote) {
+      size_t stringEnd = std::string_view::npos;
+      if(hasRawStringPrefix(inStr, pos)) {
+        stringEnd = skipRawStringLiteral(inStr, pos);
       }
-      else if (ss.peek() == ')') {
-          is_in_args = false;
-
-          functionArgument arg_parsed = extract_func_arg(func_arg_as_str);
-          func_args_vec_.push_back(arg_parsed);
-          if(!arg_parsed.name_.empty()) {
-            if(func_args_as_name_to_value_.find(arg_parsed.name_) != func_args_as_name_to_value_.end()) {
-              func_args_as_name_to_value_[arg_parsed.name_].push_back(arg_parsed.value_);
-            } else {
-              func_args_as_name_to_value_[arg_parsed.name_] = std::vector{arg_parsed.value_};
-            }
-          }
-
-          char c;
-          ss >> c;
-          func_with_args_ += c;
-          func_arg_as_str.clear();
+      if(stringEnd == std::string_view::npos) {
+        stringEnd = skipStringLiteral(inStr, pos);
       }
-      else if (ss.peek() == ',') {
-          assert(is_in_args);
-
-          functionArgument arg_parsed = extract_func_arg(func_arg_as_str);
-          func_args_vec_.push_back(arg_parsed);
-          if(!arg_parsed.name_.empty()) {
-            if(func_args_as_name_to_value_.find(arg_parsed.name_) != func_args_as_name_to_value_.end()) {
-              func_args_as_name_to_value_[arg_parsed.name_].push_back(arg_parsed.value_);
-            } else {
-              func_args_as_name_to_value_[arg_parsed.name_] = std::vector{arg_parsed.value_};
-            }
-          }
-
-          char c;
-          ss >> c;
-          func_with_args_ += c;
-          func_arg_as_str.clear();
+      // whitespace inside string literal is kept
+      appendText(inStr.substr(pos, stringEnd - pos));
+      pos = stringEnd;
+      continue;
+    }
+
+    ++pos;
+
+    if(c == kArgsBegin) {
+      if(depth == 0) {
+        funcNameEnd = bufferSize;
+        appendChar(c);
+        argBegin = bufferSize;
+      } else {
+        // nested parentheses are part of argument
+        appendChar(c);
       }
-      else if (ss.peek() == ';') {
-          char c;
-          ss >> c;
-
-          if(func_with_args_.empty()) {
-            continue;
-          }
-
-          //std::string func_name_normalized_ = func_name_unprocessed_;
-          /// \note space, tabulator, newline, or the like will be removed
-          //std::remove_if(func_name_normalized_.begin(), func_name_normalized_.end(),
-          //  ::isspace);
-          if(func_name_unprocessed_.empty()) {
-            // func without args and without ()
-            func_name_unprocessed_ = func_with_args_;
-          }
-          result.push_back(
-            flexlib::parsed_func{
-              func_with_args_,
-              {
-                func_name_unprocessed_,
-                //func_name_normalized_,
-                args{
-                  func_args_vec_,
-                  func_args_as_name_to_value_
-                },
-              }
-            });
-          func_with_args_.clear();
-          func_name_unprocessed_.clear();
-          func_args_vec_.clear();
-          func_arg_as_str.clear();
-          func_args_as_name_to_value_.clear();
+      ++depth;
+    }
+    else if(c == kArgsEnd) {
+      if(depth > 1) {
+        appendChar(c);
+        --depth;
       } else {
-          char c;
-          ss >> c;
-          func_with_args_ += c;
-          if(is_in_args) {
-            func_arg_as_str += c;
-          }
+        finishArg();
+        depth = 0;
+        appendChar(c);
       }
+    }
+    else if(c == kArgsSeparator && depth <= 1) {
+      assert(depth == 1);
+      finishArg();
+      appendChar(c);
+      argBegin = bufferSize;
+    }
+    else if(c == kFuncSeparator && depth == 0) {
+      finishFunc();
+    }
+    else {
+      appendChar(c);
+    }
+  }
+
+  // close funcs list
+  finishFunc();
+
+  result.buffer_size_ = bufferSize;
+
+  return result;
+}
+
+parsed_func to_parsed_func(const flat_parsed_func& flat_func) {
+  std::vector<functionArgument> func_args_vec_;
+  func_args_vec_.reserve(flat_func.args_.size());
+  for(const flat_function_argument& arg: flat_func.args_) {
+    func_args_vec_.push_back(
+      functionArgument{std::string(arg.name_), std::string(arg.value_)});
+  }
+
+  std::map<std::string, std::vector<std::string>> func_args_as_name_to_value_;
+  for(uint32_t index: flat_func.sorted_name_index_) {
+    const flat_function_argument& arg = flat_func.args_[index];
+    // |sorted_name_index_| is sorted, so insert at end of map
+    auto it = func_args_as_name_to_value_.end();
+    if(func_args_as_name_to_value_.empty()
+       || std::prev(it)->first != arg.name_)
+    {
+      it = func_args_as_name_to_value_.emplace_hint(
+        it, std::string(arg.name_), std::vector<std::string>{});
+    } else {
+      --it;
+    }
+    it->second.push_back(std::string(arg.value_));
+  }
 
-      //std::cout << func_with_args_ << "\n";
+  return parsed_func{
+    std::string(flat_func.func_with_args_as_string_),
+    {
+      std::string(flat_func.func_name_),
+      args{
+        std::move(func_args_vec_),
+        std::move(func_args_as_name_to_value_)
+      },
+    }
+  };
+}
+
+std::vector<flexlib::parsed_func> split_to_funcs(std::string_view inStr) {
+  const flat_parsed_funcs flat_funcs = split_to_flat_funcs(inStr);
+
+  std::vector<flexlib::parsed_func> result;
+  result.reserve(flat_funcs.size());
+  for(const flat_parsed_func& flat_func: flat_funcs) {
+    result.push_back(to_parsed_func(flat_func));
   }
   return result;
 }
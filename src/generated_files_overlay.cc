@@ -0,0 +1,146 @@
+#include "flexlib/generated_files_overlay.hpp" // IWYU pragma: associated
+
+#include "flexlib/output_sink.hpp"
+
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+
+namespace flexlib {
+
+namespace {
+
+// Non-copying |llvm::MemoryBuffer| that keeps contents alive.
+class SharedStringMemoryBuffer
+  : public llvm::MemoryBuffer
+{
+public:
+  SharedStringMemoryBuffer(
+    std::shared_ptr<const std::string> contents
+    , const std::string& bufferName)
+    : contents_(std::move(contents))
+    , bufferName_(bufferName)
+  {
+    DCHECK(contents_);
+    // |std::string| is null-terminated
+    init(contents_->data()
+      , contents_->data() + contents_->size()
+      , /* RequiresNullTerminator */ true);
+  }
+
+  llvm::StringRef getBufferIdentifier() const override
+  {
+    return bufferName_;
+  }
+
+  BufferKind getBufferKind() const override
+  {
+    return MemoryBuffer_Malloc;
+  }
+
+private:
+  std::shared_ptr<const std::string> contents_;
+
+  std::string bufferName_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedStringMemoryBuffer);
+};
+
+} // namespace
+
+GeneratedFilesOverlay::GeneratedFilesOverlay()
+{}
+
+GeneratedFilesOverlay::~GeneratedFilesOverlay()
+{}
+
+bool GeneratedFilesOverlay::addFile(
+  const base::FilePath& path
+  , base::StringPiece contents)
+{
+  /// \note may be called on any thread
+  DCHECK(path.IsAbsolute())
+    << "generated file path must be absolute: "
+    << path;
+
+  base::AutoLock lock(lock_);
+
+  SharedContents& stored = files_[path];
+  if(stored && base::StringPiece(*stored) == contents) {
+    return false;
+  }
+  stored = std::make_shared<const std::string>(contents.as_string());
+  return true;
+}
+
+bool GeneratedFilesOverlay::hasFile(
+  const base::FilePath& path) const
+{
+  base::AutoLock lock(lock_);
+
+  return files_.find(path) != files_.end();
+}
+
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>
+  GeneratedFilesOverlay::createFileSystem(
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> baseFileSystem) const
+{
+  DCHECK(baseFileSystem);
+
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> memoryFileSystem(
+    new llvm::vfs::InMemoryFileSystem);
+
+  {
+    base::AutoLock lock(lock_);
+    for(const auto& it: files_) {
+      const std::string path = it.first.AsUTF8Unsafe();
+      // |addFile| takes ownership of buffer, contents are not copied
+      const bool isAdded
+        = memoryFileSystem->addFile(
+            path
+            , /* ModificationTime */ 0
+            , std::make_unique<SharedStringMemoryBuffer>(it.second, path));
+      DCHECK(isAdded)
+        << "unable to add generated file: "
+        << path;
+    }
+  }
+
+  llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> overlayFileSystem(
+    new llvm::vfs::OverlayFileSystem(baseFileSystem));
+  // last pushed file system has priority
+  overlayFileSystem->pushOverlay(memoryFileSystem);
+  return overlayFileSystem;
+}
+
+bool GeneratedFilesOverlay::flushToDisk(
+  OutputSink* diskSink) const
+{
+  DCHECK(diskSink);
+
+  std::map<base::FilePath, SharedContents> files;
+  {
+    base::AutoLock lock(lock_);
+    files = files_;
+  }
+
+  bool isOk = true;
+  for(const auto& it: files) {
+    if(diskSink->writeIfChanged(it.first, *it.second)
+       == OutputSink::WriteResult::kFailed)
+    {
+      isOk = false;
+    }
+  }
+  return isOk;
+}
+
+size_t GeneratedFilesOverlay::numFiles() const
+{
+  base::AutoLock lock(lock_);
+
+  return files_.size();
+}
+
+} // namespace flexlib
@@ -1,6 +1,9 @@
 ﻿#include "flexlib/matchers/annotation_matcher.hpp" // IWYU pragma: associated
 
 #include "flexlib/clangUtils.hpp"
+#include "flexlib/parser_constants.hpp"
+#include "flexlib/trace_event_recorder.hpp"
+#include "flexlib/token_boundary_index.hpp"
 
 #if __has_include(<filesystem>)
 #include <filesystem>
@@ -81,6 +84,10 @@
 
 #include <base/logging.h>
 #include <base/check.h>
+#include <base/optional.h>
+#include <base/trace_event/trace_event.h>
+
+#include <algorithm>
 
 #if __has_include(<filesystem>)
 namespace fs = std::filesystem;
@@ -90,6 +97,157 @@ namespace fs = std::experimental::filesystem;
 
 namespace clang_utils {
 
+namespace {
+
+// When there is a #include <vector> in the source file,
+// our find-decl will print out all the declarations
+// in that included file, because these included files are parsed
+// and consumed as a whole with our source file.
+// To fix this, we need to check if the declarations
+// are defined in our source file
+void logDeclInIncludedFile(
+  clang::SourceManager& SM
+  , const clang::Decl* nodeDecl
+  , const std::string& annotateName)
+{
+  const clang::FileID& mainFileID = SM.getMainFileID();
+  const auto& FileID = SM.getFileID(nodeDecl->getLocation());
+  if (FileID != mainFileID) {
+    DVLOG(10)
+      << "decl in included file: "
+      << nodeDecl->getLocation().printToString(SM).substr(0, 1000)
+      << " for annotation name: "
+      << annotateName;
+  }
+}
+
+// Unique |annotateName| of each options (in same order).
+std::vector<std::string> collectBoundNames(
+  const AnnotationMatchOptionsList& annotateOptions)
+{
+  std::vector<std::string> boundNames;
+  for(const scoped_refptr<AnnotationMatchOptions>& options
+      : annotateOptions)
+  {
+    DCHECK(options);
+    if(std::find(boundNames.begin()
+                 , boundNames.end()
+                 , options->annotateName) != boundNames.end())
+    {
+      continue;
+    }
+    boundNames.push_back(options->annotateName);
+  }
+  return boundNames;
+}
+
+// Binds same |clang::Decl| to each |annotateName|,
+// so callbacks can use own |annotateName| to get matched node.
+clang::ast_matchers::DeclarationMatcher
+  buildAnnotateMatcher(
+    const AnnotationMatchOptionsList& annotateOptions)
+{
+  DCHECK(!annotateOptions.empty());
+
+  auto hasAnnotateMatcher
+    = clang::ast_matchers::hasAttr(clang::attr::Annotate);
+
+  clang::ast_matchers::DeclarationMatcher finderMatcher
+    = clang::ast_matchers::decl(hasAnnotateMatcher);
+
+  for(const std::string& boundName: collectBoundNames(annotateOptions)) {
+    finderMatcher
+      = clang::ast_matchers::decl(finderMatcher)
+          .bind(boundName);
+  }
+
+  return finderMatcher;
+}
+
+// Visitor is used only if all |annotateOptions| select it.
+std::unique_ptr<AnnotateAttrVisitor>
+  createAnnotateAttrVisitor(
+    const AnnotationMatchOptionsList& annotateOptions
+    , clang::ast_matchers::MatchFinder::MatchCallback* matchCallback)
+{
+  for(const scoped_refptr<AnnotationMatchOptions>& options
+      : annotateOptions)
+  {
+    DCHECK(options);
+    if(options->matchBackend != AnnotationMatchBackend::kAttrVisitor) {
+      return nullptr;
+    }
+  }
+  return std::make_unique<AnnotateAttrVisitor>(
+    collectBoundNames(annotateOptions), matchCallback);
+}
+
+bool acceptsAnnotationMethod(
+  const AnnotationMatchOptions& options
+  , bool hasRequiredPrefix
+  , llvm::StringRef annotationMethod)
+{
+  if(options.annotationMethodPrefixes.empty()) {
+    return true;
+  }
+
+  if(!hasRequiredPrefix) {
+    return false;
+  }
+
+  for(const std::string& prefix: options.annotationMethodPrefixes) {
+    if(annotationMethod.startswith(prefix)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Traversal scope is restricted only if all |annotateOptions| allow it,
+// allowed headers are merged.
+std::unique_ptr<TraversalScopeFilter>
+  createTraversalScopeFilter(
+    const AnnotationMatchOptionsList& annotateOptions)
+{
+  std::vector<std::string> headerGlobs;
+  for(const scoped_refptr<AnnotationMatchOptions>& options
+      : annotateOptions)
+  {
+    DCHECK(options);
+    if(!options->restrictTraversalScope) {
+      return nullptr;
+    }
+    headerGlobs.insert(headerGlobs.end()
+      , options->traversalHeaderGlobs.begin()
+      , options->traversalHeaderGlobs.end());
+  }
+  return std::make_unique<TraversalScopeFilter>(headerGlobs);
+}
+
+// Makes arena of translation unit current only for callbacks
+// of |options| that set |useReflectionArena|,
+// so nodes kept by other callbacks are not freed with translation unit.
+class ScopedOptionsArena {
+public:
+  ScopedOptionsArena(
+    const AnnotationMatchOptions& options
+    , reflection::ReflectionArena* reflectionArena)
+  {
+    if(reflectionArena) {
+      scopedArena_.emplace(
+        options.useReflectionArena ? reflectionArena : nullptr);
+    }
+  }
+
+private:
+  base::Optional<reflection::ReflectionArena::ScopedCurrent> scopedArena_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedOptionsArena);
+};
+
+} // namespace
+
 AnnotationMatchOptions::AnnotationMatchOptions(
   std::string annotateName
   , AnnotationMatchCallback&& annotationMatchCallback
@@ -101,9 +259,11 @@ AnnotationMatchOptions::AnnotationMatchOptions(
 
 AnnotateMatchCallback::AnnotateMatchCallback(
   clang::Rewriter &rewriter
-  , scoped_refptr<AnnotationMatchOptions> annotateOptions)
+  , scoped_refptr<AnnotationMatchOptions> annotateOptions
+  , reflection::ReflectionArena* reflectionArena)
   : rewriter_(rewriter)
   , annotateOptions_(annotateOptions)
+  , reflectionArena_(reflectionArena)
 {
   DETACH_FROM_SEQUENCE(sequence_checker_);
 }
@@ -128,24 +288,10 @@ void AnnotateMatchCallback::run(
     return;
   }
 
-  // When there is a #include <vector> in the source file,
-  // our find-decl will print out all the declarations
-  // in that included file, because these included files are parsed
-  // and consumed as a whole with our source file.
-  // To fix this, we need to check if the declarations
-  // are defined in our source file
-  {
-    clang::SourceManager& SM = rewriter_.getSourceMgr();
-    const clang::FileID& mainFileID = SM.getMainFileID();
-    const auto& FileID = SM.getFileID(nodeDecl->getLocation());
-    if (FileID != mainFileID) {
-      DVLOG(10)
-        << "decl in included file: "
-        << nodeDecl->getLocation().printToString(SM).substr(0, 1000)
-        << " for annotation name: "
-        << annotateOptions_->annotateName;
-    }
-  }
+  logDeclInIncludedFile(
+    rewriter_.getSourceMgr()
+    , nodeDecl
+    , annotateOptions_->annotateName);
 
   clang::AnnotateAttr* annotateAttr
     = nodeDecl->getAttr<clang::AnnotateAttr>();
@@ -160,19 +306,116 @@ void AnnotateMatchCallback::run(
     << "found annotation: "
     << annotateAttr->getAnnotation().str();
 
+  ScopedOptionsArena scopedArena(*annotateOptions_, reflectionArena_);
   annotateOptions_->annotationMatchCallback.Run(
     annotateAttr, matchResult, rewriter_, nodeDecl);
 }
 
+MultiplexAnnotateMatchCallback::MultiplexAnnotateMatchCallback(
+  clang::Rewriter &rewriter
+  , const AnnotationMatchOptionsList& annotateOptions
+  , reflection::ReflectionArena* reflectionArena)
+  : rewriter_(rewriter)
+  , annotateOptions_(annotateOptions)
+  , reflectionArena_(reflectionArena)
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  DCHECK(!annotateOptions_.empty());
+}
+
+void MultiplexAnnotateMatchCallback::run(
+  const MatchResult& matchResult)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  DCHECK(!annotateOptions_.empty());
+
+  DVLOG(9)
+    << "MultiplexAnnotateMatchCallback::run...";
+
+  // same node is bound to each |annotateName|
+  const std::string& annotateName
+    = annotateOptions_.front()->annotateName;
+
+  const clang::Decl* nodeDecl
+    = matchResult.Nodes.getNodeAs<clang::Decl>(annotateName);
+  if (!nodeDecl || nodeDecl->isInvalidDecl()) {
+    DVLOG(10)
+      << "skipped nodeDecl for "
+      << annotateName;
+    return;
+  }
+
+  logDeclInIncludedFile(
+    rewriter_.getSourceMgr()
+    , nodeDecl
+    , annotateName);
+
+  const llvm::StringRef requiredPrefix
+    = ::flexlib::kRequiredAnnotationPrefix;
+
+  // node is matched once, but may have many annotations
+  // (each may be handled by other option sets)
+  for(clang::AnnotateAttr* annotateAttr
+      : nodeDecl->specific_attrs<clang::AnnotateAttr>())
+  {
+    DCHECK(annotateAttr);
+
+    const llvm::StringRef annotation
+      = annotateAttr->getAnnotation();
+
+    DVLOG(9)
+      << "found annotation: "
+      << annotation.str();
+
+    const bool hasRequiredPrefix
+      = annotation.startswith(requiredPrefix);
+
+    // annotation without |kRequiredAnnotationPrefix|
+    const llvm::StringRef annotationMethod
+      = hasRequiredPrefix
+        ? annotation.drop_front(requiredPrefix.size())
+        : annotation;
+
+    for(const scoped_refptr<AnnotationMatchOptions>& options
+        : annotateOptions_)
+    {
+      DCHECK(options);
+      if(!acceptsAnnotationMethod(
+           *options, hasRequiredPrefix, annotationMethod))
+      {
+        continue;
+      }
+      ScopedOptionsArena scopedArena(*options, reflectionArena_);
+      options->annotationMatchCallback.Run(
+        annotateAttr, matchResult, rewriter_, nodeDecl);
+    }
+  }
+}
+
 AnnotateConsumer::AnnotateConsumer(
   clang::Rewriter& rewriter
-  , scoped_refptr<AnnotationMatchOptions> annotateOptions)
-  : annotateMatchCallback_(rewriter, annotateOptions)
-  , annotateOptions_(annotateOptions)
+  , scoped_refptr<AnnotationMatchOptions> annotateOptions
+  , reflection::ReflectionArena* reflectionArena)
+  : annotateMatchCallback_(
+      std::make_unique<AnnotateMatchCallback>(
+        rewriter, annotateOptions, reflectionArena))
+  , annotateOptions_{annotateOptions}
+  , traversalScopeFilter_(
+      createTraversalScopeFilter(annotateOptions_))
+  , annotateAttrVisitor_(
+      createAnnotateAttrVisitor(
+        annotateOptions_, annotateMatchCallback_.get()))
 {
   DETACH_FROM_SEQUENCE(sequence_checker_);
 
-  DCHECK(annotateOptions_);
+  DCHECK(annotateOptions);
+
+  if(annotateAttrVisitor_) {
+    // |matchFinder| is not used
+    return;
+  }
 
   using namespace clang::ast_matchers;
 
@@ -186,7 +429,57 @@ AnnotateConsumer::AnnotateConsumer(
     = clang::ast_matchers::decl(hasAnnotateMatcher)
       .bind(annotateOptions->annotateName);
 
-  matchFinder.addMatcher(finderMatcher, &annotateMatchCallback_);
+  matchFinder.addMatcher(finderMatcher, annotateMatchCallback_.get());
+}
+
+AnnotateConsumer::AnnotateConsumer(
+  clang::Rewriter& rewriter
+  , const AnnotationMatchOptionsList& annotateOptions
+  , reflection::ReflectionArena* reflectionArena)
+  : annotateMatchCallback_(
+      std::make_unique<MultiplexAnnotateMatchCallback>(
+        rewriter, annotateOptions, reflectionArena))
+  , annotateOptions_(annotateOptions)
+  , traversalScopeFilter_(
+      createTraversalScopeFilter(annotateOptions_))
+  , annotateAttrVisitor_(
+      createAnnotateAttrVisitor(
+        annotateOptions_, annotateMatchCallback_.get()))
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  DCHECK(!annotateOptions_.empty());
+
+  if(annotateAttrVisitor_) {
+    // |matchFinder| is not used
+    return;
+  }
+
+  matchFinder.addMatcher(
+    buildAnnotateMatcher(annotateOptions_)
+    , annotateMatchCallback_.get());
+}
+
+bool AnnotateConsumer::HandleTopLevelDecl(
+  clang::DeclGroupRef declGroup)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  if(!traversalScopeFilter_) {
+    return true;
+  }
+
+  for(clang::Decl* decl: declGroup) {
+    if(traversalScopeFilter_->shouldTraverse(
+         decl, decl->getASTContext().getSourceManager()))
+    {
+      traversalScope_.push_back(decl);
+    } else {
+      skippedTopLevelDecls_++;
+    }
+  }
+
+  return true;
 }
 
 void AnnotateConsumer::HandleTranslationUnit(
@@ -194,6 +487,37 @@ void AnnotateConsumer::HandleTranslationUnit(
 {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
+  TRACE_EVENT0(FLEXLIB_TRACE_CATEGORY
+    , "AnnotateConsumer::HandleTranslationUnit");
+
+  if(traversalScopeFilter_) {
+    DVLOG(9)
+      << "Restricted traversal scope to "
+      << traversalScope_.size()
+      << " top-level decls, skipped "
+      << skippedTopLevelDecls_
+      << " top-level decls";
+
+    for(const scoped_refptr<AnnotationMatchOptions>& options
+        : annotateOptions_)
+    {
+      options->traversalScopeStats.traversedDecls
+        += traversalScope_.size();
+      options->traversalScopeStats.skippedDecls
+        += skippedTopLevelDecls_;
+    }
+
+    Context.setTraversalScope(traversalScope_);
+  }
+
+  if(annotateAttrVisitor_) {
+    DVLOG(9)
+      << "Started annotate attribute visitor...";
+
+    annotateAttrVisitor_->matchAST(Context);
+    return;
+  }
+
   DVLOG(9)
     << "Started AST matcher...";
 
@@ -202,11 +526,21 @@ void AnnotateConsumer::HandleTranslationUnit(
 
 AnnotationMatchAction::AnnotationMatchAction(
   scoped_refptr<AnnotationMatchOptions> annotateOptions)
+  : annotateOptions_{annotateOptions}
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  DCHECK(annotateOptions);
+}
+
+AnnotationMatchAction::AnnotationMatchAction(
+  const AnnotationMatchOptionsList& annotateOptions)
   : annotateOptions_(annotateOptions)
+  , isMultiplexed_(true)
 {
   DETACH_FROM_SEQUENCE(sequence_checker_);
 
-  DCHECK(annotateOptions_);
+  DCHECK(!annotateOptions_.empty());
 }
 
 AnnotationMatchAction::ASTConsumerPointer
@@ -216,8 +550,6 @@ AnnotationMatchAction::ASTConsumerPointer
 {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
-  ignore_result(filename);
-
   DVLOG(9)
     << "Created AST consumer...";
 
@@ -225,9 +557,61 @@ AnnotationMatchAction::ASTConsumerPointer
     compilerInstance.getSourceManager()
     , compilerInstance.getLangOpts());
 
-  DCHECK(annotateOptions_);
+  tokenIndexCache_
+    = std::make_unique<TokenBoundaryIndexCache>(
+        compilerInstance.getSourceManager()
+        , compilerInstance.getLangOpts());
+
+  // collected edits are not split by options, so exporting them
+  // would drop edits of options that expect them to be applied
+  size_t numExporting = 0;
+  for(const scoped_refptr<AnnotationMatchOptions>& options
+      : annotateOptions_)
+  {
+    DCHECK(options);
+    if(options->exportReplacements) {
+      numExporting++;
+    }
+  }
+  if(numExporting && numExporting != annotateOptions_.size()) {
+    LOG(ERROR)
+      << "options with and without exportReplacements"
+      << " can not be used in one action, skipping file: "
+      << filename.str();
+    return nullptr;
+  }
+
+  replacementCollector_.reset();
+  for(const scoped_refptr<AnnotationMatchOptions>& options
+      : annotateOptions_)
+  {
+    DCHECK(options);
+    if(options->collectReplacements) {
+      replacementCollector_
+        = std::make_unique<ReplacementCollector>(&rewriter_);
+      break;
+    }
+  }
+
+  reflectionArena_.reset();
+  for(const scoped_refptr<AnnotationMatchOptions>& options
+      : annotateOptions_)
+  {
+    DCHECK(options);
+    if(options->useReflectionArena) {
+      reflectionArena_
+        = std::make_unique<reflection::ReflectionArena>();
+      break;
+    }
+  }
+
+  DCHECK(!annotateOptions_.empty());
+  if(isMultiplexed_) {
+    return std::make_unique<AnnotateConsumer>(
+      rewriter_, annotateOptions_, reflectionArena_.get());
+  }
   return std::make_unique<AnnotateConsumer>(
-    rewriter_, annotateOptions_);
+    rewriter_, annotateOptions_.front(), reflectionArena_.get());
 }
 
 bool AnnotationMatchAction::BeginSourceFileAction(
@@ -235,17 +619,55 @@ bool AnnotationMatchAction::BeginSourceFileAction(
 {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
+  TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY
+    , "AnnotationMatchAction::BeginSourceFileAction"
+    , "file", getCurrentFile().str());
+
   DVLOG(9)
     << "Processing file: " << getCurrentFile().str();
   return true;
 }
 
+void AnnotationMatchAction::ExecuteAction()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  // parsing of translation unit,
+  // includes |AnnotateConsumer::HandleTranslationUnit|
+  TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY
+    , "AnnotationMatchAction::ExecuteAction"
+    , "file", getCurrentFile().str());
+
+  DCHECK(tokenIndexCache_);
+  TokenBoundaryIndexCache::ScopedCurrent scopedTokenIndexCache(
+    tokenIndexCache_.get());
+
+  if(!replacementCollector_) {
+    ASTFrontendAction::ExecuteAction();
+    return;
+  }
+
+  // route |replaceText| into collector while callbacks run
+  ReplacementCollector::ScopedCurrent scopedCollector(
+    replacementCollector_.get());
+  ASTFrontendAction::ExecuteAction();
+}
+
 void AnnotationMatchAction::EndSourceFileAction()
 {
   DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
 
+  TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY
+    , "AnnotationMatchAction::EndSourceFileAction"
+    , "file", getCurrentFile().str());
+
   ASTFrontendAction::EndSourceFileAction();
 
+  DCHECK(tokenIndexCache_);
+  base::Optional<TokenBoundaryIndexCache::ScopedCurrent>
+    scopedTokenIndexCache;
+  scopedTokenIndexCache.emplace(tokenIndexCache_.get());
+
   clang::SourceManager& SM = rewriter_.getSourceMgr();
 
   const clang::FileID& mainFileID = SM.getMainFileID();
@@ -256,19 +678,77 @@ void AnnotationMatchAction::EndSourceFileAction()
     NOTREACHED();
   }
 
-  DCHECK(annotateOptions_);
-  annotateOptions_->endSourceFileAction.Run(
-    mainFileID, fileEntry, rewriter_);
+  if(replacementCollector_) {
+    if(replacementCollector_->numConflicts()) {
+      LOG(ERROR)
+        << "found "
+        << replacementCollector_->numConflicts()
+        << " conflicting replacements in "
+        << getCurrentFile().str();
+    }
+    bool isExported = false;
+    for(const scoped_refptr<AnnotationMatchOptions>& options
+        : annotateOptions_)
+    {
+      DCHECK(options);
+      if(options->exportReplacements) {
+        options->exportReplacements.Run(
+          mainFileID, *replacementCollector_);
+        isExported = true;
+      }
+    }
+    if(isExported) {
+      DVLOG(9)
+        << "exported "
+        << replacementCollector_->size()
+        << " collected replacements";
+      replacementCollector_->clear();
+    } else {
+      DVLOG(9)
+        << "applying "
+        << replacementCollector_->size()
+        << " collected replacements";
+      replacementCollector_->applyAll();
+    }
+  }
+
+  DCHECK(!annotateOptions_.empty());
+  for(const scoped_refptr<AnnotationMatchOptions>& options
+      : annotateOptions_)
+  {
+    DCHECK(options);
+    ScopedOptionsArena scopedArena(*options, reflectionArena_.get());
+    options->endSourceFileAction.Run(
+      mainFileID, fileEntry, rewriter_);
+  }
+
+  // file buffers are released with |clang::SourceManager|
+  scopedTokenIndexCache.reset();
+  tokenIndexCache_.reset();
+
+  // frees all reflection nodes of translation unit at once
+  reflectionArena_.reset();
 }
 
 AnnotationMatchFactory::AnnotationMatchFactory(
   scoped_refptr<AnnotationMatchOptions> annotateOptions)
   : FrontendActionFactory()
+  , annotateOptions_{annotateOptions}
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  DCHECK(annotateOptions);
+}
+
+AnnotationMatchFactory::AnnotationMatchFactory(
+  const AnnotationMatchOptionsList& annotateOptions)
+  : FrontendActionFactory()
   , annotateOptions_(annotateOptions)
+  , isMultiplexed_(true)
 {
   DETACH_FROM_SEQUENCE(sequence_checker_);
 
-  DCHECK(annotateOptions_);
+  DCHECK(!annotateOptions_.empty());
 }
 
 clang::FrontendAction*
@@ -276,8 +756,11 @@ clang::FrontendAction*
 {
   DETACH_FROM_SEQUENCE(sequence_checker_);
 
-  DCHECK(annotateOptions_);
-  return new AnnotationMatchAction(annotateOptions_);
+  DCHECK(!annotateOptions_.empty());
+  if(isMultiplexed_) {
+    return new AnnotationMatchAction(annotateOptions_);
+  }
+  return new AnnotationMatchAction(annotateOptions_.front());
 }
 
 } // namespace clang_utils
@@ -0,0 +1,103 @@
+#include "flexlib/matchers/annotation_visitor.hpp" // IWYU pragma: associated
+
+#include <clang/AST/Attr.h>
+#include <clang/ASTMatchers/ASTMatchersInternal.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+
+namespace clang_utils {
+
+namespace {
+
+// Passes |MatchResult| for each match of |BoundNodesTreeBuilder|
+// to |MatchFinder::MatchCallback|, same as |MatchFinder| does.
+class MatchCallbackVisitor
+  : public clang::ast_matchers::internal::BoundNodesTreeBuilder::Visitor
+{
+public:
+  MatchCallbackVisitor(
+    clang::ASTContext* context
+    , clang::ast_matchers::MatchFinder::MatchCallback* matchCallback)
+    : context_(context)
+    , matchCallback_(matchCallback)
+  {
+    DCHECK(context_);
+    DCHECK(matchCallback_);
+  }
+
+  void visitMatch(
+    const clang::ast_matchers::BoundNodes& boundNodes) override
+  {
+    matchCallback_->run(
+      clang::ast_matchers::MatchFinder::MatchResult(
+        boundNodes, context_));
+  }
+
+private:
+  clang::ASTContext* context_;
+
+  clang::ast_matchers::MatchFinder::MatchCallback* matchCallback_;
+};
+
+} // namespace
+
+AnnotateAttrVisitor::AnnotateAttrVisitor(
+  const std::vector<std::string>& boundNames
+  , clang::ast_matchers::MatchFinder::MatchCallback* matchCallback)
+  : boundNames_(boundNames)
+  , matchCallback_(matchCallback)
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  DCHECK(!boundNames_.empty());
+  DCHECK(matchCallback_);
+}
+
+void AnnotateAttrVisitor::matchAST(clang::ASTContext& context)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  context_ = &context;
+
+  matchCallback_->onStartOfTranslationUnit();
+
+  // traverses |clang::ASTContext::getTraversalScope|
+  TraverseAST(context);
+
+  matchCallback_->onEndOfTranslationUnit();
+
+  context_ = nullptr;
+}
+
+bool AnnotateAttrVisitor::VisitDecl(clang::Decl* decl)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  // most decls have no attributes,
+  // so check cheap flag before searching attribute list
+  if(!decl->hasAttrs()
+     || !decl->hasAttr<clang::AnnotateAttr>())
+  {
+    // continue traversal
+    return true;
+  }
+
+  DCHECK(context_);
+
+  const clang::ast_type_traits::DynTypedNode node
+    = clang::ast_type_traits::DynTypedNode::create(*decl);
+
+  clang::ast_matchers::internal::BoundNodesTreeBuilder boundNodesBuilder;
+  for(const std::string& boundName: boundNames_) {
+    boundNodesBuilder.setBinding(boundName, node);
+  }
+
+  MatchCallbackVisitor matchCallbackVisitor(context_, matchCallback_);
+  boundNodesBuilder.visitMatches(&matchCallbackVisitor);
+
+  // continue traversal
+  return true;
+}
+
+} // namespace clang_utils
@@ -0,0 +1,93 @@
+#include "flexlib/matchers/traversal_scope.hpp" // IWYU pragma: associated
+
+#include <clang/Basic/FileManager.h>
+
+#include <llvm/Support/Error.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+
+namespace clang_utils {
+
+TraversalScopeFilter::TraversalScopeFilter(
+  const std::vector<std::string>& headerGlobs)
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  for(const std::string& headerGlob: headerGlobs) {
+    llvm::Expected<llvm::GlobPattern> pattern
+      = llvm::GlobPattern::create(headerGlob);
+    if(!pattern) {
+      LOG(ERROR)
+        << "skipped invalid header glob: "
+        << headerGlob
+        << " error: "
+        << llvm::toString(pattern.takeError());
+      continue;
+    }
+    headerGlobs_.push_back(std::move(*pattern));
+  }
+}
+
+bool TraversalScopeFilter::shouldTraverse(
+  const clang::Decl* decl
+  , const clang::SourceManager& SM)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  DCHECK(decl);
+
+  // macros need a special handling, because we are interessted
+  // in the macro instanciation location
+  const clang::SourceLocation loc
+    = SM.getExpansionLoc(decl->getLocation());
+  if(loc.isInvalid()) {
+    // builtin or implicit decl
+    return false;
+  }
+
+  const clang::FileID fileID = SM.getFileID(loc);
+  if(fileID == SM.getMainFileID()) {
+    return true;
+  }
+
+  if(headerGlobs_.empty()) {
+    return false;
+  }
+
+  auto it = allowedFiles_.find(fileID);
+  if(it != allowedFiles_.end()) {
+    return it->second;
+  }
+
+  const bool isAllowed = isAllowedFile(fileID, SM);
+  allowedFiles_[fileID] = isAllowed;
+  return isAllowed;
+}
+
+bool TraversalScopeFilter::isAllowedFile(
+  const clang::FileID& fileID
+  , const clang::SourceManager& SM)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  const clang::FileEntry* fileEntry
+    = SM.getFileEntryForID(fileID);
+  if(!fileEntry) {
+    return false;
+  }
+
+  const llvm::StringRef fileName = fileEntry->getName();
+  for(const llvm::GlobPattern& headerGlob: headerGlobs_) {
+    if(headerGlob.match(fileName)) {
+      DVLOG(10)
+        << "header allowed in traversal scope: "
+        << fileName.str();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // namespace clang_utils
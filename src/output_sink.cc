@@ -0,0 +1,225 @@
+#include "flexlib/output_sink.hpp" // IWYU pragma: associated
+
+#include "flexlib/generated_files_overlay.hpp"
+
+#include <clang/Rewrite/Core/RewriteBuffer.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/files/file.h>
+#include <base/files/file_util.h>
+#include <base/files/important_file_writer.h>
+#include <base/hash/sha1.h>
+
+namespace flexlib {
+
+namespace {
+
+// same as |base::SHA1HashString|, but without copy of |contents|
+std::string hashContents(base::StringPiece contents)
+{
+  std::string result(base::kSHA1Length, '\0');
+  base::SHA1HashBytes(
+    reinterpret_cast<const unsigned char*>(contents.data())
+    , contents.size()
+    , reinterpret_cast<unsigned char*>(&result[0]));
+  return result;
+}
+
+} // namespace
+
+OutputSink::OutputSink()
+{}
+
+OutputSink::OutputSink(GeneratedFilesOverlay* generatedFilesOverlay)
+  : generatedFilesOverlay_(generatedFilesOverlay)
+{
+  DCHECK(generatedFilesOverlay_);
+}
+
+OutputSink::~OutputSink()
+{
+  DVLOG(9)
+    << "output sink: written "
+    << stats_.written
+    << ", skipped "
+    << stats_.skipped
+    << ", failed "
+    << stats_.failed;
+}
+
+OutputSink::WriteResult OutputSink::writeIfChanged(
+  const base::FilePath& outputPath
+  , base::StringPiece contents)
+{
+  /// \note may be called on any thread
+  DCHECK(!outputPath.empty());
+
+  if(generatedFilesOverlay_) {
+    /// \note working directory of process is not directory
+    /// of translation unit (workers parse files in parallel),
+    /// so relative path can not be resolved
+    DCHECK(outputPath.IsAbsolute())
+      << "path of generated file must be absolute: "
+      << outputPath;
+    if(!outputPath.IsAbsolute()) {
+      LOG(ERROR)
+        << "path of generated file must be absolute: "
+        << outputPath;
+      stats_.failed++;
+      return WriteResult::kFailed;
+    }
+    if(!generatedFilesOverlay_->addFile(outputPath, contents)) {
+      stats_.skipped++;
+      return WriteResult::kSkipped;
+    }
+    stats_.written++;
+    return WriteResult::kWritten;
+  }
+
+  // computed only if required
+  std::string contentHash;
+
+  if(isSameContents(outputPath, contents, &contentHash)) {
+    DVLOG(9)
+      << "skipped writing of unchanged file: "
+      << outputPath;
+    stats_.skipped++;
+    return WriteResult::kSkipped;
+  }
+
+  base::File::Error error;
+  if(!base::CreateDirectoryAndGetError(outputPath.DirName(), &error)) {
+    LOG(ERROR)
+      << "unable to create directory: "
+      << outputPath.DirName()
+      << " error: "
+      << base::File::ErrorToString(error);
+    stats_.failed++;
+    return WriteResult::kFailed;
+  }
+
+  // writes temporary file and renames it,
+  // so readers never see partially written file
+  if(!base::ImportantFileWriter::WriteFileAtomically(
+       outputPath, contents))
+  {
+    LOG(ERROR)
+      << "unable to write file: "
+      << outputPath;
+    stats_.failed++;
+    return WriteResult::kFailed;
+  }
+
+  if(contentHash.empty()) {
+    contentHash = hashContents(contents);
+  }
+  rememberFileHash(outputPath, contentHash);
+
+  DVLOG(9)
+    << "written file: "
+    << outputPath;
+  stats_.written++;
+  return WriteResult::kWritten;
+}
+
+OutputSink::WriteResult OutputSink::writeRewriteBuffer(
+  const base::FilePath& outputPath
+  , const clang::Rewriter& rewriter
+  , clang::FileID fileID)
+{
+  const clang::RewriteBuffer* rewriteBuffer
+    = rewriter.getRewriteBufferFor(fileID);
+  if(!rewriteBuffer) {
+    const llvm::StringRef original
+      = rewriter.getSourceMgr().getBufferData(fileID);
+    return writeIfChanged(outputPath
+      , base::StringPiece(original.data(), original.size()));
+  }
+
+  const std::string contents(
+    rewriteBuffer->begin(), rewriteBuffer->end());
+  return writeIfChanged(outputPath, contents);
+}
+
+bool OutputSink::isSameContents(
+  const base::FilePath& outputPath
+  , base::StringPiece contents
+  , std::string* contentHash)
+{
+  DCHECK(contentHash);
+
+  base::File::Info fileInfo;
+  if(!base::GetFileInfo(outputPath, &fileInfo)
+     || fileInfo.is_directory)
+  {
+    return false;
+  }
+
+  // compare size first, it does not require reading of file
+  if(fileInfo.size != static_cast<int64_t>(contents.size())) {
+    return false;
+  }
+
+  std::string rememberedHash;
+  {
+    base::AutoLock lock(fileHashesLock_);
+    auto it = fileHashes_.find(outputPath);
+    if(it != fileHashes_.end()
+       && it->second.lastModified == fileInfo.last_modified
+       && it->second.size == fileInfo.size)
+    {
+      rememberedHash = it->second.contentHash;
+    }
+  }
+
+  // hash without lock, so workers can check different files in parallel
+  if(!rememberedHash.empty()) {
+    *contentHash = hashContents(contents);
+    return rememberedHash == *contentHash;
+  }
+
+  std::string existingContents;
+  if(!base::ReadFileToString(outputPath, &existingContents)) {
+    return false;
+  }
+
+  // file will be overwritten, so its hash is not remembered
+  if(existingContents != contents) {
+    return false;
+  }
+
+  *contentHash = hashContents(contents);
+
+  FileHash fileHash;
+  fileHash.lastModified = fileInfo.last_modified;
+  fileHash.size = fileInfo.size;
+  fileHash.contentHash = *contentHash;
+
+  {
+    base::AutoLock lock(fileHashesLock_);
+    fileHashes_[outputPath] = std::move(fileHash);
+  }
+
+  return true;
+}
+
+void OutputSink::rememberFileHash(
+  const base::FilePath& outputPath
+  , const std::string& contentHash)
+{
+  base::File::Info fileInfo;
+  if(!base::GetFileInfo(outputPath, &fileInfo)) {
+    return;
+  }
+
+  FileHash fileHash;
+  fileHash.lastModified = fileInfo.last_modified;
+  fileHash.size = fileInfo.size;
+  fileHash.contentHash = contentHash;
+
+  base::AutoLock lock(fileHashesLock_);
+  fileHashes_[outputPath] = std::move(fileHash);
+}
+
+} // namespace flexlib
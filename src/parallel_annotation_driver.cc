@@ -0,0 +1,688 @@
+#include "flexlib/parallel_annotation_driver.hpp" // IWYU pragma: associated
+
+#include "flexlib/annotation_result_cache.hpp"
+#include "flexlib/shared_precompiled_header.hpp"
+#include "flexlib/generated_files_overlay.hpp"
+#include "flexlib/trace_event_recorder.hpp"
+
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Lex/DirectoryLookup.h>
+#include <clang/Lex/HeaderSearch.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Preprocessor.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/VirtualFileSystem.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/bind.h>
+#include <base/files/file_path.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/system/sys_info.h>
+#include <base/threading/simple_thread.h>
+#include <base/trace_event/trace_event.h>
+
+#include <algorithm>
+#include <set>
+
+namespace clang_utils {
+
+namespace {
+
+// Records paths where preprocessor searched for included header
+// before it found header (include lookup misses),
+// so cached result can be invalidated when new header
+// shadows header that was included before.
+/// \note over-approximates search for |#include_next|,
+/// extra paths may only cause cache miss
+class IncludeMissRecorder
+  : public clang::PPCallbacks
+{
+public:
+  IncludeMissRecorder(
+    clang::CompilerInstance& compilerInstance
+    , std::set<std::string>* absentPaths)
+    : compilerInstance_(compilerInstance)
+    , absentPaths_(absentPaths)
+  {
+    DCHECK(absentPaths_);
+  }
+
+  void InclusionDirective(
+    clang::SourceLocation hashLoc
+    , const clang::Token& includeTok
+    , llvm::StringRef fileName
+    , bool isAngled
+    , clang::CharSourceRange filenameRange
+    , const clang::FileEntry* file
+    , llvm::StringRef searchPath
+    , llvm::StringRef relativePath
+    , const clang::Module* imported
+    , clang::SrcMgr::CharacteristicKind fileType) override
+  {
+    ignore_result(includeTok);
+    ignore_result(filenameRange);
+    ignore_result(relativePath);
+    ignore_result(imported);
+    ignore_result(fileType);
+
+    if(!file || searchPath.empty()
+       || llvm::sys::path::is_absolute(fileName))
+    {
+      // not found headers are reported as errors,
+      // results with errors are not cached
+      return;
+    }
+
+    if(!isAngled) {
+      // quoted include is searched in directory of including file first
+      clang::SourceManager& SM = compilerInstance_.getSourceManager();
+      const clang::FileEntry* includingFile
+        = SM.getFileEntryForID(SM.getFileID(hashLoc));
+      if(includingFile) {
+        if(includingFile->getDir()->getName() == searchPath) {
+          return;
+        }
+        addAbsentPath(includingFile->getDir()->getName(), fileName);
+      }
+    }
+
+    clang::HeaderSearch& headerSearch
+      = compilerInstance_.getPreprocessor().getHeaderSearchInfo();
+    for(auto it = isAngled
+                  ? headerSearch.angled_dir_begin()
+                  : headerSearch.quoted_dir_begin()
+        ; it != headerSearch.search_dir_end()
+        ; ++it)
+    {
+      if(!it->isNormalDir()) {
+        // frameworks and header maps are not supported,
+        // remaining directories are not recorded
+        return;
+      }
+      if(it->getDir()->getName() == searchPath) {
+        return;
+      }
+      addAbsentPath(it->getDir()->getName(), fileName);
+    }
+  }
+
+private:
+  void addAbsentPath(
+    llvm::StringRef dir
+    , llvm::StringRef fileName)
+  {
+    llvm::SmallString<256> path(dir);
+    llvm::sys::path::append(path, fileName);
+    // relative to working directory of compile command
+    compilerInstance_.getFileManager().makeAbsolutePath(path);
+    llvm::sys::path::remove_dots(path, /* remove_dot_dot */ true);
+    absentPaths_->insert(path.str().str());
+  }
+
+  clang::CompilerInstance& compilerInstance_;
+
+  std::set<std::string>* absentPaths_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncludeMissRecorder);
+};
+
+// Stores main file contents after |AnnotationMatchAction|
+// finished all |clang::Rewriter| edits.
+class ResultCapturingAction
+  : public AnnotationMatchAction
+{
+public:
+  ResultCapturingAction(
+    scoped_refptr<AnnotationMatchOptions> annotateOptions
+    , AnnotationFileResult* result
+    , bool collectDependencies
+    , base::RepeatingClosure waitForEndSourceFileTurn)
+    : AnnotationMatchAction(annotateOptions)
+    , result_(result)
+    , collectDependencies_(collectDependencies)
+    , waitForEndSourceFileTurn_(std::move(waitForEndSourceFileTurn))
+  {
+    DCHECK(result_);
+    DCHECK(waitForEndSourceFileTurn_);
+  }
+
+  bool BeginSourceFileAction(
+    clang::CompilerInstance& compilerInstance) override
+  {
+    if(!AnnotationMatchAction::BeginSourceFileAction(compilerInstance)) {
+      return false;
+    }
+
+    if(collectDependencies_) {
+      absentPaths_.clear();
+      compilerInstance.getPreprocessor().addPPCallbacks(
+        std::make_unique<IncludeMissRecorder>(
+          compilerInstance, &absentPaths_));
+    }
+
+    return true;
+  }
+
+  void EndSourceFileAction() override
+  {
+    // callbacks of translation units run one at a time
+    // in order of source files
+    waitForEndSourceFileTurn_.Run();
+
+    // calls |endSourceFileAction| from |AnnotationMatchOptions|
+    AnnotationMatchAction::EndSourceFileAction();
+
+    clang::Rewriter& rewriter = getRewriter();
+
+    clang::SourceManager& SM = rewriter.getSourceMgr();
+
+    const clang::FileID mainFileID = SM.getMainFileID();
+
+    const clang::RewriteBuffer* rewriteBuffer
+      = rewriter.getRewriteBufferFor(mainFileID);
+    if(rewriteBuffer) {
+      result_->isRewritten = true;
+      result_->rewrittenBuffer
+        = std::string(rewriteBuffer->begin(), rewriteBuffer->end());
+    } else {
+      result_->isRewritten = false;
+      result_->rewrittenBuffer
+        = SM.getBufferData(mainFileID).str();
+    }
+
+    if(collectDependencies_) {
+      collectDependencies(SM);
+    }
+  }
+
+private:
+  // Stores hash of every file loaded by |clang::SourceManager|
+  // and paths where included headers were not found.
+  // Hash is calculated from contents seen by preprocessor,
+  // not from contents on disk (file may change during run).
+  void collectDependencies(clang::SourceManager& SM)
+  {
+    std::set<std::string> loadedPaths;
+    result_->dependencies.clear();
+    for(auto it = SM.fileinfo_begin(); it != SM.fileinfo_end(); ++it) {
+      const clang::FileEntry* fileEntry = it->first;
+      const llvm::MemoryBuffer* buffer = it->second->getRawBuffer();
+      if(!fileEntry || !buffer) {
+        // file was not read
+        continue;
+      }
+
+      const llvm::StringRef realPath = fileEntry->tryGetRealPathName();
+
+      AnnotationFileDependency dependency;
+      dependency.path
+        = realPath.empty()
+          ? fileEntry->getName().str()
+          : realPath.str();
+      dependency.contentHash
+        = computeContentHash(
+            base::StringPiece(
+              buffer->getBufferStart(), buffer->getBufferSize()));
+      loadedPaths.insert(dependency.path);
+      result_->dependencies.push_back(std::move(dependency));
+    }
+
+    result_->absentDependencies.clear();
+    for(const std::string& path: absentPaths_) {
+      // path may be loaded using other spelling
+      if(loadedPaths.count(path)) {
+        continue;
+      }
+      result_->absentDependencies.push_back(path);
+    }
+  }
+
+  AnnotationFileResult* result_;
+
+  bool collectDependencies_;
+
+  base::RepeatingClosure waitForEndSourceFileTurn_;
+
+  // filled by |IncludeMissRecorder|
+  std::set<std::string> absentPaths_;
+};
+
+class ResultCapturingFactory
+  : public clang::tooling::FrontendActionFactory
+{
+public:
+  ResultCapturingFactory(
+    scoped_refptr<AnnotationMatchOptions> annotateOptions
+    , AnnotationFileResult* result
+    , bool collectDependencies
+    , base::RepeatingClosure waitForEndSourceFileTurn)
+    : annotateOptions_(annotateOptions)
+    , result_(result)
+    , collectDependencies_(collectDependencies)
+    , waitForEndSourceFileTurn_(std::move(waitForEndSourceFileTurn))
+  {}
+
+  clang::FrontendAction* create() override
+  {
+    return new ResultCapturingAction(
+      annotateOptions_
+      , result_
+      , collectDependencies_
+      , waitForEndSourceFileTurn_);
+  }
+
+private:
+  scoped_refptr<AnnotationMatchOptions> annotateOptions_;
+
+  AnnotationFileResult* result_;
+
+  bool collectDependencies_;
+
+  base::RepeatingClosure waitForEndSourceFileTurn_;
+};
+
+} // namespace
+
+class ParallelAnnotationDriver::Worker
+  : public base::DelegateSimpleThread::Delegate
+{
+public:
+  Worker(
+    ParallelAnnotationDriver* driver
+    , size_t workerIndex
+    , scoped_refptr<AnnotationMatchOptions> annotateOptions)
+    : driver_(driver)
+    , workerIndex_(workerIndex)
+    , annotateOptions_(annotateOptions)
+    // |clang::tooling::ClangTool| changes working directory
+    // of its file system for each compile command,
+    // so each worker needs own file system
+    // (real file system changes working directory of process).
+    , fileSystem_(llvm::vfs::createPhysicalFileSystem().release())
+  {
+    DCHECK(driver_);
+    DCHECK(annotateOptions_);
+  }
+
+  void Run() override
+  {
+    const std::vector<std::string>& sourcePaths
+      = *driver_->sourcePaths_;
+
+    AnnotationResultCache* resultCache = usedResultCache();
+
+    SharedPrecompiledHeader* precompiledHeader
+      = driver_->options_.precompiledHeader;
+
+    // pre-scan reads files from disk, so it can not see
+    // files generated by previous passes
+    flexlib::AnnotationPrescanner* prescanner
+      = driver_->options_.generatedFilesOverlay
+        ? nullptr
+        : driver_->options_.prescanner;
+
+    // precompiled header is not part of compile command
+    // from compilation database, but changes result
+    const std::vector<std::string> extraKeyParts
+      = precompiledHeader
+        ? std::vector<std::string>{precompiledHeader->stamp()}
+        : std::vector<std::string>();
+
+    for(size_t index = driver_->takeNextIndex()
+        ; index < sourcePaths.size()
+        ; index = driver_->takeNextIndex())
+    {
+      // per-file span on worker thread, includes pre-scan and cache lookup
+      TRACE_EVENT1(FLEXLIB_TRACE_CATEGORY
+        , "ParallelAnnotationDriver::processFile"
+        , "file", sourcePaths[index]);
+
+      AnnotationFileResult result;
+      result.index = index;
+      result.sourcePath = sourcePaths[index];
+
+      if(prescanner
+         && !prescanner->mayContainAnnotations(
+              base::FilePath::FromUTF8Unsafe(result.sourcePath)))
+      {
+        // no need to parse translation unit
+        result.status = AnnotationFileResult::Status::kSkipped;
+      } else {
+        const std::string cacheKey
+          = resultCache
+            ? resultCache->computeKey(
+                driver_->compilations_, result.sourcePath, extraKeyParts)
+            : std::string();
+        if(resultCache && resultCache->lookup(cacheKey, &result)) {
+          // no need to parse translation unit
+          result.status = AnnotationFileResult::Status::kDone;
+        } else {
+          runTool(&result);
+          if(resultCache
+             && result.status == AnnotationFileResult::Status::kDone)
+          {
+            resultCache->store(cacheKey, result);
+          }
+        }
+      }
+
+      DVLOG(9)
+        << "processed file: "
+        << result.sourcePath;
+
+      // lets next translation unit run |endSourceFileAction|,
+      // does not wait if |endSourceFileAction| was not called
+      driver_->finishEndSourceFileTurn(index);
+
+      driver_->storeResult(std::move(result));
+    }
+  }
+
+private:
+  // result cache hashes dependencies read through generated files overlay,
+  // but validates stored entries against files on disk,
+  // so it would replay stale results
+  AnnotationResultCache* usedResultCache() const
+  {
+    return driver_->options_.generatedFilesOverlay
+      ? nullptr
+      : driver_->options_.resultCache;
+  }
+
+  // called by |ResultCapturingAction| on this worker thread,
+  // may be called many times if file has many compile commands
+  void waitForEndSourceFileTurn(size_t index)
+  {
+    if(hasEndSourceFileTurn_) {
+      return;
+    }
+    driver_->waitForEndSourceFileTurn(index);
+    hasEndSourceFileTurn_ = true;
+  }
+
+  void runTool(AnnotationFileResult* result)
+  {
+    DCHECK(result);
+
+    flexlib::GeneratedFilesOverlay* generatedFilesOverlay
+      = driver_->options_.generatedFilesOverlay;
+
+    // new |clang::CompilerInstance| will be created for file
+    clang::tooling::ClangTool tool(
+      driver_->compilations_
+      , {result->sourcePath}
+      , std::make_shared<clang::PCHContainerOperations>()
+      // snapshot of generated files for this translation unit
+      , generatedFilesOverlay
+        ? generatedFilesOverlay->createFileSystem(fileSystem_)
+        : fileSystem_);
+
+    SharedPrecompiledHeader* precompiledHeader
+      = driver_->options_.precompiledHeader;
+    if(precompiledHeader && precompiledHeader->isReady()) {
+      // reuse parsed common include prefix
+      tool.appendArgumentsAdjuster(
+        precompiledHeader->getArgumentsAdjuster());
+    }
+
+    hasEndSourceFileTurn_ = false;
+
+    ResultCapturingFactory factory(
+      annotateOptions_
+      , result
+      , /* collectDependencies */ usedResultCache() != nullptr
+      , base::BindRepeating(
+          &Worker::waitForEndSourceFileTurn
+          , base::Unretained(this)
+          , result->index));
+
+    const int toolResult = tool.run(&factory);
+
+    result->status
+      = toolResult == 0
+        ? AnnotationFileResult::Status::kDone
+        : AnnotationFileResult::Status::kFailed;
+
+    if(driver_->options_.collectSideOutputs) {
+      driver_->options_.collectSideOutputs.Run(workerIndex_, result);
+    }
+  }
+
+  ParallelAnnotationDriver* driver_;
+
+  size_t workerIndex_;
+
+  scoped_refptr<AnnotationMatchOptions> annotateOptions_;
+
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSystem_;
+
+  // |true| if translation unit processed by |runTool|
+  // holds turn to run |endSourceFileAction|
+  bool hasEndSourceFileTurn_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+ParallelAnnotationDriver::ParallelAnnotationDriver(
+  const clang::tooling::CompilationDatabase& compilations
+  , Options&& options)
+  : compilations_(compilations)
+  , options_(std::move(options))
+  , resultReady_(&resultsLock_)
+  , endSourceFileTurnReady_(&endSourceFileTurnLock_)
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  DCHECK(options_.createWorkerOptions);
+}
+
+ParallelAnnotationDriver::~ParallelAnnotationDriver()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+bool ParallelAnnotationDriver::run(
+  const std::vector<std::string>& sourcePaths)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  if(sourcePaths.empty()) {
+    return true;
+  }
+
+  sourcePaths_ = &sourcePaths;
+
+  if(options_.precompiledHeader
+     && !options_.precompiledHeader->isReady())
+  {
+    LOG(WARNING)
+      << "precompiled header is not ready,"
+         " translation units will be parsed without it";
+  }
+
+  if(options_.prescanner && options_.generatedFilesOverlay) {
+    LOG(WARNING)
+      << "pre-scan is disabled,"
+         " it can not read files from generated files overlay";
+  }
+
+  if(options_.resultCache && options_.generatedFilesOverlay) {
+    LOG(WARNING)
+      << "result cache is disabled,"
+         " it can not validate files from generated files overlay";
+  }
+
+  nextIndex_ = 0;
+
+  {
+    base::AutoLock lock(resultsLock_);
+    results_.clear();
+    results_.resize(sourcePaths.size());
+  }
+
+  {
+    base::AutoLock lock(endSourceFileTurnLock_);
+    nextEndSourceFileTurn_ = 0;
+    finishedEndSourceFileTurns_.assign(sourcePaths.size(), false);
+  }
+
+  size_t numWorkers
+    = options_.numWorkers
+      ? options_.numWorkers
+      : static_cast<size_t>(base::SysInfo::NumberOfProcessors());
+  numWorkers = std::max<size_t>(
+    1, std::min(numWorkers, sourcePaths.size()));
+
+  DVLOG(9)
+    << "processing "
+    << sourcePaths.size()
+    << " files using "
+    << numWorkers
+    << " workers";
+
+  // precompiled header may be shared by many runs
+  const size_t numPchUsedBefore
+    = options_.precompiledHeader
+      ? options_.precompiledHeader->stats().used.load()
+      : 0;
+  const size_t numPchSkippedBefore
+    = options_.precompiledHeader
+      ? options_.precompiledHeader->stats().skipped.load()
+      : 0;
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::unique_ptr<base::DelegateSimpleThread>> threads;
+  for(size_t workerIndex = 0; workerIndex < numWorkers; ++workerIndex) {
+    // |createWorkerOptions| is called on |sequence_checker_|
+    scoped_refptr<AnnotationMatchOptions> workerOptions
+      = options_.createWorkerOptions.Run(workerIndex);
+    CHECK(workerOptions)
+      << "createWorkerOptions returned nothing for worker "
+      << workerIndex;
+
+    workers.push_back(
+      std::make_unique<Worker>(this, workerIndex, workerOptions));
+
+    threads.push_back(
+      std::make_unique<base::DelegateSimpleThread>(
+        workers.back().get()
+        , "AnnotationWorker" + base::NumberToString(workerIndex)));
+    threads.back()->Start();
+  }
+
+  // Merge step: results are reported in order of |sourcePaths|,
+  // so output is the same as for serial run.
+  bool isOk = true;
+  for(size_t index = 0; index < sourcePaths.size(); ++index) {
+    const AnnotationFileResult result = waitForResult(index);
+
+    if(result.status == AnnotationFileResult::Status::kFailed) {
+      LOG(ERROR)
+        << "failed to process file: "
+        << result.sourcePath;
+      isOk = false;
+    }
+
+    if(result.status == AnnotationFileResult::Status::kSkipped) {
+      // nothing was parsed, so there is no buffer to save
+      continue;
+    }
+
+    if(options_.onFileResult) {
+      options_.onFileResult.Run(result);
+    }
+  }
+
+  for(std::unique_ptr<base::DelegateSimpleThread>& thread: threads) {
+    thread->Join();
+  }
+
+  if(options_.precompiledHeader
+     && options_.precompiledHeader->isReady())
+  {
+    const SharedPrecompiledHeader::Stats& pchStats
+      = options_.precompiledHeader->stats();
+    LOG(INFO)
+      << "precompiled header used by "
+      << pchStats.used - numPchUsedBefore
+      << " translation units, skipped by "
+      << pchStats.skipped - numPchSkippedBefore;
+  }
+
+  sourcePaths_ = nullptr;
+
+  return isOk;
+}
+
+void ParallelAnnotationDriver::waitForEndSourceFileTurn(
+  size_t index)
+{
+  /// \note may be called on any worker thread
+  base::AutoLock lock(endSourceFileTurnLock_);
+  DCHECK(index < finishedEndSourceFileTurns_.size());
+  /// \note does not deadlock: indices are taken in increasing order,
+  /// so worker that holds smallest unfinished index never waits
+  while(nextEndSourceFileTurn_ != index) {
+    endSourceFileTurnReady_.Wait();
+  }
+}
+
+void ParallelAnnotationDriver::finishEndSourceFileTurn(
+  size_t index)
+{
+  /// \note may be called on any worker thread
+  base::AutoLock lock(endSourceFileTurnLock_);
+  DCHECK(index < finishedEndSourceFileTurns_.size());
+  DCHECK(!finishedEndSourceFileTurns_[index]);
+  finishedEndSourceFileTurns_[index] = true;
+  while(nextEndSourceFileTurn_ < finishedEndSourceFileTurns_.size()
+        && finishedEndSourceFileTurns_[nextEndSourceFileTurn_])
+  {
+    nextEndSourceFileTurn_++;
+  }
+  endSourceFileTurnReady_.Broadcast();
+}
+
+size_t ParallelAnnotationDriver::takeNextIndex()
+{
+  /// \note may be called on any worker thread
+  return nextIndex_.fetch_add(1);
+}
+
+void ParallelAnnotationDriver::storeResult(
+  AnnotationFileResult&& result)
+{
+  /// \note may be called on any worker thread
+  base::AutoLock lock(resultsLock_);
+  DCHECK(result.index < results_.size());
+  DCHECK(!results_[result.index]);
+  const size_t index = result.index;
+  results_[index] = std::move(result);
+  resultReady_.Broadcast();
+}
+
+AnnotationFileResult ParallelAnnotationDriver::waitForResult(
+  size_t index)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  base::AutoLock lock(resultsLock_);
+  DCHECK(index < results_.size());
+  while(!results_[index]) {
+    resultReady_.Wait();
+  }
+  AnnotationFileResult result = std::move(*results_[index]);
+  // free memory used by rewritten buffer
+  results_[index].reset();
+  return result;
+}
+
+} // namespace clang_utils
@@ -16,4 +16,8 @@ const char kAnnotateAttrName[] = "bind_gen";
 // ;
 const char kRequiredAnnotationPrefix[] = "{gen};";
 
+// USAGE:
+// __attribute__((annotate("{gen};{funccall};make_reflect;")))
+const char kAnnotateAttrSpelling[] = "annotate";
+
 } // namespace flexlib
@@ -0,0 +1,159 @@
+#include "flexlib/reflect/LazyClassInfo.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+
+namespace reflection
+{
+
+LazyClassInfo::LazyClassInfo(
+  const AstReflector& reflector
+  , const clang::CXXRecordDecl* decl
+  , NamespacesTree* nsTree
+  , bool recursive
+  , ClassInfoPtr classInfo
+  , bool isComplete)
+  : m_reflector(reflector)
+  , m_decl(decl)
+  , m_nsTree(nsTree)
+  , m_recursive(recursive)
+  , m_classInfo(std::move(classInfo))
+  // class without definition has only basic sections
+  , m_reflectedSections(
+      isComplete || !decl->hasDefinition() ? kAllSections : 0u)
+  , m_registeredClassInfo(isComplete ? m_classInfo : nullptr)
+{
+  DCHECK(m_decl);
+  DCHECK(m_classInfo);
+}
+
+const std::vector<MethodInfoPtr>& LazyClassInfo::GetMethods()
+{
+  EnsureSection(kMethods);
+  return m_classInfo->methods;
+}
+
+const std::vector<ClassInfo::BaseInfo>& LazyClassInfo::GetBaseClasses()
+{
+  EnsureSection(kBases);
+  return m_classInfo->baseClasses;
+}
+
+const std::vector<MemberInfoPtr>& LazyClassInfo::GetMembers()
+{
+  EnsureSection(kDecls);
+  return m_classInfo->members;
+}
+
+const std::vector<ClassInfo::InnerDeclInfo>& LazyClassInfo::GetInnerDecls()
+{
+  EnsureSection(kDecls);
+  return m_classInfo->innerDecls;
+}
+
+uint64_t LazyClassInfo::GetRecordSize()
+{
+  EnsureSection(kLayout);
+  return m_classInfo->ASTRecordSize;
+}
+
+unsigned LazyClassInfo::GetRecordNonVirtualAlignment()
+{
+  EnsureSection(kLayout);
+  return m_classInfo->ASTRecordNonVirtualAlignment;
+}
+
+ClassInfoPtr LazyClassInfo::GetClassInfo()
+{
+  if (m_registeredClassInfo) {
+    return m_registeredClassInfo;
+  }
+
+  // other proxy or |ReflectClass| may add same class first,
+  // then instance from |NamespacesTree| (or cache) is returned,
+  // so all users share one |ClassInfo| of class.
+  // Looked up before reflecting sections that would be thrown away.
+  if (m_nsTree) {
+    m_registeredClassInfo = m_nsTree->FindClass(m_decl);
+  }
+
+  ReflectionCache* cache = m_reflector.m_cache;
+  const std::string usr
+    = cache ? ReflectionCache::GetUSR(m_decl) : std::string();
+  if (!m_registeredClassInfo && !usr.empty())
+  {
+    m_registeredClassInfo = cache->LookupClass(
+      usr, m_reflector.m_astContext, m_recursive);
+    // same as in |AstReflector::ReflectClassLazy|
+    if (m_registeredClassInfo && m_nsTree)
+    {
+      m_nsTree->AddClass(
+        m_nsTree->GetNamespace(m_decl->getEnclosingNamespaceContext())
+        , m_decl
+        , m_registeredClassInfo);
+    }
+  }
+
+  if (m_registeredClassInfo) {
+    return m_registeredClassInfo;
+  }
+
+  // same order as in |AstReflector::ReflectClass|
+  EnsureSection(kLayout);
+  EnsureSection(kMethods);
+  EnsureSection(kBases);
+  EnsureSection(kDecls);
+
+  m_registeredClassInfo = m_classInfo;
+  if (!usr.empty()) {
+    // returns instance stored first if class is already cached
+    m_registeredClassInfo = cache->StoreClass(
+      usr, m_reflector.m_astContext, m_recursive, m_classInfo);
+  }
+
+  if (m_nsTree)
+  {
+    m_nsTree->AddClass(
+      m_nsTree->GetNamespace(m_decl->getEnclosingNamespaceContext())
+      , m_decl
+      , m_registeredClassInfo);
+  }
+
+  return m_registeredClassInfo;
+}
+
+void LazyClassInfo::EnsureSection(Section section)
+{
+  if (m_reflectedSections & section) {
+    return;
+  }
+  m_reflectedSections |= section;
+
+  DCHECK(m_decl->hasDefinition());
+  switch (section)
+  {
+    case kLayout: {
+      m_reflector.ReflectClassLayout(m_decl, m_classInfo.get());
+      break;
+    }
+    case kMethods: {
+      m_reflector.ReflectClassMethods(m_decl, m_classInfo.get(), m_nsTree);
+      break;
+    }
+    case kBases: {
+      m_reflector.ReflectClassBases(m_decl, m_classInfo.get());
+      break;
+    }
+    case kDecls: {
+      m_reflector.ReflectClassDecls(
+        m_decl, m_classInfo.get(), m_recursive);
+      break;
+    }
+    case kAllSections: {
+      NOTREACHED();
+      break;
+    }
+  }
+}
+
+} // namespace reflection
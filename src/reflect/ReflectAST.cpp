@@ -9,6 +9,7 @@
 #include <iostream>
 
 #include "flexlib/reflect/ast_utils.hpp"
+#include "flexlib/reflect/LazyClassInfo.hpp"
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -21,21 +22,6 @@ namespace reflection
 using namespace clang;
 
 
-template<typename Cont>
-auto FindExisting(
-  const Cont& cont, const std::string& qualifiedName)
-{
-  auto p = std::find_if(begin(cont), end(cont),
-    [&qualifiedName](auto& item)
-    {
-      return item->decl->getQualifiedNameAsString()
-        == qualifiedName;
-    }
-  );
-
-  return p == end(cont) ? typename Cont::value_type() : *p;
-}
-
 AccessType ConvertAccessType(
   clang::AccessSpecifier access)
 {
@@ -73,17 +59,33 @@ EnumInfoPtr AstReflector::ReflectEnum(
   if (nsTree != nullptr)
   {
     ns = nsTree->GetNamespace(nsContext);
-    enumInfo = FindExisting(ns->enums, decl->getQualifiedNameAsString());
+    enumInfo = nsTree->FindEnum(decl);
   }
 
   if (enumInfo) {
     return enumInfo;
   }
 
+  std::string usr;
+  if (m_cache)
+  {
+    usr = ReflectionCache::GetUSR(decl);
+    enumInfo = usr.empty()
+      ? EnumInfoPtr()
+      : m_cache->LookupEnum(usr, m_astContext);
+    if (enumInfo)
+    {
+      if (nsTree) {
+        nsTree->AddEnum(ns, decl, enumInfo);
+      }
+      return enumInfo;
+    }
+  }
+
   ///\todo
   // const NamedDecl* parentDecl = FindEnclosingOpaqueDecl(decl);
 
-  enumInfo = std::make_shared<EnumInfo>();
+  enumInfo = MakeReflectionNode<EnumInfo>();
   enumInfo->decl = decl;
   DCHECK(m_astContext);
   enumInfo->location = GetLocation(decl, m_astContext);
@@ -101,8 +103,12 @@ EnumInfoPtr AstReflector::ReflectEnum(
     enumInfo->items.push_back(std::move(item));
   }
 
-  if (ns) {
-    ns->enums.push_back(enumInfo);
+  if (!usr.empty()) {
+    enumInfo = m_cache->StoreEnum(usr, m_astContext, enumInfo);
+  }
+
+  if (nsTree) {
+    nsTree->AddEnum(ns, decl, enumInfo);
   }
 
   return enumInfo;
@@ -118,8 +124,7 @@ TypedefInfoPtr AstReflector::ReflectTypedef(
   if (nsTree != nullptr)
   {
     ns = nsTree->GetNamespace(nsContext);
-    typedefInfo = FindExisting(
-      ns->typedefs, decl->getQualifiedNameAsString());
+    typedefInfo = nsTree->FindTypedef(decl);
   }
 
   if (typedefInfo) {
@@ -128,7 +133,7 @@ TypedefInfoPtr AstReflector::ReflectTypedef(
 
   // const NamedDecl* parentDecl = FindEnclosingOpaqueDecl(decl);
 
-  typedefInfo = std::make_shared<TypedefInfo>();
+  typedefInfo = MakeReflectionNode<TypedefInfo>();
   typedefInfo->decl = decl;
   typedefInfo->location = GetLocation(decl, m_astContext);
 
@@ -136,8 +141,8 @@ TypedefInfoPtr AstReflector::ReflectTypedef(
   typedefInfo->aliasedType
     = TypeInfo::Create(decl->getUnderlyingType(), m_astContext);
 
-  if (ns) {
-    ns->typedefs.push_back(typedefInfo);
+  if (nsTree) {
+    nsTree->AddTypedef(ns, decl, typedefInfo);
   }
 
   return typedefInfo;
@@ -161,19 +166,109 @@ ClassInfoPtr AstReflector::ReflectClass(
   if (nsTree)
   {
     ns = nsTree->GetNamespace(nsContext);
-    classInfo = FindExisting(
-      ns->classes, decl->getQualifiedNameAsString());
+    classInfo = nsTree->FindClass(decl);
   }
 
   if (classInfo) {
     return classInfo;
   }
 
-  classInfo = std::make_shared<ClassInfo>();
+  // same class is often reflected for every annotation in file
+  std::string usr;
+  if (m_cache)
+  {
+    usr = ReflectionCache::GetUSR(decl);
+    classInfo = usr.empty()
+      ? ClassInfoPtr()
+      : m_cache->LookupClass(usr, m_astContext, recursive);
+    if (classInfo)
+    {
+      if (nsTree) {
+        nsTree->AddClass(ns, decl, classInfo);
+      }
+      return classInfo;
+    }
+  }
+
+  classInfo = MakeReflectionNode<ClassInfo>();
+  ReflectClassBasics(decl, classInfo.get());
+
+  if (decl->hasDefinition())
+  {
+    DCHECK(nsTree);
+    ReflectClassLayout(decl, classInfo.get());
+    ReflectClassMethods(decl, classInfo.get(), nsTree);
+    ReflectClassBases(decl, classInfo.get());
+    ReflectClassDecls(decl, classInfo.get(), recursive);
+  }
+
+  if (!usr.empty()) {
+    classInfo = m_cache->StoreClass(
+      usr, m_astContext, recursive, classInfo);
+  }
+
+  if (nsTree) {
+    nsTree->AddClass(ns, decl, classInfo);
+  }
+
+  return classInfo;
+}
+
+LazyClassInfoPtr AstReflector::ReflectClassLazy(
+  const CXXRecordDecl* decl, NamespacesTree* nsTree, bool recursive)
+{
+  DCHECK(decl);
+
+  if (decl->hasDefinition()) {
+    decl = decl->getDefinition();
+  }
+
+  ClassInfoPtr classInfo;
+  if (nsTree) {
+    classInfo = nsTree->FindClass(decl);
+  }
+
+  if (!classInfo && m_cache)
+  {
+    const std::string usr = ReflectionCache::GetUSR(decl);
+    if (!usr.empty()) {
+      classInfo = m_cache->LookupClass(usr, m_astContext, recursive);
+    }
+    // same as in |ReflectClass|
+    if (classInfo && nsTree)
+    {
+      nsTree->AddClass(
+        nsTree->GetNamespace(decl->getEnclosingNamespaceContext())
+        , decl
+        , classInfo);
+    }
+  }
+
+  // already reflected by |ReflectClass| or |LazyClassInfo::GetClassInfo|
+  if (classInfo)
+  {
+    return std::make_shared<LazyClassInfo>(
+      *this, decl, nsTree, recursive, classInfo, true);
+  }
+
+  classInfo = MakeReflectionNode<ClassInfo>();
+  ReflectClassBasics(decl, classInfo.get());
+
+  return std::make_shared<LazyClassInfo>(
+    *this, decl, nsTree, recursive, classInfo, false);
+}
+
+void AstReflector::ReflectClassBasics(
+  const CXXRecordDecl* decl
+  , ClassInfo* classInfo)
+{
+  DCHECK(decl);
+  DCHECK(classInfo);
+
   classInfo->decl = decl;
 
   DCHECK(m_astContext);
-  SetupNamedDeclInfo(decl, classInfo.get(), m_astContext);
+  SetupNamedDeclInfo(decl, classInfo, m_astContext);
   classInfo->isUnion = decl->isUnion();
   classInfo->location = GetLocation(decl, m_astContext);
 
@@ -195,126 +290,157 @@ ClassInfoPtr AstReflector::ReflectClass(
 
   if (decl->hasDefinition())
   {
-    DCHECK(m_astContext);
-
-    DCHECK(!decl->isInvalidDecl());
+    classInfo->isAbstract = decl->isAbstract();
+    classInfo->isTrivial = decl->isTrivial();
+    classInfo->hasDefinition = true;
+  }
+}
 
-    DCHECK(llvm::dyn_cast_or_null<clang::RecordDecl>(decl));
+void AstReflector::ReflectClassLayout(
+  const CXXRecordDecl* decl
+  , ClassInfo* classInfo)
+{
+  DCHECK(decl);
+  DCHECK(classInfo);
+  DCHECK(decl->hasDefinition());
+  DCHECK(m_astContext);
 
-    FullSourceLoc fullLocation
-      = m_astContext->getFullLoc(decl->getBeginLoc());
-    DCHECK(fullLocation.isValid());
+  DCHECK(!decl->isInvalidDecl());
 
-    /// Get or compute information about the layout
-    /// of the specified record (struct/union/class),
-    /// which indicates its size and field position information.
-    const clang::ASTRecordLayout& layout
-      = m_astContext->getASTRecordLayout(decl);
+  DCHECK(llvm::dyn_cast_or_null<clang::RecordDecl>(decl));
 
-    classInfo->ASTRecordSize
-      = layout.getSize().getQuantity();
+  FullSourceLoc fullLocation
+    = m_astContext->getFullLoc(decl->getBeginLoc());
+  DCHECK(fullLocation.isValid());
 
-    classInfo->ASTRecordNonVirtualAlignment
-      = layout.getNonVirtualAlignment().getQuantity();
+  /// Get or compute information about the layout
+  /// of the specified record (struct/union/class),
+  /// which indicates its size and field position information.
+  const clang::ASTRecordLayout& layout
+    = m_astContext->getASTRecordLayout(decl);
 
-    // If the class is final, then we know that the pointer points to an
-    // object of that type and can use the full alignment.
-    if (decl->hasAttr<clang::FinalAttr>()) {
-      classInfo->ASTRecordNonVirtualAlignment
-        = layout.getAlignment().getQuantity();
-    }
+  classInfo->ASTRecordSize
+    = layout.getSize().getQuantity();
 
-    DCHECK(nsTree);
-    ReflectImplicitSpecialMembers(decl, classInfo.get(), nsTree);
+  classInfo->ASTRecordNonVirtualAlignment
+    = layout.getNonVirtualAlignment().getQuantity();
 
-    for (auto methodDecl : decl->methods())
-    {
-        MethodInfoPtr methodInfo = ReflectMethod(methodDecl, nsTree);
-        classInfo->methods.push_back(methodInfo);
-    }
+  // If the class is final, then we know that the pointer points to an
+  // object of that type and can use the full alignment.
+  if (decl->hasAttr<clang::FinalAttr>()) {
+    classInfo->ASTRecordNonVirtualAlignment
+      = layout.getAlignment().getQuantity();
+  }
+}
 
-    classInfo->isAbstract = decl->isAbstract();
-    classInfo->isTrivial = decl->isTrivial();
-    classInfo->hasDefinition = true;
-    for (auto& base : decl->bases())
-    {
-        ClassInfo::BaseInfo baseInfo;
-        baseInfo.isVirtual = base.isVirtual();
-        baseInfo.accessType = ConvertAccessType(base.getAccessSpecifier());
-        baseInfo.baseClass = TypeInfo::Create(base.getType(), m_astContext);
-        classInfo->baseClasses.push_back(std::move(baseInfo));
-    }
+void AstReflector::ReflectClassMethods(
+  const CXXRecordDecl* decl
+  , ClassInfo* classInfo
+  , NamespacesTree* nsTree)
+{
+  DCHECK(decl);
+  DCHECK(classInfo);
+  DCHECK(decl->hasDefinition());
 
-    for (auto& d : decl->decls())
-    {
-        const clang::TagDecl* tagDecl = llvm::dyn_cast_or_null<TagDecl>(d);
-        const clang::NamedDecl* namedDecl = llvm::dyn_cast_or_null<NamedDecl>(d);
-
-        ClassInfo::InnerDeclInfo declInfo;
-        const CXXRecordDecl* innerRec = nullptr;
-        const TypedefNameDecl* typeAliasDecl = nullptr;
-        const FieldDecl* fieldDecl = nullptr;
-        const VarDecl* varDecl = nullptr;
-        bool processed = true;
-        if (tagDecl && tagDecl->isEnum())
-        {
-            auto ei = ReflectEnum(llvm::dyn_cast<EnumDecl>(tagDecl), nullptr);
-            declInfo.innerDecl = ei;
-        }
-        else if ((innerRec = llvm::dyn_cast_or_null<CXXRecordDecl>(tagDecl)))
-        {
-            if(recursive) {
-              auto ci = ReflectClass(innerRec, nullptr);
-              declInfo.innerDecl = ci;
-            }
-        }
-        else if ((typeAliasDecl = llvm::dyn_cast_or_null<TypedefNameDecl>(namedDecl)))
-        {
-            auto ti = ReflectTypedef(typeAliasDecl, nullptr);
-            declInfo.innerDecl = ti;
-        }
-        else if ((fieldDecl = llvm::dyn_cast_or_null<FieldDecl>(d)))
-        {
-            if (fieldDecl->isAnonymousStructOrUnion())
-                continue;
-
-            auto memberInfo = std::make_shared<MemberInfo>();
-            SetupNamedDeclInfo(fieldDecl, memberInfo.get(), m_astContext);
-            memberInfo->type = TypeInfo::Create(fieldDecl->getType(), m_astContext);
-            memberInfo->accessType = ConvertAccessType(fieldDecl->getAccess());
-            memberInfo->decl = fieldDecl;
-            classInfo->members.push_back(memberInfo);
-            processed = false;
-        }
-        else if ((varDecl = llvm::dyn_cast_or_null<VarDecl>(d)))
-        {
-            auto memberInfo = std::make_shared<MemberInfo>();
-            SetupNamedDeclInfo(varDecl, memberInfo.get(), m_astContext);
-            memberInfo->type = TypeInfo::Create(varDecl->getType(), m_astContext);
-            memberInfo->isStatic = varDecl->isStaticDataMember();
-            memberInfo->accessType = ConvertAccessType(varDecl->getAccess());
-            memberInfo->decl = varDecl;
-            classInfo->members.push_back(memberInfo);
-            processed = false;
-        }
-        else
-        {
-            processed = false;
-        }
+  ReflectImplicitSpecialMembers(decl, classInfo, nsTree);
 
-        if (processed)
-        {
-            declInfo.acessType = ConvertAccessType(tagDecl ? tagDecl->getAccess() : namedDecl->getAccess());
-            classInfo->innerDecls.push_back(std::move(declInfo));
-        }
-    }
+  for (auto methodDecl : decl->methods())
+  {
+      MethodInfoPtr methodInfo = ReflectMethod(methodDecl, nsTree);
+      classInfo->methods.push_back(methodInfo);
   }
+}
 
-  if (ns) {
-    ns->classes.push_back(classInfo);
+void AstReflector::ReflectClassBases(
+  const CXXRecordDecl* decl
+  , ClassInfo* classInfo)
+{
+  DCHECK(decl);
+  DCHECK(classInfo);
+  DCHECK(decl->hasDefinition());
+
+  for (auto& base : decl->bases())
+  {
+      ClassInfo::BaseInfo baseInfo;
+      baseInfo.isVirtual = base.isVirtual();
+      baseInfo.accessType = ConvertAccessType(base.getAccessSpecifier());
+      baseInfo.baseClass = TypeInfo::Create(base.getType(), m_astContext);
+      classInfo->baseClasses.push_back(std::move(baseInfo));
   }
+}
 
-  return classInfo;
+void AstReflector::ReflectClassDecls(
+  const CXXRecordDecl* decl
+  , ClassInfo* classInfo
+  , bool recursive)
+{
+  DCHECK(decl);
+  DCHECK(classInfo);
+  DCHECK(decl->hasDefinition());
+
+  for (auto& d : decl->decls())
+  {
+      const clang::TagDecl* tagDecl = llvm::dyn_cast_or_null<TagDecl>(d);
+      const clang::NamedDecl* namedDecl = llvm::dyn_cast_or_null<NamedDecl>(d);
+
+      ClassInfo::InnerDeclInfo declInfo;
+      const CXXRecordDecl* innerRec = nullptr;
+      const TypedefNameDecl* typeAliasDecl = nullptr;
+      const FieldDecl* fieldDecl = nullptr;
+      const VarDecl* varDecl = nullptr;
+      bool processed = true;
+      if (tagDecl && tagDecl->isEnum())
+      {
+          auto ei = ReflectEnum(llvm::dyn_cast<EnumDecl>(tagDecl), nullptr);
+          declInfo.innerDecl = ei;
+      }
+      else if ((innerRec = llvm::dyn_cast_or_null<CXXRecordDecl>(tagDecl)))
+      {
+          if(recursive) {
+            auto ci = ReflectClass(innerRec, nullptr);
+            declInfo.innerDecl = ci;
+          }
+      }
+      else if ((typeAliasDecl = llvm::dyn_cast_or_null<TypedefNameDecl>(namedDecl)))
+      {
+          auto ti = ReflectTypedef(typeAliasDecl, nullptr);
+          declInfo.innerDecl = ti;
+      }
+      else if ((fieldDecl = llvm::dyn_cast_or_null<FieldDecl>(d)))
+      {
+          if (fieldDecl->isAnonymousStructOrUnion())
+              continue;
+
+          auto memberInfo = MakeReflectionNode<MemberInfo>();
+          SetupNamedDeclInfo(fieldDecl, memberInfo.get(), m_astContext);
+          memberInfo->type = TypeInfo::Create(fieldDecl->getType(), m_astContext);
+          memberInfo->accessType = ConvertAccessType(fieldDecl->getAccess());
+          memberInfo->decl = fieldDecl;
+          classInfo->members.push_back(memberInfo);
+          processed = false;
+      }
+      else if ((varDecl = llvm::dyn_cast_or_null<VarDecl>(d)))
+      {
+          auto memberInfo = MakeReflectionNode<MemberInfo>();
+          SetupNamedDeclInfo(varDecl, memberInfo.get(), m_astContext);
+          memberInfo->type = TypeInfo::Create(varDecl->getType(), m_astContext);
+          memberInfo->isStatic = varDecl->isStaticDataMember();
+          memberInfo->accessType = ConvertAccessType(varDecl->getAccess());
+          memberInfo->decl = varDecl;
+          classInfo->members.push_back(memberInfo);
+          processed = false;
+      }
+      else
+      {
+          processed = false;
+      }
+
+      if (processed)
+      {
+          declInfo.acessType = ConvertAccessType(tagDecl ? tagDecl->getAccess() : namedDecl->getAccess());
+          classInfo->innerDecls.push_back(std::move(declInfo));
+      }
+  }
 }
 
 void AstReflector::ReflectImplicitSpecialMembers(
@@ -330,7 +456,7 @@ void AstReflector::ReflectImplicitSpecialMembers(
       (const std::string& name)
   {
       MethodInfoPtr methodInfo
-        = std::make_shared<MethodInfo>();
+        = MakeReflectionNode<MethodInfo>();
       methodInfo->scopeSpecifier
         = classInfo->GetFullQualifiedName();
       methodInfo->namespaceQualifier
@@ -456,7 +582,7 @@ MethodInfoPtr AstReflector::ReflectMethod(
     = llvm::dyn_cast_or_null<const clang::CXXMethodDecl>(decl);
 
   MethodInfoPtr methodInfo
-    = std::make_shared<MethodInfo>();
+    = MakeReflectionNode<MethodInfo>();
 
   const DeclContext* nsContext
     = decl->getEnclosingNamespaceContext();
@@ -661,21 +787,25 @@ void AstReflector::SetupNamedDeclInfo(
 
   info->scopeSpecifier = scopeQualifier;
 
+  // interned string is immutable, so build qualifier separately
+  std::string namespaceQualifier = info->namespaceQualifier.str();
   if (encNs != nullptr && !encNs->isTranslationUnit())
   {
     clang::PrintingPolicy policy(astContext->getLangOpts());
     SetupDefaultPrintingPolicy(policy);
 
-    llvm::raw_string_ostream os(info->namespaceQualifier);
+    llvm::raw_string_ostream os(namespaceQualifier);
     encNs->printQualifiedName(os, policy);
   }
 
   boost::algorithm::replace_all(
-    info->namespaceQualifier, "(anonymous)::", "");
+    namespaceQualifier, "(anonymous)::", "");
   boost::algorithm::replace_all(
-    info->namespaceQualifier, "::(anonymous)", "");
+    namespaceQualifier, "::(anonymous)", "");
   boost::algorithm::replace_all(
-    info->namespaceQualifier, "(anonymous)", "");
+    namespaceQualifier, "(anonymous)", "");
+
+  info->namespaceQualifier = namespaceQualifier;
 }
 
 } // reflection
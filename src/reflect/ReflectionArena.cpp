@@ -0,0 +1,98 @@
+#include "flexlib/reflect/ReflectionArena.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/lazy_instance.h>
+#include <base/threading/thread_local.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace reflection
+{
+
+namespace {
+
+base::LazyInstance<base::ThreadLocalPointer<ReflectionArena>>::Leaky
+  g_currentArena = LAZY_INSTANCE_INITIALIZER;
+
+} // namespace
+
+ReflectionArena::ScopedCurrent::ScopedCurrent(
+  ReflectionArena* arena)
+  : m_previous(g_currentArena.Get().Get())
+{
+  g_currentArena.Get().Set(arena);
+}
+
+ReflectionArena::ScopedCurrent::~ScopedCurrent()
+{
+  g_currentArena.Get().Set(m_previous);
+}
+
+ReflectionArena::ReflectionArena(size_t blockSize)
+  : m_blockSize(blockSize)
+{
+  DCHECK(m_blockSize > 0);
+}
+
+ReflectionArena::~ReflectionArena()
+{
+  DCHECK(Current() != this);
+
+  DVLOG(9)
+    << "reflection arena: destroying "
+    << m_destructors.size()
+    << " nodes in "
+    << m_allocatedBytes
+    << " bytes";
+
+  // nodes may refer to nodes created before them
+  for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); ++it) {
+    it->destroy(it->object);
+  }
+}
+
+// static
+ReflectionArena* ReflectionArena::Current()
+{
+  return g_currentArena.Get().Get();
+}
+
+void* ReflectionArena::Allocate(size_t size, size_t alignment)
+{
+  DCHECK(alignment > 0);
+
+  if (m_current)
+  {
+    const size_t padding
+      = (alignment - reinterpret_cast<uintptr_t>(m_current) % alignment)
+          % alignment;
+    if (padding + size <= static_cast<size_t>(m_end - m_current))
+    {
+      void* result = m_current + padding;
+      m_current += padding + size;
+      return result;
+    }
+  }
+
+  // large node gets own block, so block size is not wasted
+  const size_t blockSize
+    = std::max(m_blockSize, size + alignment);
+  m_blocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+  m_allocatedBytes += blockSize;
+
+  char* block = m_blocks.back().get();
+  const size_t padding
+    = (alignment - reinterpret_cast<uintptr_t>(block) % alignment)
+        % alignment;
+  void* result = block + padding;
+  if (blockSize == m_blockSize)
+  {
+    m_current = block + padding + size;
+    m_end = block + blockSize;
+  }
+  return result;
+}
+
+} // namespace reflection
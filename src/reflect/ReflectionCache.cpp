@@ -1 +1,191 @@
 ﻿#include "flexlib/reflect/ReflectionCache.hpp" // IWYU pragma: associated
+
+#include "flexlib/reflect/ReflectionArena.hpp"
+
+#include <clang/Index/USRGeneration.h>
+
+#include <llvm/ADT/SmallString.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+
+namespace reflection
+{
+
+ReflectionCache::ReflectionCache(Lifetime lifetime)
+  : lifetime_(lifetime)
+{}
+
+ReflectionCache::~ReflectionCache()
+{
+  DVLOG(9)
+    << "reflection cache: hits "
+    << stats_.hits
+    << ", misses "
+    << stats_.misses;
+}
+
+// static
+std::string ReflectionCache::GetUSR(const clang::Decl* decl)
+{
+  DCHECK(decl);
+
+  llvm::SmallString<128> usr;
+  /// \note |generateUSRForDecl| returns |true| on failure
+  if (clang::index::generateUSRForDecl(decl, usr)) {
+    return std::string();
+  }
+  return usr.str().str();
+}
+
+// static
+std::string ReflectionCache::GetClassKey(
+  const std::string& usr
+  , bool recursive)
+{
+  return recursive ? usr : usr + "#shallow";
+}
+
+uint64_t ReflectionCache::GetTranslationUnitIdLocked(
+  const clang::ASTContext* astContext)
+{
+  lock_.AssertAcquired();
+  uint64_t& id = translationUnitIds_[astContext];
+  if (id == 0) {
+    id = ++lastTranslationUnitId_;
+  }
+  return id;
+}
+
+ClassInfoPtr ReflectionCache::LookupClass(
+  const std::string& usr
+  , const clang::ASTContext* astContext
+  , bool recursive)
+{
+  DCHECK(!usr.empty());
+  DCHECK(astContext);
+
+  base::AutoLock lock(lock_);
+  const uint64_t translationUnitId = GetTranslationUnitIdLocked(astContext);
+  auto it = classes_.find(GetClassKey(usr, recursive));
+  if (it == classes_.end()
+      || it->second.translationUnitId != translationUnitId)
+  {
+    stats_.misses++;
+    return ClassInfoPtr();
+  }
+  stats_.hits++;
+  return it->second.info;
+}
+
+EnumInfoPtr ReflectionCache::LookupEnum(
+  const std::string& usr
+  , const clang::ASTContext* astContext)
+{
+  DCHECK(!usr.empty());
+  DCHECK(astContext);
+
+  base::AutoLock lock(lock_);
+  const uint64_t translationUnitId = GetTranslationUnitIdLocked(astContext);
+  auto it = enums_.find(usr);
+  if (it == enums_.end()
+      || it->second.translationUnitId != translationUnitId)
+  {
+    stats_.misses++;
+    return EnumInfoPtr();
+  }
+  stats_.hits++;
+  return it->second.info;
+}
+
+ClassInfoPtr ReflectionCache::StoreClass(
+  const std::string& usr
+  , const clang::ASTContext* astContext
+  , bool recursive
+  , ClassInfoPtr classInfo)
+{
+  DCHECK(!usr.empty());
+  DCHECK(astContext);
+  DCHECK(classInfo);
+  // node would outlive arena it was allocated in
+  DCHECK(lifetime_ != Lifetime::kRun || !ReflectionArena::Current());
+
+  base::AutoLock lock(lock_);
+  const uint64_t translationUnitId = GetTranslationUnitIdLocked(astContext);
+  Entry<ClassInfoPtr>& entry = classes_[GetClassKey(usr, recursive)];
+  // keep entry stored by other thread for same translation unit,
+  // replace entry built for other translation unit
+  if (entry.info && entry.translationUnitId == translationUnitId) {
+    return entry.info;
+  }
+  entry.info = std::move(classInfo);
+  entry.translationUnitId = translationUnitId;
+  return entry.info;
+}
+
+EnumInfoPtr ReflectionCache::StoreEnum(
+  const std::string& usr
+  , const clang::ASTContext* astContext
+  , EnumInfoPtr enumInfo)
+{
+  DCHECK(!usr.empty());
+  DCHECK(astContext);
+  DCHECK(enumInfo);
+  DCHECK(lifetime_ != Lifetime::kRun || !ReflectionArena::Current());
+
+  base::AutoLock lock(lock_);
+  const uint64_t translationUnitId = GetTranslationUnitIdLocked(astContext);
+  Entry<EnumInfoPtr>& entry = enums_[usr];
+  if (entry.info && entry.translationUnitId == translationUnitId) {
+    return entry.info;
+  }
+  entry.info = std::move(enumInfo);
+  entry.translationUnitId = translationUnitId;
+  return entry.info;
+}
+
+ClassInfoPtr ReflectionCache::FindClass(const std::string& usr) const
+{
+  base::AutoLock lock(lock_);
+  auto it = classes_.find(GetClassKey(usr, true));
+  if (it == classes_.end()) {
+    it = classes_.find(GetClassKey(usr, false));
+  }
+  return it == classes_.end()
+    ? ClassInfoPtr()
+    : it->second.info;
+}
+
+EnumInfoPtr ReflectionCache::FindEnum(const std::string& usr) const
+{
+  base::AutoLock lock(lock_);
+  auto it = enums_.find(usr);
+  return it == enums_.end()
+    ? EnumInfoPtr()
+    : it->second.info;
+}
+
+void ReflectionCache::EndTranslationUnit(
+  const clang::ASTContext* astContext)
+{
+  DCHECK(astContext);
+
+  base::AutoLock lock(lock_);
+  // |astContext| may be reused by next translation unit
+  translationUnitIds_.erase(astContext);
+
+  if (lifetime_ != Lifetime::kTranslationUnit) {
+    return;
+  }
+
+  classes_.clear();
+  enums_.clear();
+}
+
+size_t ReflectionCache::GetSize() const
+{
+  base::AutoLock lock(lock_);
+  return classes_.size() + enums_.size();
+}
+
+} // namespace reflection
@@ -0,0 +1,81 @@
+#include "flexlib/reflect/StringInterner.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/lazy_instance.h>
+#include <base/strings/string_util.h>
+
+namespace reflection
+{
+
+namespace {
+
+base::LazyInstance<StringInterner>::Leaky
+  g_defaultInterner = LAZY_INSTANCE_INITIALIZER;
+
+} // namespace
+
+StringInterner::StringInterner()
+{}
+
+StringInterner::~StringInterner()
+{
+  DVLOG(9)
+    << "string interner: "
+    << GetSize()
+    << " strings in "
+    << GetBytes()
+    << " bytes";
+}
+
+const std::string* StringInterner::Intern(const std::string& str)
+{
+  if (str.empty()) {
+    return nullptr;
+  }
+
+  // high bits, low bits select bucket of set in shard
+  const size_t hash = std::hash<std::string>()(str);
+  Shard& shard
+    = m_shards[(hash >> (sizeof(size_t) * 8 - 8)) % kNumShards];
+
+  base::AutoLock lock(shard.lock);
+  auto result = shard.strings.insert(str);
+  if (result.second) {
+    shard.bytes += str.size();
+  }
+  return &(*result.first);
+}
+
+// static
+StringInterner* StringInterner::GetDefault()
+{
+  return g_defaultInterner.Pointer();
+}
+
+size_t StringInterner::GetSize() const
+{
+  size_t result = 0;
+  for (const Shard& shard : m_shards) {
+    base::AutoLock lock(shard.lock);
+    result += shard.strings.size();
+  }
+  return result;
+}
+
+size_t StringInterner::GetBytes() const
+{
+  size_t result = 0;
+  for (const Shard& shard : m_shards) {
+    base::AutoLock lock(shard.lock);
+    result += shard.bytes;
+  }
+  return result;
+}
+
+const std::string& InternedString::str() const
+{
+  return m_str ? *m_str : base::EmptyString();
+}
+
+} // namespace reflection
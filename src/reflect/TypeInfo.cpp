@@ -2,6 +2,7 @@
 
 #include "flexlib/reflect/ast_utils.hpp"
 #include "flexlib/reflect/ReflectAST.hpp"
+#include "flexlib/reflect/ReflectionArena.hpp"
 #include "flexlib/reflect/ast_utils.hpp"
 
 #include <clang/AST/TypeVisitor.h>
@@ -581,14 +582,14 @@ private:
 
     m_targetType->m_scopedName
       = declInfo.scopeSpecifier.empty()
-        ? declInfo.name
+        ? declInfo.name.str()
         : declInfo.scopeSpecifier
           + "::"
           + declInfo.name;
 
     m_targetType->m_fullQualifiedName
       = declInfo.namespaceQualifier.empty()
-        ? m_targetType->m_scopedName
+        ? m_targetType->m_scopedName.str()
         : declInfo.namespaceQualifier
           + "::"
           + m_targetType->m_scopedName;
@@ -643,7 +644,7 @@ TypeInfoPtr TypeInfo::Create(
   DVLOG(11)
     << "TypeInfo::Create for QualType...";
 
-  TypeInfoPtr result = std::make_shared<TypeInfo>();
+  TypeInfoPtr result = MakeReflectionNode<TypeInfo>();
 
   result->m_printedName = EntityToString(&qt, astContext);
   result->m_typeDecl = qt.getTypePtr();
@@ -669,7 +670,7 @@ TypeInfoPtr TypeInfo::Create(
   DVLOG(11)
     << "TypeInfo::Create for TypeDescr...";
 
-  TypeInfoPtr result = std::make_shared<TypeInfo>();
+  TypeInfoPtr result = MakeReflectionNode<TypeInfo>();
 
   result->m_type = descr.type;
   result->m_declaredName = descr.name;
@@ -681,7 +682,7 @@ TypeInfoPtr TypeInfo::Create(
 
   result->m_fullQualifiedName
     = descr.namespaceQual.empty()
-      ? result->m_scopedName
+      ? result->m_scopedName.str()
       : descr.namespaceQual + "::" + result->m_scopedName;
 
   result->m_isConst = descr.isConst;
@@ -0,0 +1,226 @@
+#include "flexlib/replacement_collector.hpp" // IWYU pragma: associated
+
+#include "flexlib/annotation_result_cache.hpp"
+
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
+
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/lazy_instance.h>
+#include <base/threading/thread_local.h>
+
+namespace clang_utils {
+
+namespace {
+
+base::LazyInstance<base::ThreadLocalPointer<ReplacementCollector>>::Leaky
+  g_currentCollector = LAZY_INSTANCE_INITIALIZER;
+
+} // namespace
+
+ReplacementCollector::ScopedCurrent::ScopedCurrent(
+  ReplacementCollector* collector)
+  : previous_(g_currentCollector.Get().Get())
+{
+  DCHECK(collector);
+  g_currentCollector.Get().Set(collector);
+}
+
+ReplacementCollector::ScopedCurrent::~ScopedCurrent()
+{
+  g_currentCollector.Get().Set(previous_);
+}
+
+ReplacementCollector::ReplacementCollector(
+  clang::Rewriter* rewriter)
+  : rewriter_(rewriter)
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  DCHECK(rewriter_);
+}
+
+ReplacementCollector::~ReplacementCollector()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  DLOG_IF(WARNING, size() > 0)
+    << "discarded "
+    << size()
+    << " replacements that were not applied";
+}
+
+// static
+ReplacementCollector* ReplacementCollector::current()
+{
+  return g_currentCollector.Get().Get();
+}
+
+llvm::Error ReplacementCollector::add(
+  const clang::tooling::Replacement& replacement)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  return addToFile(replacement, clang::FileID());
+}
+
+llvm::Error ReplacementCollector::add(
+  const clang::SourceRange& range
+  , llvm::StringRef replacementText)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  const clang::SourceManager& SM = rewriter_->getSourceMgr();
+
+  clang::tooling::Replacement replacement(
+    SM
+    // same as |clang::Rewriter::ReplaceText(SourceRange, StringRef)|
+    , clang::CharSourceRange::getTokenRange(range)
+    , replacementText
+    , rewriter_->getLangOpts());
+
+  return addToFile(
+    replacement
+    , SM.getFileID(SM.getExpansionLoc(range.getBegin())));
+}
+
+llvm::Error ReplacementCollector::addToFile(
+  const clang::tooling::Replacement& replacement
+  , clang::FileID fileID)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  if(!replacement.isApplicable()) {
+    numConflicts_++;
+    return llvm::make_error<llvm::StringError>(
+      "replacement has invalid location: " + replacement.toString()
+      , llvm::inconvertibleErrorCode());
+  }
+
+  const std::string filePath = replacement.getFilePath().str();
+  rememberContentHash(filePath, fileID);
+
+  llvm::Error error = fileReplacements_[filePath].add(replacement);
+  if(error) {
+    numConflicts_++;
+  }
+  return error;
+}
+
+void ReplacementCollector::rememberContentHash(
+  const std::string& filePath
+  , clang::FileID fileID)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  if(fileContentHashes_.find(filePath) != fileContentHashes_.end()) {
+    return;
+  }
+
+  const clang::SourceManager& SM = rewriter_->getSourceMgr();
+
+  const clang::FileEntry* fileEntry = nullptr;
+  if(fileID.isInvalid()) {
+    fileEntry = SM.getFileManager().getFile(filePath);
+    if(!fileEntry) {
+      DVLOG(9)
+        << "unable to hash unknown file "
+        << filePath;
+      return;
+    }
+    fileID = SM.translateFile(fileEntry);
+  }
+
+  if(fileID.isValid()) {
+    bool invalidBuffer = false;
+    const llvm::StringRef buffer
+      = SM.getBufferData(fileID, &invalidBuffer);
+    if(!invalidBuffer) {
+      fileContentHashes_[filePath]
+        = computeContentHash(
+            base::StringPiece(buffer.data(), buffer.size()));
+    }
+    return;
+  }
+
+  // file is not part of translation unit
+  DCHECK(fileEntry);
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> fileBuffer
+    = SM.getFileManager().getBufferForFile(fileEntry);
+  if(fileBuffer) {
+    const llvm::StringRef buffer = (*fileBuffer)->getBuffer();
+    fileContentHashes_[filePath]
+      = computeContentHash(
+          base::StringPiece(buffer.data(), buffer.size()));
+  }
+}
+
+bool ReplacementCollector::applyAll()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  bool isApplied = true;
+  for(const auto& it: fileReplacements_) {
+    DVLOG(9)
+      << "applying "
+      << it.second.size()
+      << " replacements to "
+      << it.first;
+    if(!clang::tooling::applyAllReplacements(it.second, *rewriter_)) {
+      LOG(ERROR)
+        << "unable to apply replacements to "
+        << it.first;
+      isApplied = false;
+    }
+  }
+  fileReplacements_.clear();
+  return isApplied;
+}
+
+void ReplacementCollector::clear()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  fileReplacements_.clear();
+  fileContentHashes_.clear();
+  numConflicts_ = 0;
+}
+
+size_t ReplacementCollector::size() const
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  size_t result = 0;
+  for(const auto& it: fileReplacements_) {
+    result += it.second.size();
+  }
+  return result;
+}
+
+bool replaceText(
+  clang::Rewriter& rewriter
+  , const clang::SourceRange& range
+  , llvm::StringRef replacementText)
+{
+  ReplacementCollector* collector = ReplacementCollector::current();
+  if(!collector || collector->rewriter() != &rewriter) {
+    /// \note |ReplaceText| returns |true| on failure
+    return !rewriter.ReplaceText(range, replacementText);
+  }
+
+  llvm::Error error = collector->add(range, replacementText);
+  if(error) {
+    LOG(ERROR)
+      << "conflicting replacement at "
+      << range.getBegin().printToString(rewriter.getSourceMgr())
+      << ": "
+      << llvm::toString(std::move(error));
+    return false;
+  }
+  return true;
+}
+
+} // namespace clang_utils
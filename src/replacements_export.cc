@@ -0,0 +1,190 @@
+#include "flexlib/replacements_export.hpp" // IWYU pragma: associated
+
+#include "flexlib/annotation_result_cache.hpp"
+#include "flexlib/output_sink.hpp"
+#include "flexlib/replacement_collector.hpp"
+
+#include <clang/Tooling/ReplacementsYaml.h>
+
+#include <llvm/Support/YAMLTraits.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/pickle.h>
+#include <base/files/file_util.h>
+
+namespace clang_utils {
+
+namespace {
+
+// change it if format of edit list changes
+const int kEditsFormatVersion = 1;
+
+} // namespace
+
+FileEditsList collectFileEdits(const ReplacementCollector& collector)
+{
+  FileEditsList result;
+  result.reserve(collector.fileReplacements().size());
+  for(const auto& it: collector.fileReplacements()) {
+    FileEdits fileEdits;
+    fileEdits.path = it.first;
+    auto hashIt = collector.fileContentHashes().find(it.first);
+    if(hashIt != collector.fileContentHashes().end()) {
+      fileEdits.contentHash = hashIt->second;
+    }
+    fileEdits.replacements = it.second;
+    result.push_back(std::move(fileEdits));
+  }
+  return result;
+}
+
+std::string serializeFileEditsYaml(
+  const std::string& mainSourceFile
+  , const FileEditsList& fileEdits)
+{
+  clang::tooling::TranslationUnitReplacements translationUnit;
+  translationUnit.MainSourceFile = mainSourceFile;
+  for(const FileEdits& it: fileEdits) {
+    translationUnit.Replacements.insert(
+      translationUnit.Replacements.end()
+      , it.replacements.begin()
+      , it.replacements.end());
+  }
+
+  std::string result;
+  llvm::raw_string_ostream stream(result);
+  llvm::yaml::Output yaml(stream);
+  yaml << translationUnit;
+  stream.flush();
+  return result;
+}
+
+std::string serializeFileEdits(const FileEditsList& fileEdits)
+{
+  base::Pickle pickle;
+  pickle.WriteInt(kEditsFormatVersion);
+  pickle.WriteInt(static_cast<int>(fileEdits.size()));
+  for(const FileEdits& it: fileEdits) {
+    pickle.WriteString(it.path);
+    pickle.WriteString(it.contentHash);
+    pickle.WriteInt(static_cast<int>(it.replacements.size()));
+    for(const clang::tooling::Replacement& replacement: it.replacements) {
+      pickle.WriteUInt32(replacement.getOffset());
+      pickle.WriteUInt32(replacement.getLength());
+      pickle.WriteString(replacement.getReplacementText().str());
+    }
+  }
+  return std::string(
+    static_cast<const char*>(pickle.data()), pickle.size());
+}
+
+bool deserializeFileEdits(
+  base::StringPiece data
+  , FileEditsList* result)
+{
+  DCHECK(result);
+
+  base::Pickle pickle(data.data(), data.size());
+  base::PickleIterator iter(pickle);
+
+  int formatVersion = 0;
+  int numFiles = 0;
+  if(!iter.ReadInt(&formatVersion)
+     || formatVersion != kEditsFormatVersion
+     || !iter.ReadInt(&numFiles)
+     || numFiles < 0)
+  {
+    return false;
+  }
+
+  FileEditsList fileEditsList;
+  for(int i = 0; i < numFiles; ++i) {
+    FileEdits fileEdits;
+    int numReplacements = 0;
+    if(!iter.ReadString(&fileEdits.path)
+       || !iter.ReadString(&fileEdits.contentHash)
+       || !iter.ReadInt(&numReplacements)
+       || numReplacements < 0)
+    {
+      return false;
+    }
+    for(int j = 0; j < numReplacements; ++j) {
+      uint32_t offset = 0;
+      uint32_t length = 0;
+      std::string text;
+      if(!iter.ReadUInt32(&offset)
+         || !iter.ReadUInt32(&length)
+         || !iter.ReadString(&text))
+      {
+        return false;
+      }
+      llvm::Error error = fileEdits.replacements.add(
+        clang::tooling::Replacement(fileEdits.path, offset, length, text));
+      if(error) {
+        LOG(WARNING)
+          << "invalid replacement in edit list: "
+          << llvm::toString(std::move(error));
+        return false;
+      }
+    }
+    fileEditsList.push_back(std::move(fileEdits));
+  }
+
+  *result = std::move(fileEditsList);
+  return true;
+}
+
+bool applyFileEdits(
+  const FileEditsList& fileEdits
+  , flexlib::OutputSink* outputSink)
+{
+  DCHECK(outputSink);
+
+  bool isApplied = true;
+  for(const FileEdits& it: fileEdits) {
+    const base::FilePath filePath
+      = base::FilePath::FromUTF8Unsafe(it.path);
+
+    std::string contents;
+    if(!base::ReadFileToString(filePath, &contents)) {
+      LOG(ERROR)
+        << "unable to read file for edits: "
+        << it.path;
+      isApplied = false;
+      continue;
+    }
+
+    if(!it.contentHash.empty()
+       && computeContentHash(contents) != it.contentHash)
+    {
+      LOG(ERROR)
+        << "skipped edits made for other version of file: "
+        << it.path;
+      isApplied = false;
+      continue;
+    }
+
+    llvm::Expected<std::string> editedContents
+      = clang::tooling::applyAllReplacements(contents, it.replacements);
+    if(!editedContents) {
+      LOG(ERROR)
+        << "unable to apply edits to "
+        << it.path
+        << ": "
+        << llvm::toString(editedContents.takeError());
+      isApplied = false;
+      continue;
+    }
+
+    if(outputSink->writeIfChanged(filePath, *editedContents)
+       == flexlib::OutputSink::WriteResult::kFailed)
+    {
+      isApplied = false;
+    }
+  }
+  return isApplied;
+}
+
+} // namespace clang_utils
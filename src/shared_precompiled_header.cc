@@ -0,0 +1,621 @@
+#include "flexlib/shared_precompiled_header.hpp" // IWYU pragma: associated
+
+#include "flexlib/annotation_result_cache.hpp"
+
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <llvm/Support/VirtualFileSystem.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/pickle.h>
+#include <base/files/file.h>
+#include <base/files/file_util.h>
+#include <base/files/important_file_writer.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_piece.h>
+#include <base/strings/string_util.h>
+
+#include <algorithm>
+
+namespace clang_utils {
+
+namespace {
+
+// change it if format of stamp file changes
+const int kStampFormatVersion = 1;
+
+const char kPchExtension[] = ".pch";
+
+const char kStampExtension[] = ".stamp";
+
+struct PchDependency {
+  std::string path;
+
+  // see |computeContentHash|
+  std::string contentHash;
+};
+
+int64_t toStampTime(const base::Time& time)
+{
+  return time.ToDeltaSinceWindowsEpoch().InMicroseconds();
+}
+
+// flags that change contents of precompiled header,
+// value may be separate (`-I dir`) or joined (`-Idir`)
+const char* const kPchFlagsWithValue[] = {
+  // language
+  "-x"
+  // target
+  , "-target"
+  , "-arch"
+  // defines
+  , "-D"
+  , "-U"
+  // include paths
+  , "-I"
+  , "-isystem"
+  , "-iquote"
+  , "-idirafter"
+  , "-isysroot"
+  , "-iframework"
+  , "-F"
+  , "--sysroot"
+};
+
+// flags that change contents of precompiled header,
+// value is joined by '='
+const char* const kPchFlagsWithEqualValue[] = {
+  "-std="
+  , "--std="
+  , "--target="
+  , "--sysroot="
+  , "-stdlib="
+};
+
+// flags without value that change contents of precompiled header
+const char* const kPchFlagsWithoutValue[] = {
+  "-m32"
+  , "-m64"
+  , "-nostdinc"
+  , "-nostdinc++"
+  , "-nostdlibinc"
+};
+
+// Returns flags of |args| that must be same for translation unit
+// and precompiled header (language, target, defines, include paths
+// and language standard), so other flags
+// (warnings, optimization, output and dependency files)
+// do not prevent use of precompiled header.
+// Flags with value are joined with value (`-I dir` becomes `-Idir`).
+std::vector<std::string> getPchArgs(
+  clang::tooling::CommandLineArguments::const_iterator begin
+  , clang::tooling::CommandLineArguments::const_iterator end)
+{
+  std::vector<std::string> result;
+  for(auto it = begin; it != end; ++it) {
+    const llvm::StringRef arg = *it;
+
+    bool isPchFlag = false;
+    for(const char* flag: kPchFlagsWithoutValue) {
+      if(arg == flag) {
+        result.push_back(arg.str());
+        isPchFlag = true;
+        break;
+      }
+    }
+    for(const char* flag: kPchFlagsWithEqualValue) {
+      if(!isPchFlag && arg.startswith(flag)) {
+        // `--std=c++17` is same as `-std=c++17`
+        result.push_back(
+          arg.startswith("--std=") ? arg.drop_front(1).str() : arg.str());
+        isPchFlag = true;
+      }
+    }
+    for(const char* flag: kPchFlagsWithValue) {
+      if(isPchFlag || !arg.startswith(flag)) {
+        continue;
+      }
+      isPchFlag = true;
+      if(arg.size() > llvm::StringRef(flag).size()) {
+        result.push_back(arg.str());
+      } else if(it + 1 != end) {
+        ++it;
+        result.push_back(arg.str() + *it);
+      }
+    }
+  }
+  return result;
+}
+
+// Returns targets of `#include` (and `#import`) directives
+// at start of |contents|, like `<base/logging.h>` or `"common.hpp"`.
+// Stops at first line that is not include, comment, blank
+// or `#pragma once`.
+/// \note includes are compared as spelled,
+/// macros and line continuations are not expanded
+std::vector<std::string> getLeadingIncludes(base::StringPiece contents)
+{
+  std::vector<std::string> result;
+  bool isInBlockComment = false;
+  while(!contents.empty()) {
+    const size_t lineEnd = contents.find('\n');
+    base::StringPiece line = contents.substr(0, lineEnd);
+    contents
+      = lineEnd == base::StringPiece::npos
+        ? base::StringPiece()
+        : contents.substr(lineEnd + 1);
+
+    for(;;) {
+      if(isInBlockComment) {
+        const size_t commentEnd = line.find("*/");
+        if(commentEnd == base::StringPiece::npos) {
+          line = base::StringPiece();
+          break;
+        }
+        line = line.substr(commentEnd + 2);
+        isInBlockComment = false;
+      }
+      line = base::TrimWhitespaceASCII(line, base::TRIM_ALL);
+      if(!line.starts_with("/*")) {
+        break;
+      }
+      line = line.substr(2);
+      isInBlockComment = true;
+    }
+
+    if(line.empty() || line.starts_with("//")) {
+      continue;
+    }
+
+    if(!line.starts_with("#")) {
+      break;
+    }
+    line = base::TrimWhitespaceASCII(line.substr(1), base::TRIM_LEADING);
+
+    if(line.starts_with("pragma")
+       && base::TrimWhitespaceASCII(
+            line.substr(6), base::TRIM_ALL) == "once")
+    {
+      continue;
+    }
+
+    base::StringPiece target;
+    if(line.starts_with("include")) {
+      target = line.substr(7);
+    } else if(line.starts_with("import")) {
+      target = line.substr(6);
+    } else {
+      break;
+    }
+    target = base::TrimWhitespaceASCII(target, base::TRIM_LEADING);
+
+    const char closing
+      = target.starts_with("<")
+        ? '>'
+        : target.starts_with("\"") ? '"' : '\0';
+    const size_t targetEnd
+      = closing ? target.find(closing, 1) : base::StringPiece::npos;
+    if(targetEnd == base::StringPiece::npos) {
+      // computed include (`#include MACRO`)
+      break;
+    }
+    result.push_back(target.substr(0, targetEnd + 1).as_string());
+  }
+  return result;
+}
+
+// Returns |true| if file starts with all |prefixIncludes|
+// (in same order), so precompiled header parsed before file
+// is same as includes of file.
+bool startsWithIncludes(
+  const base::FilePath& filePath
+  , const std::vector<std::string>& prefixIncludes)
+{
+  std::string contents;
+  if(!base::ReadFileToString(filePath, &contents)) {
+    return false;
+  }
+  const std::vector<std::string> includes = getLeadingIncludes(contents);
+  return includes.size() >= prefixIncludes.size()
+    && std::equal(
+         prefixIncludes.begin(), prefixIncludes.end(), includes.begin());
+}
+
+// Remembers headers read while building precompiled header.
+class RecordingGeneratePCHAction
+  : public clang::GeneratePCHAction
+{
+public:
+  explicit RecordingGeneratePCHAction(
+    std::vector<PchDependency>* dependencies)
+    : dependencies_(dependencies)
+  {
+    DCHECK(dependencies_);
+  }
+
+  void EndSourceFileAction() override
+  {
+    clang::SourceManager& SM = getCompilerInstance().getSourceManager();
+
+    dependencies_->clear();
+    for(auto it = SM.fileinfo_begin(); it != SM.fileinfo_end(); ++it) {
+      const clang::FileEntry* fileEntry = it->first;
+      const llvm::MemoryBuffer* buffer = it->second->getRawBuffer();
+      if(!fileEntry || !buffer) {
+        // file was not read
+        continue;
+      }
+
+      const llvm::StringRef realPath = fileEntry->tryGetRealPathName();
+
+      PchDependency dependency;
+      dependency.path
+        = realPath.empty()
+          ? fileEntry->getName().str()
+          : realPath.str();
+      dependency.contentHash
+        = computeContentHash(
+            base::StringPiece(
+              buffer->getBufferStart(), buffer->getBufferSize()));
+      dependencies_->push_back(std::move(dependency));
+    }
+
+    clang::GeneratePCHAction::EndSourceFileAction();
+  }
+
+private:
+  std::vector<PchDependency>* dependencies_;
+};
+
+class RecordingGeneratePCHFactory
+  : public clang::tooling::FrontendActionFactory
+{
+public:
+  explicit RecordingGeneratePCHFactory(
+    std::vector<PchDependency>* dependencies)
+    : dependencies_(dependencies)
+  {}
+
+  clang::FrontendAction* create() override
+  {
+    return new RecordingGeneratePCHAction(dependencies_);
+  }
+
+private:
+  std::vector<PchDependency>* dependencies_;
+};
+
+} // namespace
+
+SharedPrecompiledHeader::SharedPrecompiledHeader(Options&& options)
+  : options_(std::move(options))
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+
+  if(!options_.prebuiltPch.empty()) {
+    pchPath_ = options_.prebuiltPch;
+  } else {
+    DCHECK(!options_.prefixHeader.empty());
+    DCHECK(!options_.outputDir.empty());
+    pchPath_
+      = options_.outputDir.Append(
+          options_.prefixHeader.BaseName().AddExtensionASCII(kPchExtension));
+  }
+}
+
+SharedPrecompiledHeader::~SharedPrecompiledHeader()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+bool SharedPrecompiledHeader::prepare()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  isReady_ = false;
+
+  prefixIncludes_.clear();
+  if(!options_.prefixHeader.empty()) {
+    std::string prefixContents;
+    if(!base::ReadFileToString(options_.prefixHeader, &prefixContents)) {
+      LOG(ERROR)
+        << "unable to read prefix header: "
+        << options_.prefixHeader;
+      return false;
+    }
+    prefixIncludes_ = getLeadingIncludes(prefixContents);
+    if(prefixIncludes_.empty()) {
+      LOG(ERROR)
+        << "prefix header must start with includes: "
+        << options_.prefixHeader;
+      return false;
+    }
+  }
+
+  if(!options_.prebuiltPch.empty()) {
+    LOG_IF(WARNING, options_.compileArgs.empty())
+      << "flags of precompiled header are unknown,"
+         " it will be used only by translation units without flags: "
+      << pchPath_;
+
+    base::File::Info fileInfo;
+    if(!base::GetFileInfo(pchPath_, &fileInfo)) {
+      LOG(ERROR)
+        << "unable to find precompiled header: "
+        << pchPath_;
+      return false;
+    }
+    // we can not track headers of external precompiled header,
+    // so stamp changes only when precompiled header itself changes
+    stamp_
+      = computeContentHash(
+          pchPath_.AsUTF8Unsafe()
+          + base::NumberToString(toStampTime(fileInfo.last_modified))
+          + base::NumberToString(fileInfo.size));
+    isReady_ = true;
+    return true;
+  }
+
+  if(readValidStamp()) {
+    DVLOG(9)
+      << "reused precompiled header: "
+      << pchPath_;
+    isReady_ = true;
+    return true;
+  }
+
+  isReady_ = build();
+  return isReady_;
+}
+
+bool SharedPrecompiledHeader::isReady() const
+{
+  /// \note may be called on any thread after |prepare|
+  return isReady_;
+}
+
+const base::FilePath& SharedPrecompiledHeader::pchPath() const
+{
+  /// \note may be called on any thread after |prepare|
+  return pchPath_;
+}
+
+const std::string& SharedPrecompiledHeader::stamp() const
+{
+  /// \note may be called on any thread after |prepare|
+  return stamp_;
+}
+
+clang::tooling::ArgumentsAdjuster
+  SharedPrecompiledHeader::getArgumentsAdjuster() const
+{
+  /// \note may be called on any thread after |prepare|
+  DCHECK(isReady_);
+
+  // precompiled header is built from |Options::compileArgs|
+  // without compiler path and input file
+  const std::vector<std::string> pchArgs
+    = getPchArgs(options_.compileArgs.begin(), options_.compileArgs.end());
+
+  const std::string pchPath = pchPath_.AsUTF8Unsafe();
+
+  /// \note |SharedPrecompiledHeader| must outlive adjuster
+  return [this, pchArgs, pchPath](
+    const clang::tooling::CommandLineArguments& args
+    , llvm::StringRef filename)
+  {
+    // first argument is compiler path
+    const bool isSameArgs
+      = !args.empty()
+        && getPchArgs(args.begin() + 1, args.end()) == pchArgs;
+    if(!isSameArgs) {
+      DVLOG(9)
+        << "flags do not match flags of precompiled header,"
+           " parsing without it: "
+        << filename.str();
+      stats_.skipped++;
+      return args;
+    }
+
+    // precompiled header is parsed before first line of file
+    if(!prefixIncludes_.empty()
+       && !startsWithIncludes(
+            base::FilePath::FromUTF8Unsafe(filename.str())
+            , prefixIncludes_))
+    {
+      DVLOG(9)
+        << "file does not start with includes of prefix header,"
+           " parsing without precompiled header: "
+        << filename.str();
+      stats_.skipped++;
+      return args;
+    }
+
+    stats_.used++;
+    clang::tooling::CommandLineArguments result = args;
+    result.insert(result.begin() + 1, {"-include-pch", pchPath});
+    return result;
+  };
+}
+
+bool SharedPrecompiledHeader::readValidStamp()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  if(!base::PathExists(pchPath_)) {
+    return false;
+  }
+
+  std::string stampData;
+  if(!base::ReadFileToString(stampPath(), &stampData)) {
+    return false;
+  }
+
+  base::Pickle pickle(stampData.data(), stampData.size());
+  base::PickleIterator iter(pickle);
+
+  int formatVersion = 0;
+  std::string argsHash;
+  std::string stamp;
+  int numDependencies = 0;
+  if(!iter.ReadInt(&formatVersion)
+     || formatVersion != kStampFormatVersion
+     || !iter.ReadString(&argsHash)
+     || argsHash != computeArgsHash()
+     || !iter.ReadString(&stamp)
+     || !iter.ReadInt(&numDependencies)
+     || numDependencies <= 0)
+  {
+    return false;
+  }
+
+  for(int i = 0; i < numDependencies; ++i) {
+    std::string path;
+    int64_t lastModified = 0;
+    int64_t size = 0;
+    if(!iter.ReadString(&path)
+       || !iter.ReadInt64(&lastModified)
+       || !iter.ReadInt64(&size))
+    {
+      return false;
+    }
+
+    base::File::Info fileInfo;
+    if(!base::GetFileInfo(base::FilePath::FromUTF8Unsafe(path), &fileInfo)
+       || toStampTime(fileInfo.last_modified) != lastModified
+       || fileInfo.size != size)
+    {
+      DVLOG(9)
+        << "precompiled header outdated by file: "
+        << path;
+      return false;
+    }
+  }
+
+  stamp_ = std::move(stamp);
+
+  return true;
+}
+
+bool SharedPrecompiledHeader::build()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  base::File::Error error;
+  if(!base::CreateDirectoryAndGetError(options_.outputDir, &error)) {
+    LOG(ERROR)
+      << "unable to create directory for precompiled header: "
+      << options_.outputDir
+      << " error: "
+      << base::File::ErrorToString(error);
+    return false;
+  }
+
+  clang::tooling::FixedCompilationDatabase compilations(
+    options_.workingDir.empty()
+      ? "."
+      : options_.workingDir.AsUTF8Unsafe()
+    , options_.compileArgs);
+
+  // physical file system does not change working directory of process
+  clang::tooling::ClangTool tool(
+    compilations
+    , {options_.prefixHeader.AsUTF8Unsafe()}
+    , std::make_shared<clang::PCHContainerOperations>()
+    , llvm::vfs::createPhysicalFileSystem().release());
+
+  // default adjusters add `-fsyntax-only` and remove output
+  tool.clearArgumentsAdjusters();
+  tool.appendArgumentsAdjuster(
+    clang::tooling::getInsertArgumentAdjuster(
+      {"-x", "c++-header"}
+      , clang::tooling::ArgumentInsertPosition::BEGIN));
+  tool.appendArgumentsAdjuster(
+    clang::tooling::getInsertArgumentAdjuster(
+      {"-o", pchPath_.AsUTF8Unsafe()}
+      , clang::tooling::ArgumentInsertPosition::END));
+
+  std::vector<PchDependency> dependencies;
+  RecordingGeneratePCHFactory factory(&dependencies);
+  if(tool.run(&factory) != 0 || dependencies.empty()) {
+    LOG(ERROR)
+      << "unable to build precompiled header: "
+      << pchPath_;
+    return false;
+  }
+
+  const std::string argsHash = computeArgsHash();
+
+  std::string stampData = argsHash;
+  for(const PchDependency& dependency: dependencies) {
+    stampData += dependency.path;
+    stampData += dependency.contentHash;
+  }
+  stamp_ = computeContentHash(stampData);
+
+  base::Pickle pickle;
+  pickle.WriteInt(kStampFormatVersion);
+  pickle.WriteString(argsHash);
+  pickle.WriteString(stamp_);
+  pickle.WriteInt(static_cast<int>(dependencies.size()));
+  for(const PchDependency& dependency: dependencies) {
+    base::File::Info fileInfo;
+    if(!base::GetFileInfo(
+         base::FilePath::FromUTF8Unsafe(dependency.path), &fileInfo))
+    {
+      LOG(WARNING)
+        << "unable to track header of precompiled header: "
+        << dependency.path;
+      // precompiled header is usable, but will be rebuilt next time
+      return true;
+    }
+    pickle.WriteString(dependency.path);
+    pickle.WriteInt64(toStampTime(fileInfo.last_modified));
+    pickle.WriteInt64(fileInfo.size);
+  }
+
+  const bool isWritten
+    = base::ImportantFileWriter::WriteFileAtomically(
+        stampPath()
+        , base::StringPiece(
+            static_cast<const char*>(pickle.data()), pickle.size()));
+  if(!isWritten) {
+    LOG(WARNING)
+      << "unable to write stamp of precompiled header: "
+      << stampPath();
+  }
+
+  DVLOG(9)
+    << "built precompiled header: "
+    << pchPath_
+    << " from "
+    << dependencies.size()
+    << " files";
+
+  return true;
+}
+
+std::string SharedPrecompiledHeader::computeArgsHash() const
+{
+  std::string argsData = options_.prefixHeader.AsUTF8Unsafe();
+  argsData.push_back('\0');
+  argsData += options_.workingDir.AsUTF8Unsafe();
+  for(const std::string& arg: options_.compileArgs) {
+    argsData.push_back('\0');
+    argsData += arg;
+  }
+  return computeContentHash(argsData);
+}
+
+base::FilePath SharedPrecompiledHeader::stampPath() const
+{
+  return pchPath_.AddExtensionASCII(kStampExtension);
+}
+
+} // namespace clang_utils
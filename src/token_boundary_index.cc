@@ -0,0 +1,152 @@
+#include "flexlib/token_boundary_index.hpp" // IWYU pragma: associated
+
+#include <clang/Lex/Lexer.h>
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/lazy_instance.h>
+#include <base/threading/thread_local.h>
+
+#include <algorithm>
+
+namespace clang_utils {
+
+namespace {
+
+base::LazyInstance<base::ThreadLocalPointer<TokenBoundaryIndexCache>>::Leaky
+  g_currentTokenIndexCache = LAZY_INSTANCE_INITIALIZER;
+
+} // namespace
+
+TokenBoundaryIndex::TokenBoundaryIndex(
+  clang::SourceLocation fileStart
+  , llvm::StringRef buffer
+  , const clang::LangOptions& langOptions)
+  : bufferData_(buffer.data())
+  , bufferSize_(buffer.size())
+{
+  clang::Lexer lexer(
+    fileStart
+    , langOptions
+    , buffer.begin()
+    , buffer.begin()
+    , buffer.end());
+
+  // usually less than one token per 4 characters
+  tokens_.reserve(buffer.size() / 4);
+
+  auto addToken = [this, &fileStart](const clang::Token& token) {
+    // file locations are consecutive offsets from start of file
+    tokens_.push_back(Token{
+      token.getLocation().getRawEncoding() - fileStart.getRawEncoding()
+      , token.getLength()
+      , token.getKind()});
+  };
+
+  clang::Token token;
+  // returns |true| together with last token of buffer
+  bool isLastToken = false;
+  do {
+    isLastToken = lexer.LexFromRawLexer(token);
+    if(token.is(clang::tok::eof)) {
+      break;
+    }
+    addToken(token);
+  } while(!isLastToken);
+
+  DVLOG(9)
+    << "built token index with "
+    << tokens_.size()
+    << " tokens";
+}
+
+TokenBoundaryIndex::~TokenBoundaryIndex()
+{}
+
+const TokenBoundaryIndex::Token* TokenBoundaryIndex::findTokenAt(
+  unsigned offset) const
+{
+  const Token* token = findFirstTokenFrom(offset);
+  if(!token || token->offset != offset) {
+    return nullptr;
+  }
+  return token;
+}
+
+const TokenBoundaryIndex::Token* TokenBoundaryIndex::findFirstTokenFrom(
+  unsigned offset) const
+{
+  auto it = std::lower_bound(tokens_.begin(), tokens_.end(), offset
+    , [](const Token& token, unsigned offset) {
+        return token.offset < offset;
+      });
+  if(it == tokens_.end()) {
+    return nullptr;
+  }
+  return &(*it);
+}
+
+bool TokenBoundaryIndex::isBuiltFor(llvm::StringRef buffer) const
+{
+  return buffer.data() == bufferData_ && buffer.size() == bufferSize_;
+}
+
+TokenBoundaryIndexCache::ScopedCurrent::ScopedCurrent(
+  TokenBoundaryIndexCache* cache)
+  : previous_(g_currentTokenIndexCache.Get().Get())
+{
+  DCHECK(cache);
+  g_currentTokenIndexCache.Get().Set(cache);
+}
+
+TokenBoundaryIndexCache::ScopedCurrent::~ScopedCurrent()
+{
+  g_currentTokenIndexCache.Get().Set(previous_);
+}
+
+TokenBoundaryIndexCache::TokenBoundaryIndexCache(
+  const clang::SourceManager& sourceManager
+  , const clang::LangOptions& langOptions)
+  : sourceManager_(sourceManager)
+  , langOptions_(langOptions)
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+}
+
+TokenBoundaryIndexCache::~TokenBoundaryIndexCache()
+{
+  DCHECK(Current() != this);
+}
+
+// static
+TokenBoundaryIndexCache* TokenBoundaryIndexCache::Current()
+{
+  return g_currentTokenIndexCache.Get().Get();
+}
+
+const TokenBoundaryIndex* TokenBoundaryIndexCache::getOrBuild(
+  clang::FileID fileID)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  bool invalidBuffer = false;
+  const llvm::StringRef buffer
+    = sourceManager_.getBufferData(fileID, &invalidBuffer);
+  if(invalidBuffer) {
+    return nullptr;
+  }
+
+  std::unique_ptr<TokenBoundaryIndex>& index
+    = indexes_[fileID.getHashValue()];
+  // buffer of file may be overridden
+  if(!index || !index->isBuiltFor(buffer)) {
+    index.reset(
+      new TokenBoundaryIndex(
+        sourceManager_.getLocForStartOfFile(fileID)
+        , buffer
+        , langOptions_));
+  }
+  return index.get();
+}
+
+} // namespace clang_utils
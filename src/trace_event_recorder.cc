@@ -0,0 +1,107 @@
+#include "flexlib/trace_event_recorder.hpp" // IWYU pragma: associated
+
+#include <base/logging.h>
+#include <base/check.h>
+#include <base/bind.h>
+#include <base/memory/ref_counted_memory.h>
+#include <base/files/important_file_writer.h>
+#include <base/trace_event/trace_buffer.h>
+#include <base/trace_event/trace_config.h>
+#include <base/trace_event/trace_log.h>
+
+namespace flexlib {
+
+namespace {
+
+void onTraceDataCollected(
+  base::trace_event::TraceResultBuffer* traceBuffer
+  , const scoped_refptr<base::RefCountedString>& eventsJson
+  , bool hasMoreEvents)
+{
+  ignore_result(hasMoreEvents);
+
+  DCHECK(traceBuffer);
+  traceBuffer->AddFragment(eventsJson->data());
+}
+
+} // namespace
+
+TraceEventRecorder::TraceEventRecorder()
+{
+  DETACH_FROM_SEQUENCE(sequence_checker_);
+}
+
+TraceEventRecorder::~TraceEventRecorder()
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  if(isRecording()) {
+    // recorded events are discarded
+    base::trace_event::TraceLog::GetInstance()->SetDisabled();
+  }
+}
+
+void TraceEventRecorder::start(
+  const std::string& categoryFilter)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  DCHECK(!isRecording());
+
+  base::trace_event::TraceLog::GetInstance()->SetEnabled(
+    base::trace_event::TraceConfig(
+      categoryFilter, base::trace_event::RECORD_CONTINUOUSLY)
+    , base::trace_event::TraceLog::RECORDING_MODE);
+
+  DVLOG(9)
+    << "started tracing of categories: "
+    << categoryFilter;
+}
+
+bool TraceEventRecorder::stopAndWrite(
+  const base::FilePath& outputPath)
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  DCHECK(isRecording());
+
+  base::trace_event::TraceLog* traceLog
+    = base::trace_event::TraceLog::GetInstance();
+
+  traceLog->SetDisabled();
+
+  base::trace_event::TraceResultBuffer traceBuffer;
+  base::trace_event::TraceResultBuffer::SimpleOutput traceOutput;
+  traceBuffer.SetOutputCallback(traceOutput.GetCallback());
+  traceBuffer.Start();
+  /// \note flushes synchronously if called
+  /// on thread without message loop
+  traceLog->Flush(
+    base::BindRepeating(&onTraceDataCollected, &traceBuffer));
+  traceBuffer.Finish();
+
+  const bool isWritten
+    = base::ImportantFileWriter::WriteFileAtomically(
+        outputPath, traceOutput.json_output);
+  if(!isWritten) {
+    LOG(ERROR)
+      << "unable to write trace events to: "
+      << outputPath;
+    return false;
+  }
+
+  DVLOG(9)
+    << "written trace events to: "
+    << outputPath;
+
+  return true;
+}
+
+bool TraceEventRecorder::isRecording() const
+{
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+
+  return base::trace_event::TraceLog::GetInstance()->IsEnabled();
+}
+
+} // namespace flexlib
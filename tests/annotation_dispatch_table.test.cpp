@@ -0,0 +1,142 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/annotation_dispatch_table.hpp"
+#include "flexlib/annotation_parser.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flexlib {
+
+namespace {
+
+// callbacks are not called by table
+AnnotationMethods makeMethods(const std::vector<std::string>& names)
+{
+  AnnotationMethods result;
+  for(const std::string& name: names) {
+    result[name] = AnnotationMethodCallback();
+  }
+  return result;
+}
+
+// reference implementation: linear scan over all methods
+AnnotationMethods::const_iterator findLongestPrefixLinear(
+  const AnnotationMethods& methods
+  , std::string_view annotation)
+{
+  AnnotationMethods::const_iterator result = methods.end();
+  for(auto it = methods.begin(); it != methods.end(); ++it) {
+    if(annotation.substr(0, it->first.size()) == it->first
+       && (result == methods.end()
+           || it->first.size() > result->first.size()))
+    {
+      result = it;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(AnnotationDispatchTableTest, FindsLongestPrefix)
+{
+  const AnnotationMethods methods = makeMethods({
+    "{funccall};"
+    , "{funccall};make_reflect;"
+    , "{gen};"
+    , "{gen};typeclass;"});
+  AnnotationDispatchTable table(&methods);
+  EXPECT_EQ(4u, table.numMethods());
+
+  size_t methodLength = 0;
+  auto it = table.findLongestPrefix(
+    "{funccall};make_reflect;foo", &methodLength);
+  ASSERT_NE(methods.end(), it);
+  EXPECT_EQ("{funccall};make_reflect;", it->first);
+  EXPECT_EQ(24u, methodLength);
+
+  // longest name is not complete, shorter method is used
+  it = table.findLongestPrefix("{funccall};make_ref", &methodLength);
+  ASSERT_NE(methods.end(), it);
+  EXPECT_EQ("{funccall};", it->first);
+  EXPECT_EQ(11u, methodLength);
+
+  it = table.findLongestPrefix("{gen};", &methodLength);
+  ASSERT_NE(methods.end(), it);
+  EXPECT_EQ("{gen};", it->first);
+  EXPECT_EQ(6u, methodLength);
+}
+
+TEST(AnnotationDispatchTableTest, ReturnsEndWithoutMatch)
+{
+  const AnnotationMethods methods = makeMethods({"{gen};", "{export};"});
+  AnnotationDispatchTable table(&methods);
+
+  size_t methodLength = 42;
+  EXPECT_EQ(methods.end()
+    , table.findLongestPrefix("{ge", &methodLength));
+  EXPECT_EQ(methods.end()
+    , table.findLongestPrefix("", &methodLength));
+  EXPECT_EQ(methods.end()
+    , table.findLongestPrefix("other;{gen};", &methodLength));
+  // not changed if method is not found
+  EXPECT_EQ(42u, methodLength);
+
+  const AnnotationMethods noMethods;
+  AnnotationDispatchTable emptyTable(&noMethods);
+  EXPECT_EQ(noMethods.end()
+    , emptyTable.findLongestPrefix("{gen};", &methodLength));
+}
+
+TEST(AnnotationDispatchTableTest, EmptyMethodNameMatchesAnyAnnotation)
+{
+  const AnnotationMethods methods = makeMethods({"", "{gen};"});
+  AnnotationDispatchTable table(&methods);
+
+  size_t methodLength = 42;
+  auto it = table.findLongestPrefix("other", &methodLength);
+  ASSERT_NE(methods.end(), it);
+  EXPECT_EQ("", it->first);
+  EXPECT_EQ(0u, methodLength);
+
+  it = table.findLongestPrefix("{gen};x", &methodLength);
+  ASSERT_NE(methods.end(), it);
+  EXPECT_EQ("{gen};", it->first);
+}
+
+TEST(AnnotationDispatchTableTest, MatchesLinearScan)
+{
+  const AnnotationMethods methods = makeMethods({
+    "a", "ab", "abc", "abd", "b", "ba;", "{x};", "{x};{y};", "\xff\x01"});
+  AnnotationDispatchTable table(&methods);
+
+  const std::vector<std::string> annotations = {
+    "", "a", "ab", "abc", "abcd", "abd;", "ac", "b", "ba", "ba;",
+    "c", "{x}", "{x};", "{x};{y}", "{x};{y};z", "\xff", "\xff\x01\x02"};
+  for(const std::string& annotation: annotations) {
+    size_t methodLength = 0;
+    const auto found = table.findLongestPrefix(annotation, &methodLength);
+    const auto expected = findLongestPrefixLinear(methods, annotation);
+    EXPECT_EQ(expected, found) << annotation;
+    if(found != methods.end()) {
+      EXPECT_EQ(found->first.size(), methodLength) << annotation;
+    }
+  }
+}
+
+TEST(AnnotationDispatchTableTest, DetectsChangedMethods)
+{
+  AnnotationMethods methods = makeMethods({"{gen};"});
+  AnnotationDispatchTable table(&methods);
+  EXPECT_TRUE(table.isBuiltFor(&methods));
+
+  const AnnotationMethods otherMethods = makeMethods({"{gen};"});
+  EXPECT_FALSE(table.isBuiltFor(&otherMethods));
+
+  methods["{export};"] = AnnotationMethodCallback();
+  EXPECT_FALSE(table.isBuiltFor(&methods));
+}
+
+} // namespace flexlib
@@ -0,0 +1,112 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "ast_test_util.hpp"
+#include "perf_test_util.hpp"
+
+#include "flexlib/matchers/annotation_matcher.hpp"
+#include "flexlib/matchers/annotation_visitor.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <base/bind.h>
+#include <base/strings/string_number_conversions.h>
+
+#include <string>
+#include <vector>
+
+namespace clang_utils {
+
+namespace {
+
+const size_t kNumDecls = 2000;
+
+const size_t kNumIterations = 10;
+
+void countMatch(
+  size_t* numMatches
+  , clang::AnnotateAttr*
+  , const MatchResult&
+  , clang::Rewriter&
+  , const clang::Decl*)
+{
+  (*numMatches)++;
+}
+
+void ignoreEndSourceFile(
+  const clang::FileID&
+  , const clang::FileEntry*
+  , clang::Rewriter&)
+{}
+
+// Most decls are not annotated, like in real translation units
+// where annotated decls are mixed with (large) headers.
+std::string generateSource(size_t numDecls)
+{
+  std::string source;
+  for(size_t i = 0; i < numDecls; ++i) {
+    const std::string index = base::NumberToString(i);
+    source
+      += "struct __attribute__((annotate(\"{gen};{funccall};x\")))"
+         " Annotated" + index + " { int a; void f(); };\n"
+         "template<typename T> struct Plain" + index
+         + " { T value; T get() const { return value + 1; } };\n"
+         "int function" + index
+         + "(int x) { int y = x * 2;"
+           " for(int j = 0; j < x; ++j) { y += j; } return y; }\n";
+  }
+  return source;
+}
+
+class AnnotationMatchBackendPerfTest
+  : public ::flexlib::test::ASTTest
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_NO_FATAL_FAILURE(buildAST(generateSource(kNumDecls)));
+  }
+
+  // Returns number of matched annotations.
+  size_t runBackend(
+    AnnotationMatchBackend matchBackend
+    , const std::string& story)
+  {
+    size_t numMatches = 0;
+    scoped_refptr<AnnotationMatchOptions> options
+      = base::MakeRefCounted<AnnotationMatchOptions>(
+          "bind"
+          , base::BindRepeating(&countMatch, base::Unretained(&numMatches))
+          , base::BindRepeating(&ignoreEndSourceFile));
+    options->matchBackend = matchBackend;
+
+    // AST is parsed once, so only traversal is measured
+    const double microseconds
+      = ::flexlib::test::measureMicroseconds(kNumIterations, [&]() {
+          AnnotateConsumer consumer(rewriter_, options);
+          consumer.HandleTranslationUnit(astUnit_->getASTContext());
+        });
+
+    ::flexlib::test::printPerfResult(
+      "annotation_match_backend", story, microseconds, "us");
+
+    return numMatches / kNumIterations;
+  }
+};
+
+} // namespace
+
+TEST_F(AnnotationMatchBackendPerfTest, MatchFinderVsAttrVisitor)
+{
+  const size_t matchFinderMatches
+    = runBackend(AnnotationMatchBackend::kMatchFinder, "match_finder");
+  const size_t attrVisitorMatches
+    = runBackend(AnnotationMatchBackend::kAttrVisitor, "attr_visitor");
+
+  // both backends must find same annotations
+  EXPECT_EQ(kNumDecls, matchFinderMatches);
+  EXPECT_EQ(matchFinderMatches, attrVisitorMatches);
+}
+
+} // namespace clang_utils
@@ -0,0 +1,170 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/annotation_parse_cache.hpp"
+
+#include <base/memory/scoped_refptr.h>
+
+#include <string>
+
+namespace flexlib {
+
+namespace {
+
+const size_t kMethodsKey = 1;
+
+const size_t kOtherMethodsKey = 2;
+
+// annotations of same length have same |ParsedAnnotation::estimatedSize|
+scoped_refptr<const ParsedAnnotation> makeParsed(
+  const std::string& annotation
+  , size_t methodsKey = kMethodsKey)
+{
+  // "{gen};" is method name
+  return base::MakeRefCounted<ParsedAnnotation>(
+    annotation, "{gen};", 6, methodsKey);
+}
+
+// every annotation has same hash
+size_t collidingHash(std::string_view)
+{
+  return 42;
+}
+
+} // namespace
+
+TEST(AnnotationParseCacheTest, CountsHitsAndMisses)
+{
+  AnnotationParseCache cache{AnnotationParseCache::Options{}};
+
+  EXPECT_EQ(nullptr, cache.lookup("{gen};foo(1)", kMethodsKey));
+  EXPECT_EQ(1u, cache.stats().misses);
+
+  const scoped_refptr<const ParsedAnnotation> parsed
+    = makeParsed("{gen};foo(1)");
+  EXPECT_EQ(parsed, cache.store(parsed));
+  EXPECT_EQ(parsed, cache.lookup("{gen};foo(1)", kMethodsKey));
+  EXPECT_EQ(1u, cache.stats().hits);
+
+  // parsed with other methods
+  EXPECT_EQ(nullptr, cache.lookup("{gen};foo(1)", kOtherMethodsKey));
+  EXPECT_EQ(2u, cache.stats().misses);
+
+  // entry stored first is kept
+  EXPECT_EQ(parsed, cache.store(makeParsed("{gen};foo(1)")));
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(parsed->estimatedSize(), cache.totalBytes());
+  EXPECT_EQ(0u, cache.stats().evictions);
+}
+
+TEST(AnnotationParseCacheTest, EvictsLeastRecentlyUsedEntries)
+{
+  const size_t entrySize = makeParsed("{gen};foo(1)")->estimatedSize();
+
+  AnnotationParseCache::Options options;
+  // two entries fit
+  options.maxBytes = entrySize * 2 + entrySize / 2;
+  AnnotationParseCache cache(std::move(options));
+
+  cache.store(makeParsed("{gen};foo(1)"));
+  cache.store(makeParsed("{gen};foo(2)"));
+  EXPECT_EQ(2u, cache.size());
+  // first entry becomes most recently used
+  ASSERT_TRUE(cache.lookup("{gen};foo(1)", kMethodsKey));
+
+  cache.store(makeParsed("{gen};foo(3)"));
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_EQ(1u, cache.stats().evictions);
+  EXPECT_LE(cache.totalBytes(), entrySize * 2 + entrySize / 2);
+
+  EXPECT_EQ(nullptr, cache.lookup("{gen};foo(2)", kMethodsKey));
+  EXPECT_TRUE(cache.lookup("{gen};foo(1)", kMethodsKey));
+  EXPECT_TRUE(cache.lookup("{gen};foo(3)", kMethodsKey));
+}
+
+TEST(AnnotationParseCacheTest, KeepsLastEntryLargerThanLimit)
+{
+  AnnotationParseCache::Options options;
+  options.maxBytes = 1;
+  AnnotationParseCache cache(std::move(options));
+
+  cache.store(makeParsed("{gen};foo(1)"));
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(0u, cache.stats().evictions);
+
+  cache.store(makeParsed("{gen};foo(2)"));
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(1u, cache.stats().evictions);
+  EXPECT_TRUE(cache.lookup("{gen};foo(2)", kMethodsKey));
+}
+
+TEST(AnnotationParseCacheTest, HandlesHashCollisions)
+{
+  AnnotationParseCache::Options options;
+  options.hashFunction = &collidingHash;
+  AnnotationParseCache cache(std::move(options));
+
+  const scoped_refptr<const ParsedAnnotation> first
+    = makeParsed("{gen};foo(1)");
+  cache.store(first);
+
+  // same hash, other text
+  EXPECT_EQ(nullptr, cache.lookup("{gen};foo(2)", kMethodsKey));
+
+  // replaces entry with same hash
+  const scoped_refptr<const ParsedAnnotation> second
+    = makeParsed("{gen};foo(2)");
+  EXPECT_EQ(second, cache.store(second));
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(second->estimatedSize(), cache.totalBytes());
+  EXPECT_EQ(nullptr, cache.lookup("{gen};foo(1)", kMethodsKey));
+  EXPECT_EQ(second, cache.lookup("{gen};foo(2)", kMethodsKey));
+
+  // same text and hash of text, other methods
+  const scoped_refptr<const ParsedAnnotation> other
+    = makeParsed("{gen};foo(2)", kOtherMethodsKey);
+  EXPECT_EQ(other, cache.store(other));
+  EXPECT_EQ(second, cache.lookup("{gen};foo(2)", kMethodsKey));
+  EXPECT_EQ(other, cache.lookup("{gen};foo(2)", kOtherMethodsKey));
+}
+
+TEST(AnnotationParseCacheTest, ParsedAnnotationKeepsParsedFuncs)
+{
+  const scoped_refptr<const ParsedAnnotation> parsed
+    = makeParsed("{gen};foo(a = 1, b); bar");
+  EXPECT_TRUE(parsed->hasMethod());
+  EXPECT_EQ("foo(a = 1, b); bar", parsed->annotationWithoutMethod());
+  ASSERT_EQ(2u, parsed->funcs().size());
+  EXPECT_EQ("foo", parsed->funcs()[0].func_name_);
+  ASSERT_TRUE(parsed->funcs()[0].find_arg("a"));
+  EXPECT_EQ("1", parsed->funcs()[0].find_arg("a")->value_);
+  EXPECT_EQ("bar", parsed->funcs()[1].func_name_);
+
+  // arguments of unregistered method are not parsed
+  const scoped_refptr<const ParsedAnnotation> unregistered
+    = base::MakeRefCounted<ParsedAnnotation>(
+        "other(a = 1)", std::string(), 12, kMethodsKey);
+  EXPECT_FALSE(unregistered->hasMethod());
+  EXPECT_TRUE(unregistered->funcs().empty());
+}
+
+TEST(AnnotationParseCacheTest, ScopedCurrentParsedAnnotation)
+{
+  const scoped_refptr<const ParsedAnnotation> parsed
+    = makeParsed("{gen};foo(1)");
+  const scoped_refptr<const ParsedAnnotation> inner
+    = makeParsed("{gen};foo(2)");
+
+  EXPECT_EQ(nullptr, ParsedAnnotation::current());
+  {
+    ParsedAnnotation::ScopedCurrent scopedParsed(parsed.get());
+    EXPECT_EQ(parsed.get(), ParsedAnnotation::current());
+    {
+      ParsedAnnotation::ScopedCurrent scopedInner(inner.get());
+      EXPECT_EQ(inner.get(), ParsedAnnotation::current());
+    }
+    EXPECT_EQ(parsed.get(), ParsedAnnotation::current());
+  }
+  EXPECT_EQ(nullptr, ParsedAnnotation::current());
+}
+
+} // namespace flexlib
@@ -0,0 +1,168 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/annotation_prescan.hpp"
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/time/time.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace flexlib {
+
+namespace {
+
+const char kPlainSource[] = "int value;\n";
+
+// same size as |kPlainSource|
+const char kAnnotatedSource[] = "// {gen}; \n";
+
+class AnnotationPrescannerTest
+  : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(tempDir_.CreateUniqueTempDir());
+    ASSERT_TRUE(base::CreateDirectory(path("src")));
+    ASSERT_TRUE(base::CreateDirectory(path("include")));
+    ASSERT_TRUE(base::CreateDirectory(path("third_party")));
+    // names of headers must not contain searched strings
+    ASSERT_TRUE(writeFile("include/marked.hpp"
+      , "struct __attribute__((annotate(\"{gen};x\"))) Marked {};\n"));
+    ASSERT_TRUE(writeFile("third_party/external_marked.hpp"
+      , "struct __attribute__((annotate(\"{gen};x\"))) Marked {};\n"));
+  }
+
+  base::FilePath path(const std::string& name) const
+  {
+    return tempDir_.GetPath().AppendASCII(name);
+  }
+
+  bool writeFile(const std::string& name, const std::string& contents)
+  {
+    return base::WriteFile(path(name), contents.data(), contents.size())
+      == static_cast<int>(contents.size());
+  }
+
+  // only `include` directory is project-local
+  AnnotationPrescanner::Options makeOptions() const
+  {
+    AnnotationPrescanner::Options options;
+    options.localIncludeDirs.push_back(path("include"));
+    return options;
+  }
+
+  base::ScopedTempDir tempDir_;
+};
+
+} // namespace
+
+TEST_F(AnnotationPrescannerTest, SkipsOnlyMainFileWithoutAnnotations)
+{
+  ASSERT_TRUE(writeFile("src/plain.cc", kPlainSource));
+  ASSERT_TRUE(writeFile("src/annotated.cc"
+    , "struct __attribute__((annotate(\"{gen};x\"))) Local {};\n"));
+  // prefix may be used with macro defined in system header
+  ASSERT_TRUE(writeFile("src/prefix.cc", kAnnotatedSource));
+
+  AnnotationPrescanner prescanner(makeOptions());
+  EXPECT_FALSE(prescanner.mayContainAnnotations(path("src/plain.cc")));
+  EXPECT_TRUE(prescanner.mayContainAnnotations(path("src/annotated.cc")));
+  EXPECT_TRUE(prescanner.mayContainAnnotations(path("src/prefix.cc")));
+  // let clang report error
+  EXPECT_TRUE(prescanner.mayContainAnnotations(path("src/missing.cc")));
+  EXPECT_EQ(1u, prescanner.stats().skippedTranslationUnits);
+
+  // order of kept files is preserved
+  const std::vector<std::string> sourcePaths{
+    path("src/prefix.cc").AsUTF8Unsafe()
+    , path("src/plain.cc").AsUTF8Unsafe()
+    , path("src/annotated.cc").AsUTF8Unsafe()};
+  EXPECT_EQ((std::vector<std::string>{sourcePaths[0], sourcePaths[2]})
+    , prescanner.filterTranslationUnits(sourcePaths));
+
+  // every translation unit is kept if pre-scan is disabled
+  AnnotationPrescanner::Options disabledOptions = makeOptions();
+  disabledOptions.enabled = false;
+  AnnotationPrescanner disabled(std::move(disabledOptions));
+  EXPECT_TRUE(disabled.mayContainAnnotations(path("src/plain.cc")));
+}
+
+TEST_F(AnnotationPrescannerTest, KeepsAnnotationInLocalHeader)
+{
+  ASSERT_TRUE(writeFile("src/local.hpp", "#include <marked.hpp>\n"));
+  // found in directory of including file
+  ASSERT_TRUE(writeFile("src/quoted.cc"
+    , "#include <vector>\n"
+      "#include \"local.hpp\"\n"));
+  // found in |Options::localIncludeDirs|
+  ASSERT_TRUE(writeFile("src/angled.cc", "#include <marked.hpp>\n"));
+  // header is not project-local
+  ASSERT_TRUE(writeFile("src/third_party.cc"
+    , "#include <external_marked.hpp>\n"));
+
+  AnnotationPrescanner prescanner(makeOptions());
+  EXPECT_TRUE(prescanner.mayContainAnnotations(path("src/quoted.cc")));
+  EXPECT_TRUE(prescanner.mayContainAnnotations(path("src/angled.cc")));
+  EXPECT_FALSE(prescanner.mayContainAnnotations(path("src/third_party.cc")));
+
+  AnnotationPrescanner::Options options = makeOptions();
+  options.localIncludeDirs.clear();
+  AnnotationPrescanner withoutLocalDirs(std::move(options));
+  EXPECT_FALSE(
+    withoutLocalDirs.mayContainAnnotations(path("src/angled.cc")));
+}
+
+TEST_F(AnnotationPrescannerTest, KeepsFileWithExtraMarker)
+{
+  // macro may come from header that is not scanned
+  ASSERT_TRUE(writeFile("src/macro.cc"
+    , "#include <third_party_macros.hpp>\n"
+      "struct MY_GENERATED Foo {};\n"));
+
+  AnnotationPrescanner prescanner(makeOptions());
+  EXPECT_FALSE(prescanner.mayContainAnnotations(path("src/macro.cc")));
+
+  AnnotationPrescanner::Options options = makeOptions();
+  options.extraMarkers.push_back("MY_GENERATED");
+  AnnotationPrescanner withMarker(std::move(options));
+  EXPECT_TRUE(withMarker.mayContainAnnotations(path("src/macro.cc")));
+}
+
+TEST_F(AnnotationPrescannerTest, RescansChangedFile)
+{
+  ASSERT_TRUE(writeFile("src/main.cc", "#include \"changed.hpp\"\n"));
+  ASSERT_TRUE(writeFile("src/changed.hpp", kPlainSource));
+
+  AnnotationPrescanner prescanner(makeOptions());
+  EXPECT_FALSE(prescanner.mayContainAnnotations(path("src/main.cc")));
+  EXPECT_EQ(2u, prescanner.stats().scannedFiles);
+  EXPECT_EQ(0u, prescanner.stats().cachedFiles);
+
+  // not changed
+  EXPECT_FALSE(prescanner.mayContainAnnotations(path("src/main.cc")));
+  EXPECT_EQ(2u, prescanner.stats().scannedFiles);
+  EXPECT_EQ(2u, prescanner.stats().cachedFiles);
+
+  // same size, other modification time
+  ASSERT_EQ(sizeof(kPlainSource), sizeof(kAnnotatedSource));
+  ASSERT_TRUE(writeFile("src/changed.hpp", kAnnotatedSource));
+  const base::Time newTime
+    = base::Time::Now() + base::TimeDelta::FromSeconds(10);
+  ASSERT_TRUE(base::TouchFile(path("src/changed.hpp"), newTime, newTime));
+  EXPECT_TRUE(prescanner.mayContainAnnotations(path("src/main.cc")));
+  EXPECT_EQ(3u, prescanner.stats().scannedFiles);
+
+  // other size, same modification time
+  ASSERT_TRUE(writeFile("src/changed.hpp", "int other_value;\n"));
+  ASSERT_TRUE(base::TouchFile(path("src/changed.hpp"), newTime, newTime));
+  EXPECT_FALSE(prescanner.mayContainAnnotations(path("src/main.cc")));
+  EXPECT_EQ(4u, prescanner.stats().scannedFiles);
+  EXPECT_EQ(3u, prescanner.stats().skippedTranslationUnits);
+}
+
+} // namespace flexlib
@@ -0,0 +1,205 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/annotation_result_cache.hpp"
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang_utils {
+
+namespace {
+
+class AnnotationResultCacheTest
+  : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(tempDir_.CreateUniqueTempDir());
+    ASSERT_TRUE(writeFile("input.cc", "#include \"header.hpp\"\n"));
+    ASSERT_TRUE(writeFile("header.hpp", "int header();\n"));
+  }
+
+  base::FilePath path(const std::string& name) const
+  {
+    return tempDir_.GetPath().AppendASCII(name);
+  }
+
+  bool writeFile(const std::string& name, const std::string& contents)
+  {
+    return base::WriteFile(path(name), contents.data(), contents.size())
+      == static_cast<int>(contents.size());
+  }
+
+  AnnotationResultCache::Options makeOptions() const
+  {
+    AnnotationResultCache::Options options;
+    options.cacheDir = path("cache");
+    options.annotationMethodNames = {"{gen};", "{funccall};"};
+    options.toolVersions = {"tool-1"};
+    return options;
+  }
+
+  // result as produced by worker for `input.cc`
+  AnnotationFileResult makeResult() const
+  {
+    AnnotationFileResult result;
+    result.sourcePath = path("input.cc").AsUTF8Unsafe();
+    result.status = AnnotationFileResult::Status::kDone;
+    result.isRewritten = true;
+    result.rewrittenBuffer = "// generated\n";
+    result.sideOutputs[path("input.generated.hpp").AsUTF8Unsafe()]
+      = "int generated();\n";
+    for(const char* name: {"input.cc", "header.hpp"}) {
+      std::string contents;
+      EXPECT_TRUE(base::ReadFileToString(path(name), &contents));
+      result.dependencies.push_back(AnnotationFileDependency{
+        path(name).AsUTF8Unsafe(), computeContentHash(contents)});
+    }
+    // searched before directory of `header.hpp`
+    result.absentDependencies.push_back(
+      path("include").AppendASCII("header.hpp").AsUTF8Unsafe());
+    return result;
+  }
+
+  std::string computeKey(
+    const AnnotationResultCache& cache
+    , const std::vector<std::string>& compileArgs
+    , const std::vector<std::string>& extraKeyParts
+        = std::vector<std::string>()) const
+  {
+    const clang::tooling::FixedCompilationDatabase compilations(
+      tempDir_.GetPath().AsUTF8Unsafe(), compileArgs);
+    return cache.computeKey(
+      compilations, path("input.cc").AsUTF8Unsafe(), extraKeyParts);
+  }
+
+  base::ScopedTempDir tempDir_;
+};
+
+} // namespace
+
+TEST_F(AnnotationResultCacheTest, StoresAndLooksUpResult)
+{
+  AnnotationResultCache cache(makeOptions());
+  const std::string key = computeKey(cache, {"-std=c++17"});
+  ASSERT_FALSE(key.empty());
+
+  AnnotationFileResult missed;
+  EXPECT_FALSE(cache.lookup(key, &missed));
+  EXPECT_FALSE(missed.isFromCache);
+  EXPECT_EQ(1u, cache.stats().misses);
+
+  const AnnotationFileResult stored = makeResult();
+  ASSERT_TRUE(cache.store(key, stored));
+  EXPECT_EQ(1u, cache.stats().stores);
+
+  // entry is read from disk by other instance
+  AnnotationResultCache otherCache(makeOptions());
+  AnnotationFileResult result;
+  ASSERT_TRUE(otherCache.lookup(key, &result));
+  EXPECT_TRUE(result.isFromCache);
+  EXPECT_EQ(stored.isRewritten, result.isRewritten);
+  EXPECT_EQ(stored.rewrittenBuffer, result.rewrittenBuffer);
+  EXPECT_EQ(stored.sideOutputs, result.sideOutputs);
+  EXPECT_EQ(1u, otherCache.stats().hits);
+}
+
+TEST_F(AnnotationResultCacheTest, RejectsResultWithoutDependencies)
+{
+  AnnotationResultCache cache(makeOptions());
+  const std::string key = computeKey(cache, {"-std=c++17"});
+
+  AnnotationFileResult result = makeResult();
+  result.dependencies.clear();
+  EXPECT_FALSE(cache.store(key, result));
+  EXPECT_EQ(0u, cache.stats().stores);
+
+  EXPECT_FALSE(cache.lookup(key, &result));
+}
+
+TEST_F(AnnotationResultCacheTest, MissesWhenDependencyChanges)
+{
+  AnnotationResultCache cache(makeOptions());
+  const std::string key = computeKey(cache, {"-std=c++17"});
+  ASSERT_TRUE(cache.store(key, makeResult()));
+
+  AnnotationFileResult result;
+  ASSERT_TRUE(cache.lookup(key, &result));
+
+  // other size, so hash remembered for old file is not used
+  ASSERT_TRUE(writeFile("header.hpp", "int header(int value);\n"));
+
+  AnnotationFileResult outdated;
+  EXPECT_FALSE(cache.lookup(key, &outdated));
+  EXPECT_FALSE(outdated.isFromCache);
+  EXPECT_EQ(1u, cache.stats().hits);
+  EXPECT_EQ(1u, cache.stats().misses);
+}
+
+TEST_F(AnnotationResultCacheTest, MissesWhenAbsentDependencyCreated)
+{
+  AnnotationResultCache cache(makeOptions());
+  const std::string key = computeKey(cache, {"-std=c++17"});
+  ASSERT_TRUE(cache.store(key, makeResult()));
+
+  AnnotationFileResult result;
+  ASSERT_TRUE(cache.lookup(key, &result));
+
+  // new header shadows included one
+  ASSERT_TRUE(base::CreateDirectory(path("include")));
+  ASSERT_TRUE(writeFile("include/header.hpp", "int shadowed();\n"));
+
+  AnnotationFileResult outdated;
+  EXPECT_FALSE(cache.lookup(key, &outdated));
+  EXPECT_FALSE(outdated.isFromCache);
+}
+
+TEST_F(AnnotationResultCacheTest, KeyDependsOnFlagsMethodsAndExtraParts)
+{
+  AnnotationResultCache cache(makeOptions());
+  const std::string key = computeKey(cache, {"-std=c++17"});
+  ASSERT_FALSE(key.empty());
+  EXPECT_EQ(key, computeKey(cache, {"-std=c++17"}));
+
+  // compile flags
+  EXPECT_NE(key, computeKey(cache, {"-std=c++14"}));
+  EXPECT_NE(key, computeKey(cache, {"-std=c++17", "-DDEBUG"}));
+
+  // extra key parts (like stamp of precompiled header)
+  const std::string keyWithStamp
+    = computeKey(cache, {"-std=c++17"}, {"stamp-1"});
+  EXPECT_NE(key, keyWithStamp);
+  EXPECT_NE(keyWithStamp, computeKey(cache, {"-std=c++17"}, {"stamp-2"}));
+
+  // annotation methods
+  AnnotationResultCache::Options otherMethods = makeOptions();
+  otherMethods.annotationMethodNames.push_back("{export};");
+  EXPECT_NE(key
+    , computeKey(AnnotationResultCache(std::move(otherMethods))
+        , {"-std=c++17"}));
+
+  // order of plugin loading is ignored
+  AnnotationResultCache::Options reorderedMethods = makeOptions();
+  std::swap(reorderedMethods.annotationMethodNames[0]
+    , reorderedMethods.annotationMethodNames[1]);
+  EXPECT_EQ(key
+    , computeKey(AnnotationResultCache(std::move(reorderedMethods))
+        , {"-std=c++17"}));
+
+  // tool versions
+  AnnotationResultCache::Options otherVersions = makeOptions();
+  otherVersions.toolVersions = {"tool-2"};
+  EXPECT_NE(key
+    , computeKey(AnnotationResultCache(std::move(otherVersions))
+        , {"-std=c++17"}));
+}
+
+} // namespace clang_utils
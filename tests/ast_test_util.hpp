@@ -0,0 +1,47 @@
+#pragma once
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <memory>
+#include <string>
+
+namespace flexlib {
+namespace test {
+
+// Fixture for tests that need AST of small C++ source.
+//
+// EXAMPLE:
+// class MyTest : public ::flexlib::test::ASTTest
+// {
+// protected:
+//   void SetUp() override
+//   {
+//     ASSERT_NO_FATAL_FAILURE(buildAST("struct Foo {};"));
+//   }
+// };
+class ASTTest
+  : public ::testing::Test
+{
+protected:
+  // Parses |source| as C++17 file `input.cc`
+  // and attaches |rewriter_| to its |clang::SourceManager|.
+  void buildAST(const std::string& source)
+  {
+    astUnit_ = clang::tooling::buildASTFromCodeWithArgs(
+      source, {"-std=c++17"}, "input.cc");
+    ASSERT_TRUE(astUnit_);
+    rewriter_.setSourceMgr(
+      astUnit_->getSourceManager(), astUnit_->getLangOpts());
+  }
+
+  std::unique_ptr<clang::ASTUnit> astUnit_;
+
+  clang::Rewriter rewriter_;
+};
+
+} // namespace test
+} // namespace flexlib
@@ -0,0 +1,140 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/async_output_writer.hpp"
+#include "flexlib/output_sink.hpp"
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/strings/string_number_conversions.h>
+
+#include <string>
+
+namespace flexlib {
+
+namespace {
+
+const size_t kNumFiles = 64;
+
+class AsyncOutputWriterTest
+  : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(tempDir_.CreateUniqueTempDir());
+  }
+
+  base::FilePath outputPath(size_t index) const
+  {
+    return tempDir_.GetPath().AppendASCII(
+      "out/file" + base::NumberToString(index) + ".hpp");
+  }
+
+  static std::string contentsOf(size_t index)
+  {
+    return "// generated " + base::NumberToString(index) + "\n";
+  }
+
+  base::ScopedTempDir tempDir_;
+
+  OutputSink outputSink_;
+};
+
+} // namespace
+
+TEST_F(AsyncOutputWriterTest, FlushWaitsForPendingWrites)
+{
+  AsyncOutputWriter outputWriter(&outputSink_, AsyncOutputWriter::Options{});
+
+  for(size_t i = 0; i < kNumFiles; ++i) {
+    outputWriter.write(outputPath(i), contentsOf(i));
+  }
+  EXPECT_TRUE(outputWriter.flush());
+
+  EXPECT_EQ(kNumFiles, outputSink_.stats().written);
+  for(size_t i = 0; i < kNumFiles; ++i) {
+    std::string contents;
+    ASSERT_TRUE(base::ReadFileToString(outputPath(i), &contents));
+    EXPECT_EQ(contentsOf(i), contents);
+  }
+}
+
+TEST_F(AsyncOutputWriterTest, BackpressureLimitsPendingWrites)
+{
+  AsyncOutputWriter::Options options;
+  options.numThreads = 1;
+  options.maxPendingWrites = 1;
+  options.maxPendingBytes = 8;
+  AsyncOutputWriter outputWriter(&outputSink_, std::move(options));
+
+  // every write waits for previous one,
+  // contents larger than |maxPendingBytes| are still accepted
+  for(size_t i = 0; i < kNumFiles; ++i) {
+    outputWriter.write(outputPath(i), contentsOf(i));
+  }
+  EXPECT_TRUE(outputWriter.flush());
+  EXPECT_EQ(kNumFiles, outputSink_.stats().written);
+
+  // unchanged files are skipped by |OutputSink|
+  for(size_t i = 0; i < kNumFiles; ++i) {
+    outputWriter.write(outputPath(i), contentsOf(i));
+  }
+  EXPECT_TRUE(outputWriter.flush());
+  EXPECT_EQ(kNumFiles, outputSink_.stats().skipped);
+}
+
+TEST_F(AsyncOutputWriterTest, LastWriteOfSameFileWins)
+{
+  AsyncOutputWriter::Options options;
+  options.numThreads = 4;
+  AsyncOutputWriter outputWriter(&outputSink_, std::move(options));
+
+  // same file twice between other files, then many times in a row
+  outputWriter.write(outputPath(0), contentsOf(1));
+  outputWriter.write(outputPath(1), contentsOf(1));
+  outputWriter.write(outputPath(0), contentsOf(2));
+  for(size_t i = 0; i < kNumFiles; ++i) {
+    outputWriter.write(outputPath(2), contentsOf(i));
+  }
+  EXPECT_TRUE(outputWriter.flush());
+
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(outputPath(0), &contents));
+  EXPECT_EQ(contentsOf(2), contents);
+  ASSERT_TRUE(base::ReadFileToString(outputPath(2), &contents));
+  EXPECT_EQ(contentsOf(kNumFiles - 1), contents);
+}
+
+TEST_F(AsyncOutputWriterTest, FlushReportsFailedWrites)
+{
+  AsyncOutputWriter outputWriter(&outputSink_, AsyncOutputWriter::Options{});
+
+  // directory can not be created where regular file exists
+  const base::FilePath blocker = tempDir_.GetPath().AppendASCII("blocker");
+  ASSERT_EQ(0, base::WriteFile(blocker, "", 0));
+  outputWriter.write(blocker.AppendASCII("file.hpp"), contentsOf(0));
+  outputWriter.write(outputPath(1), contentsOf(1));
+
+  EXPECT_FALSE(outputWriter.flush());
+  EXPECT_EQ(1u, outputSink_.stats().failed);
+  EXPECT_EQ(1u, outputSink_.stats().written);
+
+  // failure is reported once
+  EXPECT_TRUE(outputWriter.flush());
+}
+
+TEST_F(AsyncOutputWriterTest, DestructorWritesPendingFiles)
+{
+  {
+    AsyncOutputWriter outputWriter(
+      &outputSink_, AsyncOutputWriter::Options{});
+    for(size_t i = 0; i < kNumFiles; ++i) {
+      outputWriter.write(outputPath(i), contentsOf(i));
+    }
+  }
+  EXPECT_EQ(kNumFiles, outputSink_.stats().written);
+  EXPECT_TRUE(base::PathExists(outputPath(kNumFiles - 1)));
+}
+
+} // namespace flexlib
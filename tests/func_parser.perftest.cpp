@@ -0,0 +1,294 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "perf_test_util.hpp"
+
+#include "flexlib/funcParser.hpp"
+
+#include <base/strings/string_number_conversions.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace flexlib {
+
+namespace {
+
+// approximate number of bytes parsed per story and implementation
+const size_t kParsedBytesPerStory = 4 * 1024 * 1024;
+
+struct Annotation {
+  // story name in perf results
+  std::string story;
+
+  std::string text;
+
+  // |false| if input uses syntax handled only by new parser
+  // (nested parentheses, raw string literals, escaped quotes)
+  bool isSupportedByStringstream = true;
+};
+
+// Previous implementation of |split_to_funcs| based on
+// |std::stringstream| and |std::quoted|, kept as reference
+// for results and performance of single-pass parser.
+functionArgument extract_func_arg_stringstream(std::string const& inStr) {
+  std::string arg_value_ = inStr;
+  std::string arg_name_ = "";
+  auto delim_pos = inStr.find('=');
+  if(delim_pos != std::string::npos) {
+    arg_name_ = inStr.substr(0, delim_pos);
+    if(!arg_name_.empty()) {
+      arg_value_ = inStr.substr(arg_name_.length() + 1, inStr.length());
+    }
+  }
+  return {arg_name_, arg_value_};
+}
+
+void add_func_arg_stringstream(
+  const std::string& func_arg_as_str
+  , std::vector<functionArgument>* func_args_vec_
+  , std::map<std::string, std::vector<std::string>>*
+      func_args_as_name_to_value_)
+{
+  functionArgument arg_parsed = extract_func_arg_stringstream(func_arg_as_str);
+  func_args_vec_->push_back(arg_parsed);
+  if(!arg_parsed.name_.empty()) {
+    (*func_args_as_name_to_value_)[arg_parsed.name_].push_back(
+      arg_parsed.value_);
+  }
+}
+
+std::vector<parsed_func> split_to_funcs_stringstream(
+  std::string const& inStr)
+{
+  std::vector<parsed_func> result;
+  std::stringstream ss;
+  ss << inStr
+    << ";"; // close funcs list with ';'
+
+  std::string func_with_args_;
+  std::string func_name_unprocessed_;
+  std::string func_arg_as_str;
+  bool is_in_args = false;
+  std::vector<functionArgument> func_args_vec_;
+  std::map<std::string, std::vector<std::string>> func_args_as_name_to_value_;
+  while (ss >> std::ws) {
+    if (ss.peek() == '"') {
+      std::string quoted;
+      ss >> std::quoted(quoted);
+      func_with_args_ += '"' + quoted + '"';
+      if(is_in_args) {
+        func_arg_as_str += '"' + quoted + '"';
+      }
+    }
+    else if (ss.peek() == '(') {
+      is_in_args = true;
+      func_name_unprocessed_ = func_with_args_;
+      char c;
+      ss >> c;
+      func_with_args_ += c;
+      func_arg_as_str.clear();
+    }
+    else if (ss.peek() == ')' || ss.peek() == ',') {
+      if(ss.peek() == ')') {
+        is_in_args = false;
+      }
+      add_func_arg_stringstream(
+        func_arg_as_str, &func_args_vec_, &func_args_as_name_to_value_);
+      char c;
+      ss >> c;
+      func_with_args_ += c;
+      func_arg_as_str.clear();
+    }
+    else if (ss.peek() == ';') {
+      char c;
+      ss >> c;
+      if(func_with_args_.empty()) {
+        continue;
+      }
+      if(func_name_unprocessed_.empty()) {
+        // func without args and without ()
+        func_name_unprocessed_ = func_with_args_;
+      }
+      result.push_back(
+        parsed_func{
+          func_with_args_,
+          {
+            func_name_unprocessed_,
+            args{
+              func_args_vec_,
+              func_args_as_name_to_value_
+            },
+          }
+        });
+      func_with_args_.clear();
+      func_name_unprocessed_.clear();
+      func_args_vec_.clear();
+      func_arg_as_str.clear();
+      func_args_as_name_to_value_.clear();
+    } else {
+      char c;
+      ss >> c;
+      func_with_args_ += c;
+      if(is_in_args) {
+        func_arg_as_str += c;
+      }
+    }
+  }
+  return result;
+}
+
+// `generated(a0 = value0, a1 = value1, ...)`
+// where |makeValue| returns value of argument by index
+template<typename MakeValue>
+std::string generateFunc(size_t numArgs, MakeValue&& makeValue)
+{
+  std::string text = "generated(";
+  for(size_t i = 0; i < numArgs; ++i) {
+    if(i) {
+      text += ", ";
+    }
+    text += "a" + base::NumberToString(i) + " = " + makeValue(i);
+  }
+  text += ") ; done";
+  return text;
+}
+
+std::string plainValue(size_t index)
+{
+  return index % 2
+    ? "\"value " + base::NumberToString(index) + "\""
+    : base::NumberToString(index);
+}
+
+std::string nestedValue(size_t index)
+{
+  return "f(g(" + base::NumberToString(index) + ", (1; 2)), h())";
+}
+
+std::string rawStringValue(size_t index)
+{
+  return "R\"raw(x = \"" + base::NumberToString(index)
+    + "\"; f(a, b);)raw\"";
+}
+
+// annotations like ones used by plugins
+// and generated annotations with many arguments
+std::vector<Annotation> perfAnnotations()
+{
+  return {
+    {"string_arg", "make_enum(\"Color\", flag = false)"}
+    , {"two_funcs", "foo(a = 1, b, a = \"2\") ; bar"}
+    , {"named_args"
+      , "typeclass(name = MagicTemplated, interface = MagicItem)"
+        "; reflectable(methods = true, fields = true)"}
+    , {"raw_string"
+      , "executeCode(code = R\"raw(std::string x = \"a;b\"; (void)x;)raw\")"
+      , false}
+    , {"nested_parentheses"
+      , "funccall(inherit = ()) ; export(path = \"out/generated.hpp\", "
+        "guard = GENERATED_HPP, nested = foo(bar(1, 2; 3), baz))"
+      , false}
+    , {"args_1k", generateFunc(1000, &plainValue)}
+    , {"args_10k", generateFunc(10000, &plainValue)}
+    , {"nested_parentheses_1k", generateFunc(1000, &nestedValue), false}
+    , {"raw_strings_1k", generateFunc(1000, &rawStringValue), false}
+  };
+}
+
+size_t numIterations(const Annotation& annotation)
+{
+  return std::max<size_t>(
+    10, kParsedBytesPerStory / std::max<size_t>(1, annotation.text.size()));
+}
+
+void expectSameFuncs(
+  const std::vector<parsed_func>& expected
+  , const std::vector<parsed_func>& actual
+  , const std::string& story)
+{
+  ASSERT_EQ(expected.size(), actual.size()) << story;
+  for(size_t i = 0; i < expected.size(); ++i) {
+    const parsed_func& expectedFunc = expected[i];
+    const parsed_func& actualFunc = actual[i];
+    EXPECT_EQ(expectedFunc.func_with_args_as_string_
+      , actualFunc.func_with_args_as_string_) << story;
+    EXPECT_EQ(expectedFunc.parsed_func_.func_name_
+      , actualFunc.parsed_func_.func_name_) << story;
+
+    const args& expectedArgs = expectedFunc.parsed_func_.args_;
+    const args& actualArgs = actualFunc.parsed_func_.args_;
+    ASSERT_EQ(expectedArgs.as_vec_.size(), actualArgs.as_vec_.size())
+      << story;
+    for(size_t j = 0; j < expectedArgs.as_vec_.size(); ++j) {
+      EXPECT_EQ(expectedArgs.as_vec_[j].name_, actualArgs.as_vec_[j].name_)
+        << story;
+      EXPECT_EQ(expectedArgs.as_vec_[j].value_
+        , actualArgs.as_vec_[j].value_) << story;
+    }
+    EXPECT_EQ(expectedArgs.as_name_to_value_, actualArgs.as_name_to_value_)
+      << story;
+  }
+}
+
+} // namespace
+
+TEST(FuncParserPerfTest, SplitToFuncsMatchesStringstreamImplementation)
+{
+  for(const Annotation& annotation: perfAnnotations()) {
+    if(!annotation.isSupportedByStringstream) {
+      continue;
+    }
+    expectSameFuncs(
+      split_to_funcs_stringstream(annotation.text)
+      , split_to_funcs(annotation.text)
+      , annotation.story);
+  }
+}
+
+TEST(FuncParserPerfTest, SplitToFuncsStringstream)
+{
+  size_t numFuncs = 0;
+  for(const Annotation& annotation: perfAnnotations()) {
+    const double microseconds
+      = test::measureMicroseconds(numIterations(annotation), [&]() {
+          numFuncs += split_to_funcs_stringstream(annotation.text).size();
+        });
+    test::printPerfResult(
+      "split_to_funcs_stringstream", annotation.story, microseconds, "us");
+  }
+  EXPECT_GT(numFuncs, 0u);
+}
+
+TEST(FuncParserPerfTest, SplitToFuncs)
+{
+  size_t numFuncs = 0;
+  for(const Annotation& annotation: perfAnnotations()) {
+    const double microseconds
+      = test::measureMicroseconds(numIterations(annotation), [&]() {
+          numFuncs += split_to_funcs(annotation.text).size();
+        });
+    test::printPerfResult(
+      "split_to_funcs", annotation.story, microseconds, "us");
+  }
+  EXPECT_GT(numFuncs, 0u);
+}
+
+TEST(FuncParserPerfTest, SplitToFlatFuncs)
+{
+  size_t numFuncs = 0;
+  for(const Annotation& annotation: perfAnnotations()) {
+    const double microseconds
+      = test::measureMicroseconds(numIterations(annotation), [&]() {
+          numFuncs += split_to_flat_funcs(annotation.text).size();
+        });
+    test::printPerfResult(
+      "split_to_flat_funcs", annotation.story, microseconds, "us");
+  }
+  EXPECT_GT(numFuncs, 0u);
+}
+
+} // namespace flexlib
@@ -0,0 +1,150 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "ast_test_util.hpp"
+#include "perf_test_util.hpp"
+
+#include "flexlib/reflect/LazyClassInfo.hpp"
+#include "flexlib/reflect/ReflTypes.hpp"
+#include "flexlib/reflect/ReflectAST.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclCXX.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/Frontend/ASTUnit.h>
+
+#include <base/strings/string_number_conversions.h>
+
+#include <string>
+#include <vector>
+
+namespace reflection {
+
+namespace {
+
+using namespace clang::ast_matchers;
+
+const size_t kNumClasses = 300;
+
+const size_t kNumIterations = 10;
+
+// classes with bases and members of template types,
+// so full reflection pays for |TypeInfo| and record layout
+std::string generateSource(size_t numClasses)
+{
+  std::string source
+    = "template<typename T> struct Holder { T value; T* next; };\n"
+      "struct Base { virtual ~Base(); int id; };\n"
+      "namespace generated {\n";
+  for (size_t i = 0; i < numClasses; ++i)
+  {
+    const std::string index = base::NumberToString(i);
+    source
+      += "struct Class" + index + " : Base {\n"
+         "  Holder<int> first; Holder<Holder<double>> second;\n"
+         "  Holder<const char*> third[4];\n"
+         "  struct Inner { Holder<long> value; };\n"
+         "  int get(int x) const;\n"
+         "  void set(const Holder<int>& value);\n"
+         "  static Class" + index + " create();\n"
+         "};\n";
+  }
+  source += "} // namespace generated\n";
+  return source;
+}
+
+class LazyClassInfoPerfTest
+  : public ::flexlib::test::ASTTest
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_NO_FATAL_FAILURE(buildAST(generateSource(kNumClasses)));
+
+    const auto matches = match(
+      cxxRecordDecl(
+        isExpansionInMainFile()
+        , isDefinition()
+        , hasParent(namespaceDecl(hasName("generated")))).bind("record")
+      , astUnit_->getASTContext());
+    for (const BoundNodes& nodes : matches) {
+      records_.push_back(
+        nodes.getNodeAs<clang::CXXRecordDecl>("record"));
+    }
+    ASSERT_EQ(kNumClasses, records_.size());
+  }
+
+  std::vector<const clang::CXXRecordDecl*> records_;
+};
+
+} // namespace
+
+// Generator that needs only names and methods of classes.
+TEST_F(LazyClassInfoPerfTest, NamesAndMethods)
+{
+  AstReflector reflector(&astUnit_->getASTContext());
+
+  size_t eagerMethods = 0;
+  const double eagerMicroseconds
+    = ::flexlib::test::measureMicroseconds(kNumIterations, [&]() {
+        // new tree, so classes are not found as already reflected
+        NamespacesTree nsTree;
+        for (const clang::CXXRecordDecl* record : records_)
+        {
+          ClassInfoPtr classInfo = reflector.ReflectClass(record, &nsTree);
+          eagerMethods += classInfo->name.size() > 0
+            ? classInfo->methods.size()
+            : 0u;
+        }
+      });
+  ::flexlib::test::printPerfResult(
+    "lazy_class_info", "names_and_methods_eager", eagerMicroseconds, "us");
+
+  size_t lazyMethods = 0;
+  const double lazyMicroseconds
+    = ::flexlib::test::measureMicroseconds(kNumIterations, [&]() {
+        NamespacesTree nsTree;
+        for (const clang::CXXRecordDecl* record : records_)
+        {
+          LazyClassInfoPtr classInfo
+            = reflector.ReflectClassLazy(record, &nsTree);
+          lazyMethods += classInfo->GetBasics().name.size() > 0
+            ? classInfo->GetMethods().size()
+            : 0u;
+        }
+      });
+  ::flexlib::test::printPerfResult(
+    "lazy_class_info", "names_and_methods_lazy", lazyMicroseconds, "us");
+
+  // both paths must see same methods
+  EXPECT_GT(eagerMethods, 0u);
+  EXPECT_EQ(eagerMethods, lazyMethods);
+}
+
+TEST_F(LazyClassInfoPerfTest, GetClassInfoReturnsRegisteredInstance)
+{
+  AstReflector reflector(&astUnit_->getASTContext());
+  NamespacesTree nsTree;
+
+  const clang::CXXRecordDecl* record = records_.front();
+  LazyClassInfoPtr lazyInfo = reflector.ReflectClassLazy(record, &nsTree);
+  const std::vector<MethodInfoPtr>& methods = lazyInfo->GetMethods();
+  const size_t numMethods = methods.size();
+  ASSERT_GT(numMethods, 0u);
+
+  // registered while proxy was alive
+  ClassInfoPtr registered = reflector.ReflectClass(record, &nsTree);
+  ASSERT_TRUE(registered);
+
+  EXPECT_EQ(registered, lazyInfo->GetClassInfo());
+  EXPECT_EQ(registered, nsTree.FindClass(record));
+
+  // reference taken before |GetClassInfo| is still valid
+  // and section is not reflected again
+  EXPECT_EQ(numMethods, methods.size());
+  EXPECT_EQ(&methods, &lazyInfo->GetMethods());
+  // sections not accessed before are reflected into own instance
+  EXPECT_EQ(registered->members.size(), lazyInfo->GetMembers().size());
+}
+
+} // namespace reflection
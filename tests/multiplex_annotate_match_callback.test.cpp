@@ -0,0 +1,107 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "ast_test_util.hpp"
+
+#include "flexlib/matchers/annotation_matcher.hpp"
+#include "flexlib/matchers/annotation_visitor.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Attr.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <base/bind.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace clang_utils {
+
+namespace {
+
+// one declaration with annotations for two plugin families
+const char kSource[] = R"raw(
+struct
+  __attribute__((annotate("{gen};{funccall};first")))
+  __attribute__((annotate("{gen};{export};second")))
+  Annotated {};
+struct Plain {};
+)raw";
+
+void recordAnnotation(
+  std::vector<std::string>* annotations
+  , clang::AnnotateAttr* annotateAttr
+  , const MatchResult&
+  , clang::Rewriter&
+  , const clang::Decl*)
+{
+  annotations->push_back(annotateAttr->getAnnotation().str());
+}
+
+void ignoreEndSourceFile(
+  const clang::FileID&
+  , const clang::FileEntry*
+  , clang::Rewriter&)
+{}
+
+scoped_refptr<AnnotationMatchOptions> makeOptions(
+  std::vector<std::string>* annotations
+  , std::vector<std::string> annotationMethodPrefixes
+  , AnnotationMatchBackend matchBackend)
+{
+  scoped_refptr<AnnotationMatchOptions> options
+    = base::MakeRefCounted<AnnotationMatchOptions>(
+        "bind"
+        , base::BindRepeating(
+            &recordAnnotation, base::Unretained(annotations))
+        , base::BindRepeating(&ignoreEndSourceFile));
+  options->annotationMethodPrefixes = std::move(annotationMethodPrefixes);
+  options->matchBackend = matchBackend;
+  return options;
+}
+
+class MultiplexAnnotateMatchCallbackTest
+  : public ::flexlib::test::ASTTest
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_NO_FATAL_FAILURE(buildAST(kSource));
+  }
+};
+
+} // namespace
+
+TEST_F(MultiplexAnnotateMatchCallbackTest, RoutesEveryAnnotationOfDecl)
+{
+  for(AnnotationMatchBackend matchBackend
+      : {AnnotationMatchBackend::kMatchFinder
+         , AnnotationMatchBackend::kAttrVisitor})
+  {
+    std::vector<std::string> funccallAnnotations;
+    std::vector<std::string> exportAnnotations;
+    std::vector<std::string> allAnnotations;
+
+    AnnotateConsumer consumer(
+      rewriter_
+      , AnnotationMatchOptionsList{
+          makeOptions(&funccallAnnotations, {"{funccall};"}, matchBackend)
+          , makeOptions(&exportAnnotations, {"{export};"}, matchBackend)
+          // empty list accepts all annotations
+          , makeOptions(&allAnnotations, {}, matchBackend)});
+    consumer.HandleTranslationUnit(astUnit_->getASTContext());
+
+    EXPECT_EQ(std::vector<std::string>{"{gen};{funccall};first"}
+      , funccallAnnotations);
+    EXPECT_EQ(std::vector<std::string>{"{gen};{export};second"}
+      , exportAnnotations);
+    // order of attributes is not checked
+    std::sort(allAnnotations.begin(), allAnnotations.end());
+    EXPECT_EQ((std::vector<std::string>{
+        "{gen};{export};second", "{gen};{funccall};first"})
+      , allAnnotations);
+  }
+}
+
+} // namespace clang_utils
@@ -0,0 +1,176 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "ast_test_util.hpp"
+
+#include "flexlib/reflect/ReflTypes.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/DeclCXX.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/Frontend/ASTUnit.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace reflection {
+
+namespace {
+
+using namespace clang::ast_matchers;
+
+const char kSource[] = R"raw(
+namespace outer {
+struct Forward;
+struct Forward { int value; };
+template<typename T> struct Templated { T value; };
+template<> struct Templated<int> { int value; };
+enum class Color { kRed };
+typedef int Number;
+namespace inner {
+struct Forward { int value; };
+} // namespace inner
+namespace {
+struct Hidden {};
+} // namespace
+} // namespace outer
+)raw";
+
+class NamespacesTreeTest
+  : public ::flexlib::test::ASTTest
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_NO_FATAL_FAILURE(buildAST(kSource));
+  }
+
+  // all declarations (and redeclarations) matched by |matcher|
+  template<typename DeclType, typename Matcher>
+  std::vector<const DeclType*> findDecls(const Matcher& matcher)
+  {
+    std::vector<const DeclType*> result;
+    for (const BoundNodes& nodes
+         : match(matcher.bind("decl"), astUnit_->getASTContext()))
+    {
+      result.push_back(nodes.getNodeAs<DeclType>("decl"));
+    }
+    return result;
+  }
+
+  NamespacesTree nsTree_;
+};
+
+} // namespace
+
+TEST_F(NamespacesTreeTest, FindsClassByAnyRedeclaration)
+{
+  const auto decls = findDecls<clang::CXXRecordDecl>(
+    cxxRecordDecl(hasName("::outer::Forward"), unless(isImplicit())));
+  // forward declaration and definition
+  ASSERT_EQ(2u, decls.size());
+  ASSERT_NE(decls[0], decls[1]);
+
+  const ClassInfoPtr info = std::make_shared<ClassInfo>();
+  nsTree_.AddClass(
+    nsTree_.GetNamespace(decls[1]->getEnclosingNamespaceContext())
+    , decls[1]
+    , info);
+
+  EXPECT_EQ(info, nsTree_.FindClass(decls[0]));
+  EXPECT_EQ(info, nsTree_.FindClass(decls[1]));
+
+  // same name in other namespace is other class
+  const auto innerDecls = findDecls<clang::CXXRecordDecl>(
+    cxxRecordDecl(hasName("::outer::inner::Forward"), unless(isImplicit())));
+  ASSERT_EQ(1u, innerDecls.size());
+  EXPECT_EQ(nullptr, nsTree_.FindClass(innerDecls[0]));
+}
+
+TEST_F(NamespacesTreeTest, FindsSpecializationByQualifiedName)
+{
+  const auto templateDecls = findDecls<clang::CXXRecordDecl>(
+    cxxRecordDecl(
+      hasName("::outer::Templated")
+      , unless(classTemplateSpecializationDecl())
+      , unless(isImplicit())));
+  const auto specializationDecls
+    = findDecls<clang::ClassTemplateSpecializationDecl>(
+        classTemplateSpecializationDecl(hasName("::outer::Templated")));
+  ASSERT_EQ(1u, templateDecls.size());
+  ASSERT_EQ(1u, specializationDecls.size());
+
+  const ClassInfoPtr info = std::make_shared<ClassInfo>();
+  nsTree_.AddClass(NamespaceInfoPtr(), templateDecls[0], info);
+
+  // specializations have same qualified name
+  EXPECT_EQ(info, nsTree_.FindClass(specializationDecls[0]));
+  // found by decl index next time
+  EXPECT_EQ(info, nsTree_.FindClass(specializationDecls[0]));
+}
+
+TEST_F(NamespacesTreeTest, IndexesEnumsAndTypedefs)
+{
+  const auto enumDecls = findDecls<clang::EnumDecl>(
+    enumDecl(hasName("::outer::Color")));
+  const auto typedefDecls = findDecls<clang::TypedefNameDecl>(
+    typedefNameDecl(hasName("::outer::Number")));
+  ASSERT_EQ(1u, enumDecls.size());
+  ASSERT_EQ(1u, typedefDecls.size());
+
+  EXPECT_EQ(nullptr, nsTree_.FindEnum(enumDecls[0]));
+  EXPECT_EQ(nullptr, nsTree_.FindTypedef(typedefDecls[0]));
+
+  const NamespaceInfoPtr ns
+    = nsTree_.GetNamespace(enumDecls[0]->getEnclosingNamespaceContext());
+  ASSERT_TRUE(ns);
+
+  const EnumInfoPtr enumInfo = std::make_shared<EnumInfo>();
+  nsTree_.AddEnum(ns, enumDecls[0], enumInfo);
+  const TypedefInfoPtr typedefInfo = std::make_shared<TypedefInfo>();
+  nsTree_.AddTypedef(ns, typedefDecls[0], typedefInfo);
+
+  EXPECT_EQ(enumInfo, nsTree_.FindEnum(enumDecls[0]));
+  EXPECT_EQ(typedefInfo, nsTree_.FindTypedef(typedefDecls[0]));
+  ASSERT_EQ(1u, ns->enums.size());
+  EXPECT_EQ(enumInfo, ns->enums.front());
+  ASSERT_EQ(1u, ns->typedefs.size());
+  EXPECT_EQ(typedefInfo, ns->typedefs.front());
+}
+
+TEST_F(NamespacesTreeTest, BuildsNamespaceHierarchy)
+{
+  const auto innerDecls = findDecls<clang::CXXRecordDecl>(
+    cxxRecordDecl(hasName("::outer::inner::Forward"), unless(isImplicit())));
+  const auto hiddenDecls = findDecls<clang::CXXRecordDecl>(
+    cxxRecordDecl(hasName("Hidden"), unless(isImplicit())));
+  ASSERT_EQ(1u, innerDecls.size());
+  ASSERT_EQ(1u, hiddenDecls.size());
+
+  const NamespaceInfoPtr inner
+    = nsTree_.GetNamespace(innerDecls[0]->getEnclosingNamespaceContext());
+  ASSERT_TRUE(inner);
+  EXPECT_EQ("inner", inner->name.str());
+
+  const NamespaceInfoPtr root = nsTree_.GetRootNamespace();
+  ASSERT_TRUE(root);
+  EXPECT_TRUE(root->isRootNamespace);
+  ASSERT_EQ(1u, root->innerNamespaces.size());
+  const NamespaceInfoPtr outer = root->innerNamespaces.front();
+  EXPECT_EQ("outer", outer->name.str());
+  ASSERT_EQ(1u, outer->innerNamespaces.size());
+  EXPECT_EQ(inner, outer->innerNamespaces.front());
+
+  // anonymous namespace is merged into parent
+  EXPECT_EQ(outer
+    , nsTree_.GetNamespace(
+        hiddenDecls[0]->getEnclosingNamespaceContext()));
+  // same node is returned again
+  EXPECT_EQ(inner
+    , nsTree_.GetNamespace(
+        innerDecls[0]->getEnclosingNamespaceContext()));
+}
+
+} // namespace reflection
@@ -0,0 +1,133 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/generated_files_overlay.hpp"
+#include "flexlib/output_sink.hpp"
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+
+#include <string>
+
+namespace flexlib {
+
+namespace {
+
+class OutputSinkTest
+  : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(tempDir_.CreateUniqueTempDir());
+    outputPath_ = tempDir_.GetPath().AppendASCII("out/generated.hpp");
+  }
+
+  std::string readOutput() const
+  {
+    std::string contents;
+    EXPECT_TRUE(base::ReadFileToString(outputPath_, &contents));
+    return contents;
+  }
+
+  base::ScopedTempDir tempDir_;
+
+  base::FilePath outputPath_;
+
+  OutputSink outputSink_;
+};
+
+} // namespace
+
+TEST_F(OutputSinkTest, WritesNewFile)
+{
+  EXPECT_EQ(OutputSink::WriteResult::kWritten
+    , outputSink_.writeIfChanged(outputPath_, "int a;"));
+  EXPECT_EQ("int a;", readOutput());
+  EXPECT_EQ(1u, outputSink_.stats().written);
+}
+
+TEST_F(OutputSinkTest, SkipsUnchangedFile)
+{
+  ASSERT_EQ(OutputSink::WriteResult::kWritten
+    , outputSink_.writeIfChanged(outputPath_, "int a;"));
+
+  // hash of written file is remembered
+  EXPECT_EQ(OutputSink::WriteResult::kSkipped
+    , outputSink_.writeIfChanged(outputPath_, "int a;"));
+  EXPECT_EQ("int a;", readOutput());
+  EXPECT_EQ(1u, outputSink_.stats().written);
+  EXPECT_EQ(1u, outputSink_.stats().skipped);
+}
+
+TEST_F(OutputSinkTest, SkipsUnchangedFileWrittenByOthers)
+{
+  ASSERT_TRUE(base::CreateDirectory(outputPath_.DirName()));
+  const std::string contents = "int a;";
+  ASSERT_EQ(static_cast<int>(contents.size())
+    , base::WriteFile(outputPath_, contents.data(), contents.size()));
+
+  // other sink, so hash is not remembered and file is compared
+  OutputSink outputSink;
+  EXPECT_EQ(OutputSink::WriteResult::kSkipped
+    , outputSink.writeIfChanged(outputPath_, contents));
+  EXPECT_EQ(OutputSink::WriteResult::kSkipped
+    , outputSink.writeIfChanged(outputPath_, contents));
+  EXPECT_EQ(2u, outputSink.stats().skipped);
+}
+
+TEST_F(OutputSinkTest, WritesChangedFile)
+{
+  ASSERT_EQ(OutputSink::WriteResult::kWritten
+    , outputSink_.writeIfChanged(outputPath_, "int a;"));
+
+  // same size
+  EXPECT_EQ(OutputSink::WriteResult::kWritten
+    , outputSink_.writeIfChanged(outputPath_, "int b;"));
+  EXPECT_EQ("int b;", readOutput());
+
+  // other size
+  EXPECT_EQ(OutputSink::WriteResult::kWritten
+    , outputSink_.writeIfChanged(outputPath_, "long b;"));
+  EXPECT_EQ("long b;", readOutput());
+
+  EXPECT_EQ(OutputSink::WriteResult::kSkipped
+    , outputSink_.writeIfChanged(outputPath_, "long b;"));
+  EXPECT_EQ(3u, outputSink_.stats().written);
+  EXPECT_EQ(1u, outputSink_.stats().skipped);
+}
+
+TEST_F(OutputSinkTest, WritesFileChangedByOthers)
+{
+  ASSERT_EQ(OutputSink::WriteResult::kWritten
+    , outputSink_.writeIfChanged(outputPath_, "int a;"));
+
+  // same size, remembered hash must not be used for other contents
+  const std::string contents = "int b;";
+  ASSERT_EQ(static_cast<int>(contents.size())
+    , base::WriteFile(outputPath_, contents.data(), contents.size()));
+  ASSERT_TRUE(base::TouchFile(outputPath_
+    , base::Time::Now() + base::TimeDelta::FromSeconds(10)
+    , base::Time::Now() + base::TimeDelta::FromSeconds(10)));
+
+  EXPECT_EQ(OutputSink::WriteResult::kWritten
+    , outputSink_.writeIfChanged(outputPath_, "int a;"));
+  EXPECT_EQ("int a;", readOutput());
+}
+
+TEST_F(OutputSinkTest, WritesIntoOverlayByAbsolutePath)
+{
+  GeneratedFilesOverlay overlay;
+  OutputSink overlaySink(&overlay);
+
+  ASSERT_TRUE(outputPath_.IsAbsolute());
+  EXPECT_EQ(OutputSink::WriteResult::kWritten
+    , overlaySink.writeIfChanged(outputPath_, "int a;"));
+  EXPECT_EQ(OutputSink::WriteResult::kSkipped
+    , overlaySink.writeIfChanged(outputPath_, "int a;"));
+  EXPECT_TRUE(overlay.hasFile(outputPath_));
+  // not written to disk until |GeneratedFilesOverlay::flushToDisk|
+  EXPECT_FALSE(base::PathExists(outputPath_));
+}
+
+} // namespace flexlib
@@ -0,0 +1,163 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/parallel_annotation_driver.hpp"
+
+#include <clang/Basic/FileManager.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include <llvm/Support/Path.h>
+
+#include <base/bind.h>
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/strings/string_number_conversions.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang_utils {
+
+namespace {
+
+// translation units in order passed to |ParallelAnnotationDriver::run|
+const char* const kSourceNames[] = {
+  "first.cc", "broken.cc", "third.cc", "missing.cc", "fifth.cc"};
+
+// slow to parse, so later files finish parsing first
+std::string generateSlowSource()
+{
+  std::string source
+    = "template<int N> struct Sum"
+      " { static const int value = N + Sum<N - 1>::value; };\n"
+      "template<> struct Sum<0> { static const int value = 0; };\n";
+  for(int i = 0; i < 2000; ++i) {
+    const std::string index = base::NumberToString(i);
+    source += "int function" + index
+      + "() { return Sum<" + base::NumberToString(i % 100) + ">::value; }\n";
+  }
+  return source;
+}
+
+void ignoreAnnotation(
+  clang::AnnotateAttr*
+  , const MatchResult&
+  , clang::Rewriter&
+  , const clang::Decl*)
+{}
+
+// |endSourceFileAction| of all workers run one at a time,
+// so |fileNames| needs no lock
+void recordEndSourceFile(
+  std::vector<std::string>* fileNames
+  , const clang::FileID&
+  , const clang::FileEntry* fileEntry
+  , clang::Rewriter&)
+{
+  fileNames->push_back(
+    llvm::sys::path::filename(fileEntry->getName()).str());
+}
+
+scoped_refptr<AnnotationMatchOptions> createWorkerOptions(
+  std::vector<std::string>* endSourceFileNames
+  , size_t)
+{
+  return base::MakeRefCounted<AnnotationMatchOptions>(
+    "bind"
+    , base::BindRepeating(&ignoreAnnotation)
+    , base::BindRepeating(
+        &recordEndSourceFile, base::Unretained(endSourceFileNames)));
+}
+
+void recordFileResult(
+  std::vector<std::pair<std::string, AnnotationFileResult::Status>>*
+    fileResults
+  , const AnnotationFileResult& result)
+{
+  fileResults->emplace_back(
+    base::FilePath::FromUTF8Unsafe(result.sourcePath)
+      .BaseName().AsUTF8Unsafe()
+    , result.status);
+}
+
+class ParallelAnnotationDriverTest
+  : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(tempDir_.CreateUniqueTempDir());
+    ASSERT_TRUE(writeFile("first.cc", generateSlowSource()));
+    // parse error, but end of file callbacks still run
+    ASSERT_TRUE(writeFile("broken.cc", "int broken( {}\n"));
+    ASSERT_TRUE(writeFile("third.cc", "int third();\n"));
+    // `missing.cc` can not be opened, so it never gets
+    // turn to run end of file callbacks
+    ASSERT_TRUE(writeFile("fifth.cc", "int fifth();\n"));
+
+    for(const char* name: kSourceNames) {
+      sourcePaths_.push_back(path(name).AsUTF8Unsafe());
+    }
+  }
+
+  base::FilePath path(const std::string& name) const
+  {
+    return tempDir_.GetPath().AppendASCII(name);
+  }
+
+  bool writeFile(const std::string& name, const std::string& contents)
+  {
+    return base::WriteFile(path(name), contents.data(), contents.size())
+      == static_cast<int>(contents.size());
+  }
+
+  base::ScopedTempDir tempDir_;
+
+  std::vector<std::string> sourcePaths_;
+};
+
+} // namespace
+
+TEST_F(ParallelAnnotationDriverTest, RunsCallbacksInSourceOrder)
+{
+  // in-memory compilation database with same command for every file
+  const clang::tooling::FixedCompilationDatabase compilations(
+    tempDir_.GetPath().AsUTF8Unsafe(), {"-std=c++17"});
+
+  for(size_t numWorkers: {1u, 4u}) {
+    SCOPED_TRACE(numWorkers);
+
+    std::vector<std::string> endSourceFileNames;
+    std::vector<std::pair<std::string, AnnotationFileResult::Status>>
+      fileResults;
+
+    ParallelAnnotationDriver::Options options;
+    options.numWorkers = numWorkers;
+    options.createWorkerOptions = base::BindRepeating(
+      &createWorkerOptions, base::Unretained(&endSourceFileNames));
+    options.onFileResult = base::BindRepeating(
+      &recordFileResult, base::Unretained(&fileResults));
+
+    ParallelAnnotationDriver driver(compilations, std::move(options));
+    // some translation units failed
+    EXPECT_FALSE(driver.run(sourcePaths_));
+
+    // failed translation units do not block later turns
+    EXPECT_EQ((std::vector<std::string>{
+        "first.cc", "broken.cc", "third.cc", "fifth.cc"})
+      , endSourceFileNames);
+
+    using Status = AnnotationFileResult::Status;
+    EXPECT_EQ((std::vector<std::pair<std::string, Status>>{
+        {"first.cc", Status::kDone}
+        , {"broken.cc", Status::kFailed}
+        , {"third.cc", Status::kDone}
+        , {"missing.cc", Status::kFailed}
+        , {"fifth.cc", Status::kDone}})
+      , fileResults);
+  }
+}
+
+} // namespace clang_utils
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <base/time/time.h>
+#include <base/timer/elapsed_timer.h>
+
+#include <cstdio>
+#include <string>
+
+namespace flexlib {
+namespace test {
+
+// Prints result in format of Chromium perf dashboard:
+// `*RESULT metric: story= value units`
+inline void printPerfResult(
+  const std::string& metric
+  , const std::string& story
+  , double value
+  , const std::string& units)
+{
+  std::printf("*RESULT %s: %s= %f %s\n"
+    , metric.c_str(), story.c_str(), value, units.c_str());
+  std::fflush(stdout);
+}
+
+// Runs |callable| |iterations| times and returns
+// average time of single run in microseconds.
+template<typename Callable>
+double measureMicroseconds(
+  size_t iterations
+  , Callable&& callable)
+{
+  base::ElapsedTimer timer;
+  for(size_t i = 0; i < iterations; ++i) {
+    callable();
+  }
+  return timer.Elapsed().InMicrosecondsF()
+         / static_cast<double>(iterations ? iterations : 1);
+}
+
+} // namespace test
+} // namespace flexlib
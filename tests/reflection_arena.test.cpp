@@ -0,0 +1,155 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/reflect/ReflectionArena.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace reflection {
+
+namespace {
+
+// records order of destruction
+struct TrackedNode
+{
+  TrackedNode(int id, std::vector<int>* destroyed)
+    : id(id), destroyed(destroyed)
+  {}
+
+  ~TrackedNode()
+  {
+    destroyed->push_back(id);
+  }
+
+  int id;
+
+  std::vector<int>* destroyed;
+};
+
+struct alignas(64) OverAlignedNode
+{
+  char data[3];
+};
+
+struct LargeNode
+{
+  char data[4096];
+};
+
+bool isAligned(const void* ptr, size_t alignment)
+{
+  return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+} // namespace
+
+TEST(ReflectionArenaTest, DestroysNodesInReverseOrderWithArena)
+{
+  std::vector<int> destroyed;
+  {
+    ReflectionArena arena;
+    arena.New<TrackedNode>(1, &destroyed);
+    arena.New<TrackedNode>(2, &destroyed);
+    arena.New<TrackedNode>(3, &destroyed);
+    EXPECT_EQ(3u, arena.GetNumNodes());
+    EXPECT_TRUE(destroyed.empty());
+  }
+  EXPECT_EQ((std::vector<int>{3, 2, 1}), destroyed);
+}
+
+TEST(ReflectionArenaTest, PointerFromMakeDoesNotOwnNode)
+{
+  std::vector<int> destroyed;
+  {
+    ReflectionArena arena;
+    {
+      std::shared_ptr<TrackedNode> node
+        = arena.Make<TrackedNode>(1, &destroyed);
+      std::shared_ptr<TrackedNode> copy = node;
+      EXPECT_EQ(0, node.use_count());
+      EXPECT_EQ(1, copy->id);
+    }
+    // node is alive while arena is alive
+    EXPECT_TRUE(destroyed.empty());
+  }
+  EXPECT_EQ((std::vector<int>{1}), destroyed);
+}
+
+TEST(ReflectionArenaTest, AlignsNodes)
+{
+  ReflectionArena arena(/*blockSize*/ 256);
+  for (int i = 0; i < 64; ++i)
+  {
+    char* padding = arena.New<char>('x');
+    EXPECT_TRUE(isAligned(padding, alignof(char)));
+
+    double* value = arena.New<double>(1.0);
+    EXPECT_TRUE(isAligned(value, alignof(double)));
+
+    OverAlignedNode* overAligned = arena.New<OverAlignedNode>();
+    EXPECT_TRUE(isAligned(overAligned, alignof(OverAlignedNode)));
+  }
+  EXPECT_EQ(64u * 3u, arena.GetNumNodes());
+}
+
+TEST(ReflectionArenaTest, LargeNodeGetsOwnBlock)
+{
+  ReflectionArena arena(/*blockSize*/ 256);
+  char* first = arena.New<char>('a');
+  const size_t bytesBefore = arena.GetAllocatedBytes();
+  EXPECT_EQ(256u, bytesBefore);
+
+  LargeNode* large = arena.New<LargeNode>();
+  ASSERT_TRUE(large);
+  EXPECT_TRUE(isAligned(large, alignof(LargeNode)));
+  EXPECT_GE(arena.GetAllocatedBytes() - bytesBefore, sizeof(LargeNode));
+
+  // free space of current block is not wasted by large node
+  char* second = arena.New<char>('b');
+  EXPECT_EQ(first + 1, second);
+  EXPECT_EQ('a', *first);
+}
+
+TEST(ReflectionArenaTest, ScopedCurrentNests)
+{
+  EXPECT_EQ(nullptr, ReflectionArena::Current());
+
+  ReflectionArena outer;
+  ReflectionArena inner;
+  {
+    ReflectionArena::ScopedCurrent scopedOuter(&outer);
+    EXPECT_EQ(&outer, ReflectionArena::Current());
+    {
+      ReflectionArena::ScopedCurrent scopedInner(&inner);
+      EXPECT_EQ(&inner, ReflectionArena::Current());
+    }
+    {
+      // disables arena of outer scope
+      ReflectionArena::ScopedCurrent scopedNone(nullptr);
+      EXPECT_EQ(nullptr, ReflectionArena::Current());
+    }
+    EXPECT_EQ(&outer, ReflectionArena::Current());
+  }
+  EXPECT_EQ(nullptr, ReflectionArena::Current());
+}
+
+TEST(ReflectionArenaTest, MakeReflectionNodeUsesCurrentArena)
+{
+  std::shared_ptr<std::string> heapNode
+    = MakeReflectionNode<std::string>("heap");
+  EXPECT_EQ(1, heapNode.use_count());
+
+  ReflectionArena arena;
+  {
+    ReflectionArena::ScopedCurrent scopedArena(&arena);
+    std::shared_ptr<std::string> arenaNode
+      = MakeReflectionNode<std::string>("arena");
+    EXPECT_EQ(0, arenaNode.use_count());
+    EXPECT_EQ("arena", *arenaNode);
+  }
+  EXPECT_EQ(1u, arena.GetNumNodes());
+}
+
+} // namespace reflection
@@ -0,0 +1,145 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/reflect/ReflectionCache.hpp"
+
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <memory>
+#include <string>
+
+namespace reflection {
+
+namespace {
+
+const char kClassUsr[] = "c:@S@Foo";
+
+const char kEnumUsr[] = "c:@E@Color";
+
+// translation units are only used as cache keys
+class ReflectionCacheTest
+  : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    firstUnit_ = clang::tooling::buildASTFromCode("struct Foo {};");
+    secondUnit_ = clang::tooling::buildASTFromCode("struct Foo {};");
+    ASSERT_TRUE(firstUnit_);
+    ASSERT_TRUE(secondUnit_);
+  }
+
+  const clang::ASTContext* firstContext() const
+  {
+    return &firstUnit_->getASTContext();
+  }
+
+  const clang::ASTContext* secondContext() const
+  {
+    return &secondUnit_->getASTContext();
+  }
+
+  std::unique_ptr<clang::ASTUnit> firstUnit_;
+
+  std::unique_ptr<clang::ASTUnit> secondUnit_;
+};
+
+} // namespace
+
+TEST_F(ReflectionCacheTest, CountsHitsAndMisses)
+{
+  ReflectionCache cache(ReflectionCache::Lifetime::kTranslationUnit);
+
+  EXPECT_EQ(nullptr, cache.LookupClass(kClassUsr, firstContext(), true));
+  EXPECT_EQ(nullptr, cache.LookupEnum(kEnumUsr, firstContext()));
+  EXPECT_EQ(2u, cache.GetStats().misses);
+  EXPECT_EQ(0u, cache.GetStats().hits);
+
+  const ClassInfoPtr classInfo = std::make_shared<ClassInfo>();
+  const EnumInfoPtr enumInfo = std::make_shared<EnumInfo>();
+  EXPECT_EQ(classInfo
+    , cache.StoreClass(kClassUsr, firstContext(), true, classInfo));
+  EXPECT_EQ(enumInfo, cache.StoreEnum(kEnumUsr, firstContext(), enumInfo));
+  EXPECT_EQ(2u, cache.GetSize());
+
+  EXPECT_EQ(classInfo, cache.LookupClass(kClassUsr, firstContext(), true));
+  EXPECT_EQ(enumInfo, cache.LookupEnum(kEnumUsr, firstContext()));
+  EXPECT_EQ(2u, cache.GetStats().hits);
+
+  // shallow class is cached separately
+  EXPECT_EQ(nullptr, cache.LookupClass(kClassUsr, firstContext(), false));
+  EXPECT_EQ(3u, cache.GetStats().misses);
+}
+
+TEST_F(ReflectionCacheTest, KeepsEntryStoredFirstInSameTranslationUnit)
+{
+  ReflectionCache cache(ReflectionCache::Lifetime::kTranslationUnit);
+
+  const ClassInfoPtr first = std::make_shared<ClassInfo>();
+  const ClassInfoPtr second = std::make_shared<ClassInfo>();
+  EXPECT_EQ(first, cache.StoreClass(kClassUsr, firstContext(), true, first));
+  EXPECT_EQ(first
+    , cache.StoreClass(kClassUsr, firstContext(), true, second));
+  EXPECT_EQ(1u, cache.GetSize());
+}
+
+TEST_F(ReflectionCacheTest, TranslationUnitLifetimeDropsEntries)
+{
+  ReflectionCache cache(ReflectionCache::Lifetime::kTranslationUnit);
+
+  cache.StoreClass(
+    kClassUsr, firstContext(), true, std::make_shared<ClassInfo>());
+  cache.StoreEnum(kEnumUsr, firstContext(), std::make_shared<EnumInfo>());
+  ASSERT_EQ(2u, cache.GetSize());
+
+  cache.EndTranslationUnit(firstContext());
+  EXPECT_EQ(0u, cache.GetSize());
+  EXPECT_EQ(nullptr, cache.FindClass(kClassUsr));
+  EXPECT_EQ(nullptr, cache.LookupClass(kClassUsr, firstContext(), true));
+}
+
+TEST_F(ReflectionCacheTest, RunLifetimeMatchesOnlySameTranslationUnit)
+{
+  ReflectionCache cache(ReflectionCache::Lifetime::kRun);
+
+  const ClassInfoPtr firstInfo = std::make_shared<ClassInfo>();
+  cache.StoreClass(kClassUsr, firstContext(), true, firstInfo);
+
+  // other translation unit
+  EXPECT_EQ(nullptr, cache.LookupClass(kClassUsr, secondContext(), true));
+  EXPECT_EQ(firstInfo, cache.FindClass(kClassUsr));
+
+  // entry built for other translation unit is replaced
+  const ClassInfoPtr secondInfo = std::make_shared<ClassInfo>();
+  EXPECT_EQ(secondInfo
+    , cache.StoreClass(kClassUsr, secondContext(), true, secondInfo));
+  EXPECT_EQ(secondInfo, cache.LookupClass(kClassUsr, secondContext(), true));
+  EXPECT_EQ(nullptr, cache.LookupClass(kClassUsr, firstContext(), true));
+
+  // entries are kept between translation units
+  cache.EndTranslationUnit(secondContext());
+  EXPECT_EQ(1u, cache.GetSize());
+  EXPECT_EQ(secondInfo, cache.FindClass(kClassUsr));
+}
+
+TEST_F(ReflectionCacheTest, RunLifetimeIgnoresReusedASTContextAddress)
+{
+  ReflectionCache cache(ReflectionCache::Lifetime::kRun);
+
+  cache.StoreClass(
+    kClassUsr, firstContext(), true, std::make_shared<ClassInfo>());
+  cache.StoreEnum(kEnumUsr, firstContext(), std::make_shared<EnumInfo>());
+  cache.EndTranslationUnit(firstContext());
+
+  // next translation unit with |clang::ASTContext| at same address
+  // must not get entries pointing into destroyed AST
+  EXPECT_EQ(nullptr, cache.LookupClass(kClassUsr, firstContext(), true));
+  EXPECT_EQ(nullptr, cache.LookupEnum(kEnumUsr, firstContext()));
+
+  const ClassInfoPtr classInfo = std::make_shared<ClassInfo>();
+  EXPECT_EQ(classInfo
+    , cache.StoreClass(kClassUsr, firstContext(), true, classInfo));
+  EXPECT_EQ(classInfo, cache.LookupClass(kClassUsr, firstContext(), true));
+}
+
+} // namespace reflection
@@ -0,0 +1,139 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "ast_test_util.hpp"
+
+#include "flexlib/replacement_collector.hpp"
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Rewrite/Core/RewriteBuffer.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <string>
+
+namespace clang_utils {
+
+namespace {
+
+const char kSource[] = "int first = 1;\nint second = 2;\n";
+
+class ReplacementCollectorTest
+  : public ::flexlib::test::ASTTest
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_NO_FATAL_FAILURE(buildAST(kSource));
+  }
+
+  clang::SourceLocation mainFileLoc(unsigned offset) const
+  {
+    const clang::SourceManager& SM = astUnit_->getSourceManager();
+    return SM.getLocForStartOfFile(SM.getMainFileID())
+      .getLocWithOffset(offset);
+  }
+
+  // token range of one token at |offset|
+  clang::SourceRange tokenAt(unsigned offset) const
+  {
+    return clang::SourceRange(mainFileLoc(offset), mainFileLoc(offset));
+  }
+
+  std::string rewrittenMainFile() const
+  {
+    const clang::SourceManager& SM = astUnit_->getSourceManager();
+    const clang::RewriteBuffer* rewriteBuffer
+      = rewriter_.getRewriteBufferFor(SM.getMainFileID());
+    return rewriteBuffer
+      ? std::string(rewriteBuffer->begin(), rewriteBuffer->end())
+      : SM.getBufferData(SM.getMainFileID()).str();
+  }
+};
+
+} // namespace
+
+TEST_F(ReplacementCollectorTest, AppliesCollectedReplacementsOnce)
+{
+  ReplacementCollector collector(&rewriter_);
+
+  // "first" and "second"
+  EXPECT_FALSE(collector.add(tokenAt(4), "renamedFirst"));
+  EXPECT_FALSE(collector.add(tokenAt(19), "renamedSecond"));
+  EXPECT_EQ(2u, collector.size());
+  EXPECT_EQ(1u, collector.fileReplacements().size());
+
+  // nothing is applied until |applyAll|
+  EXPECT_EQ(kSource, rewrittenMainFile());
+
+  EXPECT_TRUE(collector.applyAll());
+  EXPECT_EQ(0u, collector.size());
+  EXPECT_EQ("int renamedFirst = 1;\nint renamedSecond = 2;\n"
+    , rewrittenMainFile());
+}
+
+TEST_F(ReplacementCollectorTest, RejectsOverlappingReplacement)
+{
+  ReplacementCollector collector(&rewriter_);
+
+  EXPECT_FALSE(collector.add(tokenAt(4), "renamed"));
+
+  // same token
+  llvm::Error error = collector.add(tokenAt(4), "other");
+  EXPECT_TRUE(static_cast<bool>(error));
+  llvm::consumeError(std::move(error));
+
+  // "first = 1" overlaps "first"
+  error = collector.add(
+    clang::SourceRange(mainFileLoc(4), mainFileLoc(12)), "value");
+  EXPECT_TRUE(static_cast<bool>(error));
+  llvm::consumeError(std::move(error));
+
+  EXPECT_EQ(1u, collector.size());
+  EXPECT_EQ(2u, collector.numConflicts());
+
+  // first replacement wins
+  EXPECT_TRUE(collector.applyAll());
+  EXPECT_EQ("int renamed = 1;\nint second = 2;\n", rewrittenMainFile());
+}
+
+TEST_F(ReplacementCollectorTest, RejectsInvalidLocation)
+{
+  ReplacementCollector collector(&rewriter_);
+
+  // default replacement has invalid location
+  llvm::Error error = collector.add(clang::tooling::Replacement());
+  EXPECT_TRUE(static_cast<bool>(error));
+  llvm::consumeError(std::move(error));
+  EXPECT_EQ(0u, collector.size());
+  EXPECT_EQ(1u, collector.numConflicts());
+}
+
+TEST_F(ReplacementCollectorTest, ReplaceTextUsesCurrentCollector)
+{
+  ReplacementCollector collector(&rewriter_);
+  EXPECT_EQ(nullptr, ReplacementCollector::current());
+  {
+    ReplacementCollector::ScopedCurrent scopedCollector(&collector);
+    EXPECT_EQ(&collector, ReplacementCollector::current());
+
+    EXPECT_TRUE(replaceText(rewriter_, tokenAt(4), "renamed"));
+    // conflict is reported instead of corrupting output
+    EXPECT_FALSE(replaceText(rewriter_, tokenAt(4), "other"));
+  }
+  EXPECT_EQ(nullptr, ReplacementCollector::current());
+
+  EXPECT_EQ(1u, collector.size());
+  EXPECT_EQ(1u, collector.numConflicts());
+  EXPECT_EQ(kSource, rewrittenMainFile());
+
+  EXPECT_TRUE(collector.applyAll());
+  EXPECT_EQ("int renamed = 1;\nint second = 2;\n", rewrittenMainFile());
+}
+
+TEST_F(ReplacementCollectorTest, ReplaceTextWithoutCollectorEditsRewriter)
+{
+  EXPECT_TRUE(replaceText(rewriter_, tokenAt(4), "renamed"));
+  EXPECT_EQ("int renamed = 1;\nint second = 2;\n", rewrittenMainFile());
+}
+
+} // namespace clang_utils
@@ -0,0 +1,154 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "ast_test_util.hpp"
+
+#include "flexlib/annotation_result_cache.hpp"
+#include "flexlib/replacement_collector.hpp"
+#include "flexlib/replacements_export.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <string>
+
+namespace clang_utils {
+
+namespace {
+
+const char kSource[] = "int first = 1;\nint second = 2;\n";
+
+FileEditsList makeFileEdits()
+{
+  FileEditsList result;
+
+  FileEdits first;
+  first.path = "/src/first.cc";
+  first.contentHash = computeContentHash("int a;");
+  llvm::consumeError(first.replacements.add(
+    clang::tooling::Replacement(first.path, 0, 3, "long")));
+  llvm::consumeError(first.replacements.add(
+    clang::tooling::Replacement(first.path, 5, 0, " /* a */")));
+  result.push_back(std::move(first));
+
+  // without content hash and replacements
+  FileEdits second;
+  second.path = "/src/second.cc";
+  result.push_back(std::move(second));
+
+  return result;
+}
+
+} // namespace
+
+TEST(ReplacementsExportTest, SerializeRoundTrip)
+{
+  const FileEditsList fileEdits = makeFileEdits();
+
+  FileEditsList restored;
+  ASSERT_TRUE(deserializeFileEdits(serializeFileEdits(fileEdits), &restored));
+
+  ASSERT_EQ(fileEdits.size(), restored.size());
+  for(size_t i = 0; i < fileEdits.size(); ++i) {
+    EXPECT_EQ(fileEdits[i].path, restored[i].path);
+    EXPECT_EQ(fileEdits[i].contentHash, restored[i].contentHash);
+    ASSERT_EQ(fileEdits[i].replacements.size()
+      , restored[i].replacements.size());
+    auto restoredIt = restored[i].replacements.begin();
+    for(const clang::tooling::Replacement& replacement
+        : fileEdits[i].replacements)
+    {
+      EXPECT_EQ(replacement, *restoredIt);
+      ++restoredIt;
+    }
+  }
+}
+
+TEST(ReplacementsExportTest, SerializeEmptyList)
+{
+  FileEditsList restored = makeFileEdits();
+  ASSERT_TRUE(
+    deserializeFileEdits(serializeFileEdits(FileEditsList()), &restored));
+  EXPECT_TRUE(restored.empty());
+}
+
+TEST(ReplacementsExportTest, RejectsInvalidData)
+{
+  const std::string data = serializeFileEdits(makeFileEdits());
+
+  FileEditsList restored = makeFileEdits();
+  EXPECT_FALSE(deserializeFileEdits(base::StringPiece(), &restored));
+  EXPECT_FALSE(deserializeFileEdits("not an edit list", &restored));
+  EXPECT_FALSE(deserializeFileEdits(
+    base::StringPiece(data.data(), data.size() / 2), &restored));
+  // result is not changed on failure
+  EXPECT_EQ(2u, restored.size());
+}
+
+class ReplacementCollectorExportTest
+  : public ::flexlib::test::ASTTest
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_NO_FATAL_FAILURE(buildAST(kSource));
+  }
+
+  clang::SourceLocation mainFileLoc(unsigned offset) const
+  {
+    const clang::SourceManager& SM = astUnit_->getSourceManager();
+    return SM.getLocForStartOfFile(SM.getMainFileID())
+      .getLocWithOffset(offset);
+  }
+};
+
+TEST_F(ReplacementCollectorExportTest, HashesFileOfReplacement)
+{
+  ReplacementCollector collector(&rewriter_);
+
+  // not made from |clang::SourceRange|
+  const clang::tooling::Replacement replacement(
+    astUnit_->getSourceManager(), mainFileLoc(0), 3, "long");
+  ASSERT_TRUE(replacement.isApplicable());
+  EXPECT_FALSE(collector.add(replacement));
+
+  const std::string filePath = replacement.getFilePath().str();
+  ASSERT_EQ(1u, collector.fileContentHashes().count(filePath));
+  EXPECT_EQ(computeContentHash(kSource)
+    , collector.fileContentHashes().at(filePath));
+
+  const FileEditsList fileEdits = collectFileEdits(collector);
+  ASSERT_EQ(1u, fileEdits.size());
+  EXPECT_EQ(filePath, fileEdits[0].path);
+  EXPECT_EQ(computeContentHash(kSource), fileEdits[0].contentHash);
+  EXPECT_EQ(1u, fileEdits[0].replacements.size());
+
+  collector.clear();
+}
+
+TEST_F(ReplacementCollectorExportTest, ClearResetsHashesAndConflicts)
+{
+  ReplacementCollector collector(&rewriter_);
+
+  EXPECT_FALSE(collector.add(
+    clang::SourceRange(mainFileLoc(4), mainFileLoc(4)), "renamed"));
+  // overlaps with first replacement
+  llvm::Error error = collector.add(
+    clang::SourceRange(mainFileLoc(4), mainFileLoc(4)), "other");
+  EXPECT_TRUE(static_cast<bool>(error));
+  llvm::consumeError(std::move(error));
+
+  EXPECT_EQ(1u, collector.size());
+  EXPECT_EQ(1u, collector.numConflicts());
+  EXPECT_EQ(1u, collector.fileContentHashes().size());
+
+  collector.clear();
+
+  EXPECT_EQ(0u, collector.size());
+  EXPECT_EQ(0u, collector.numConflicts());
+  EXPECT_TRUE(collector.fileContentHashes().empty());
+  EXPECT_TRUE(collectFileEdits(collector).empty());
+}
+
+} // namespace clang_utils
@@ -0,0 +1,174 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/shared_precompiled_header.hpp"
+
+#include <base/files/file.h>
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/time/time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace clang_utils {
+
+namespace {
+
+bool hasIncludePch(const clang::tooling::CommandLineArguments& args)
+{
+  return std::find(args.begin(), args.end(), "-include-pch") != args.end();
+}
+
+class SharedPrecompiledHeaderTest
+  : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_TRUE(tempDir_.CreateUniqueTempDir());
+    ASSERT_TRUE(writeFile("common.hpp", "inline int common() { return 1; }\n"));
+    ASSERT_TRUE(writeFile("prefix.hpp"
+      , "#pragma once\n"
+        "#include \"common.hpp\"\n"));
+  }
+
+  base::FilePath path(const std::string& name) const
+  {
+    return tempDir_.GetPath().AppendASCII(name);
+  }
+
+  bool writeFile(const std::string& name, const std::string& contents)
+  {
+    return base::WriteFile(path(name), contents.data(), contents.size())
+      == static_cast<int>(contents.size());
+  }
+
+  SharedPrecompiledHeader::Options makeOptions() const
+  {
+    SharedPrecompiledHeader::Options options;
+    options.prefixHeader = path("prefix.hpp");
+    options.outputDir = path("pch");
+    options.workingDir = tempDir_.GetPath();
+    options.compileArgs = {
+      "-std=c++17"
+      , "-I" + tempDir_.GetPath().AsUTF8Unsafe()};
+    return options;
+  }
+
+  base::Time pchLastModified(const SharedPrecompiledHeader& pch) const
+  {
+    base::File::Info fileInfo;
+    EXPECT_TRUE(base::GetFileInfo(pch.pchPath(), &fileInfo));
+    return fileInfo.last_modified;
+  }
+
+  base::ScopedTempDir tempDir_;
+};
+
+} // namespace
+
+TEST_F(SharedPrecompiledHeaderTest, ReusesPchUntilHeaderChanges)
+{
+  std::string stamp;
+  base::FilePath pchPath;
+  {
+    SharedPrecompiledHeader pch(makeOptions());
+    ASSERT_TRUE(pch.prepare());
+    EXPECT_TRUE(pch.isReady());
+    EXPECT_TRUE(base::PathExists(pch.pchPath()));
+    EXPECT_FALSE(pch.stamp().empty());
+    stamp = pch.stamp();
+    pchPath = pch.pchPath();
+  }
+
+  // rebuilt precompiled header would get current time
+  const base::Time oldTime
+    = base::Time::Now() - base::TimeDelta::FromDays(1);
+  ASSERT_TRUE(base::TouchFile(pchPath, oldTime, oldTime));
+
+  {
+    SharedPrecompiledHeader pch(makeOptions());
+    ASSERT_TRUE(pch.prepare());
+    EXPECT_EQ(stamp, pch.stamp());
+    // not rebuilt
+    EXPECT_LT(pchLastModified(pch), oldTime + base::TimeDelta::FromHours(1));
+  }
+
+  // same size, other contents and modification time
+  ASSERT_TRUE(writeFile("common.hpp", "inline int common() { return 2; }\n"));
+  const base::Time newTime
+    = base::Time::Now() + base::TimeDelta::FromSeconds(10);
+  ASSERT_TRUE(base::TouchFile(path("common.hpp"), newTime, newTime));
+
+  {
+    SharedPrecompiledHeader pch(makeOptions());
+    ASSERT_TRUE(pch.prepare());
+    EXPECT_NE(stamp, pch.stamp());
+    EXPECT_GT(pchLastModified(pch), oldTime + base::TimeDelta::FromHours(1));
+  }
+}
+
+TEST_F(SharedPrecompiledHeaderTest, AdjustsOnlyMatchingTranslationUnits)
+{
+  ASSERT_TRUE(writeFile("matching.cc"
+    , "// comment\n"
+      "#include \"common.hpp\"\n"
+      "#include <vector>\n"
+      "int main() { return common(); }\n"));
+  ASSERT_TRUE(writeFile("other_includes.cc"
+    , "#include <vector>\n"
+      "#include \"common.hpp\"\n"));
+
+  SharedPrecompiledHeader pch(makeOptions());
+  ASSERT_TRUE(pch.prepare());
+  const clang::tooling::ArgumentsAdjuster adjuster
+    = pch.getArgumentsAdjuster();
+
+  const std::string includeArg = "-I" + tempDir_.GetPath().AsUTF8Unsafe();
+  const std::string matching = path("matching.cc").AsUTF8Unsafe();
+
+  // flags not affecting precompiled header are ignored
+  const clang::tooling::CommandLineArguments adjusted
+    = adjuster(
+        {"clang++", "-std=c++17", "-O2", "-Wall", "-I"
+         , tempDir_.GetPath().AsUTF8Unsafe(), "-c", matching}
+        , matching);
+  EXPECT_TRUE(hasIncludePch(adjusted));
+  EXPECT_EQ("clang++", adjusted.front());
+
+  // other defines
+  EXPECT_FALSE(hasIncludePch(adjuster(
+    {"clang++", "-std=c++17", includeArg, "-DOTHER", "-c", matching}
+    , matching)));
+
+  // other language standard
+  EXPECT_FALSE(hasIncludePch(adjuster(
+    {"clang++", "-std=c++14", includeArg, "-c", matching}
+    , matching)));
+
+  // prefix includes are not first
+  const std::string otherIncludes = path("other_includes.cc").AsUTF8Unsafe();
+  EXPECT_FALSE(hasIncludePch(adjuster(
+    {"clang++", "-std=c++17", includeArg, "-c", otherIncludes}
+    , otherIncludes)));
+
+  EXPECT_EQ(1u, pch.stats().used);
+  EXPECT_EQ(3u, pch.stats().skipped);
+}
+
+TEST_F(SharedPrecompiledHeaderTest, RejectsPrefixHeaderWithoutIncludes)
+{
+  ASSERT_TRUE(writeFile("prefix.hpp"
+    , "#ifndef PREFIX_HPP\n"
+      "#define PREFIX_HPP\n"
+      "#include \"common.hpp\"\n"
+      "#endif\n"));
+
+  SharedPrecompiledHeader pch(makeOptions());
+  EXPECT_FALSE(pch.prepare());
+  EXPECT_FALSE(pch.isReady());
+}
+
+} // namespace clang_utils
@@ -0,0 +1,109 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "flexlib/reflect/StringInterner.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace reflection {
+
+namespace {
+
+const size_t kNumThreads = 8;
+
+const size_t kNumStrings = 1000;
+
+std::string makeName(size_t index)
+{
+  return "::base::internal::Name" + std::to_string(index);
+}
+
+} // namespace
+
+TEST(StringInternerTest, ReturnsSameCopyForEqualStrings)
+{
+  StringInterner interner;
+
+  const std::string* first = interner.Intern("::base::internal");
+  const std::string* second
+    = interner.Intern(std::string("::base::internal"));
+  const std::string* other = interner.Intern("::base");
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other);
+  EXPECT_EQ("::base::internal", *first);
+
+  EXPECT_EQ(2u, interner.GetSize());
+  EXPECT_EQ(sizeof("::base::internal") - 1 + sizeof("::base") - 1
+    , interner.GetBytes());
+}
+
+TEST(StringInternerTest, EmptyStringIsNotStored)
+{
+  StringInterner interner;
+  EXPECT_EQ(nullptr, interner.Intern(std::string()));
+  EXPECT_EQ(0u, interner.GetSize());
+  EXPECT_EQ(0u, interner.GetBytes());
+}
+
+TEST(StringInternerTest, CopiesAreStableWhileInterning)
+{
+  StringInterner interner;
+
+  std::vector<const std::string*> copies;
+  for (size_t i = 0; i < kNumStrings; ++i) {
+    copies.push_back(interner.Intern(makeName(i)));
+  }
+  // rehash of sets does not move stored strings
+  for (size_t i = 0; i < kNumStrings; ++i) {
+    EXPECT_EQ(copies[i], interner.Intern(makeName(i)));
+    EXPECT_EQ(makeName(i), *copies[i]);
+  }
+  EXPECT_EQ(kNumStrings, interner.GetSize());
+}
+
+TEST(StringInternerTest, InternsFromManyThreads)
+{
+  StringInterner interner;
+
+  std::vector<std::vector<const std::string*>> copies(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kNumThreads; ++thread) {
+    threads.emplace_back([&interner, &copies, thread]() {
+      for (size_t i = 0; i < kNumStrings; ++i) {
+        // threads intern same strings in different order
+        copies[thread].push_back(
+          interner.Intern(makeName((i + thread * 97) % kNumStrings)));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(kNumStrings, interner.GetSize());
+  for (size_t thread = 0; thread < kNumThreads; ++thread) {
+    for (size_t i = 0; i < kNumStrings; ++i) {
+      EXPECT_EQ(interner.Intern(makeName((i + thread * 97) % kNumStrings))
+        , copies[thread][i]);
+    }
+  }
+}
+
+TEST(StringInternerTest, InternedStringComparesDefaultInternerCopies)
+{
+  const InternedString a = std::string("::base::internal");
+  const InternedString b = "::base::internal";
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.identity(), b.identity());
+  EXPECT_EQ(StringInterner::GetDefault()->Intern("::base::internal")
+    , a.identity());
+
+  // same contents in other interner is other copy
+  StringInterner other;
+  EXPECT_NE(other.Intern("::base::internal"), a.identity());
+  EXPECT_EQ(*other.Intern("::base::internal"), a.str());
+}
+
+} // namespace reflection
@@ -8,6 +8,65 @@ add_custom_command( TARGET ${ROOT_PROJECT_NAME}-i18n POST_BUILD
                         ${CMAKE_CURRENT_SOURCE_DIR}/data
                         ${CMAKE_CURRENT_BINARY_DIR}/${PROJECT_NAME} )
 
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-reflection_arena
+  "reflection_arena.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-token_boundary_index
+  "token_boundary_index.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-replacements_export
+  "replacements_export.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-string_interner
+  "string_interner.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-output_sink
+  "output_sink.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-annotation_dispatch_table
+  "annotation_dispatch_table.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-replacement_collector
+  "replacement_collector.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-async_output_writer
+  "async_output_writer.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-namespaces_tree
+  "namespaces_tree.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-reflection_cache
+  "reflection_cache.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-annotation_parse_cache
+  "annotation_parse_cache.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-shared_precompiled_header
+  "shared_precompiled_header.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-multiplex_annotate_match_callback
+  "multiplex_annotate_match_callback.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-annotation_result_cache
+  "annotation_result_cache.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-annotation_prescan
+  "annotation_prescan.test.cpp")
+
+flexlib_test_gtest(${ROOT_PROJECT_NAME}-parallel_annotation_driver
+  "parallel_annotation_driver.test.cpp")
+
+# perf tests (see perf_test_runner.cmake)
+
+flexlib_perf_test_gtest(${ROOT_PROJECT_NAME}-annotation_match_backend_perftest
+  "annotation_match_backend.perftest.cpp")
+
+flexlib_perf_test_gtest(${ROOT_PROJECT_NAME}-func_parser_perftest
+  "func_parser.perftest.cpp")
+
+flexlib_perf_test_gtest(${ROOT_PROJECT_NAME}-lazy_class_info_perftest
+  "lazy_class_info.perftest.cpp")
+
 list(APPEND flexlib_unittests
   #annotations/asio_guard_annotations_unittest.cc
 )
@@ -0,0 +1,160 @@
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "ast_test_util.hpp"
+
+#include "flexlib/clangUtils.hpp"
+#include "flexlib/token_boundary_index.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+#include <string>
+
+namespace clang_utils {
+
+namespace {
+
+using namespace clang::ast_matchers;
+
+// end location of some decls points into '>>' token,
+// into macro expansion or is followed by comments
+const char kSource[] = R"raw(
+template<typename T> struct Box { T value; };
+
+#define DECLARE_INT(name) int name
+#define SEMI ;
+#define TYPE_OF_BOX Box<int>
+
+Box<Box<int>> nested;
+using NestedBox = Box<Box<int>>;
+using NestedBoxInComment = Box<Box<int>> /* comment ; */ ;
+int withComment = 1 /* comment */ ;
+int withLineComment = 2 // comment ;
+  ;
+DECLARE_INT(fromMacro);
+int withSemiMacro = 3 SEMI
+TYPE_OF_BOX boxFromMacro;
+int withoutSemi = 4, other = 5;
+struct Fields {
+  Box<Box<int>> nestedField;
+  int field /* comment */ ;
+};
+)raw";
+
+class TokenBoundaryIndexTest
+  : public ::flexlib::test::ASTTest
+{
+protected:
+  void SetUp() override
+  {
+    ASSERT_NO_FATAL_FAILURE(buildAST(kSource));
+  }
+};
+
+} // namespace
+
+TEST_F(TokenBoundaryIndexTest, FindSemiMatchesLexer)
+{
+  TokenBoundaryIndexCache tokenIndexCache(
+    astUnit_->getSourceManager(), astUnit_->getLangOpts());
+
+  const auto decls = match(
+    namedDecl(isExpansionInMainFile()).bind("decl")
+    , astUnit_->getASTContext());
+  ASSERT_FALSE(decls.empty());
+
+  size_t numFound = 0;
+  for(const BoundNodes& nodes: decls) {
+    const clang::NamedDecl* decl
+      = nodes.getNodeAs<clang::NamedDecl>("decl");
+    ASSERT_TRUE(decl);
+    const clang::SourceLocation endLoc = decl->getEndLoc();
+
+    const clang::SourceLocation indexed
+      = findSemiAfterLocation(endLoc, rewriter_, &tokenIndexCache);
+    const clang::SourceLocation lexed
+      = findSemiAfterLocation(endLoc, rewriter_, nullptr);
+
+    EXPECT_EQ(lexed, indexed)
+      << decl->getNameAsString();
+    if(lexed.isValid()) {
+      ++numFound;
+    }
+  }
+  EXPECT_GT(numFound, 0u);
+  EXPECT_EQ(1u, tokenIndexCache.size());
+}
+
+TEST_F(TokenBoundaryIndexTest, UsesCurrentCache)
+{
+  TokenBoundaryIndexCache tokenIndexCache(
+    astUnit_->getSourceManager(), astUnit_->getLangOpts());
+
+  const auto decls = match(
+    varDecl(hasName("withComment")).bind("decl")
+    , astUnit_->getASTContext());
+  ASSERT_EQ(1u, decls.size());
+  const clang::SourceLocation endLoc
+    = decls.front().getNodeAs<clang::VarDecl>("decl")->getEndLoc();
+
+  EXPECT_EQ(nullptr, TokenBoundaryIndexCache::Current());
+  const clang::SourceLocation lexed
+    = findSemiAfterLocation(endLoc, rewriter_);
+  EXPECT_EQ(0u, tokenIndexCache.size());
+  EXPECT_TRUE(lexed.isValid());
+
+  {
+    TokenBoundaryIndexCache::ScopedCurrent scopedCache(&tokenIndexCache);
+    EXPECT_EQ(&tokenIndexCache, TokenBoundaryIndexCache::Current());
+    EXPECT_EQ(lexed, findSemiAfterLocation(endLoc, rewriter_));
+  }
+  EXPECT_EQ(1u, tokenIndexCache.size());
+  EXPECT_EQ(nullptr, TokenBoundaryIndexCache::Current());
+}
+
+TEST_F(TokenBoundaryIndexTest, FindsTokens)
+{
+  const clang::SourceManager& sourceManager
+    = astUnit_->getSourceManager();
+  TokenBoundaryIndexCache tokenIndexCache(
+    sourceManager, astUnit_->getLangOpts());
+
+  const TokenBoundaryIndex* tokenIndex
+    = tokenIndexCache.getOrBuild(sourceManager.getMainFileID());
+  ASSERT_TRUE(tokenIndex);
+  // index is reused
+  EXPECT_EQ(tokenIndex
+    , tokenIndexCache.getOrBuild(sourceManager.getMainFileID()));
+
+  const std::string source = kSource;
+  const size_t nestedOffset = source.find("Box<Box<int>> nested");
+  ASSERT_NE(std::string::npos, nestedOffset);
+
+  const TokenBoundaryIndex::Token* token
+    = tokenIndex->findTokenAt(nestedOffset);
+  ASSERT_TRUE(token);
+  EXPECT_EQ(clang::tok::raw_identifier, token->kind);
+  EXPECT_EQ(3u, token->length);
+
+  // second '>' of '>>' is not start of token
+  const size_t shiftOffset = source.find(">>", nestedOffset);
+  ASSERT_NE(std::string::npos, shiftOffset);
+  const TokenBoundaryIndex::Token* shiftToken
+    = tokenIndex->findTokenAt(shiftOffset);
+  ASSERT_TRUE(shiftToken);
+  EXPECT_EQ(clang::tok::greatergreater, shiftToken->kind);
+  EXPECT_EQ(nullptr, tokenIndex->findTokenAt(shiftOffset + 1));
+
+  // comments are skipped
+  const size_t commentOffset = source.find("/* comment */");
+  ASSERT_NE(std::string::npos, commentOffset);
+  const TokenBoundaryIndex::Token* afterComment
+    = tokenIndex->findFirstTokenFrom(commentOffset);
+  ASSERT_TRUE(afterComment);
+  EXPECT_EQ(clang::tok::semi, afterComment->kind);
+}
+
+} // namespace clang_utils